@@ -0,0 +1,290 @@
+/*
+ * File: bench/core/logging.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// Logging benchmark: records/s and per call latency percentiles of the
+// commonpp sinks, the cost of a disabled statement, N threads logging
+// through one Logger (and one ThreadLocalLogger) and the text formatter
+// with and without a named scope.
+// The results are written on stdout as one JSON document.
+//
+// usage: Bench_core_logging [max threads] [records per run] [directory]
+//
+// The records go to /dev/null whenever the sink allows it, the console is
+// redirected there too. The file sinks write in the given directory
+// (default: the temporary directory), the syslog sink to the local syslog.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+#include <commonpp/core/TscClock.hpp>
+#include <commonpp/core/config.hpp>
+#include <commonpp/thread/Thread.hpp>
+
+using namespace commonpp;
+namespace fs = boost::filesystem;
+
+CREATE_LOGGER(bench_logger, "bench");
+CREATE_THREAD_LOCAL_LOGGER(bench_local_logger, "bench");
+
+namespace
+{
+
+struct NullBuffer : std::streambuf
+{
+    int overflow(int c) override
+    {
+        return c;
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize size) override
+    {
+        return size;
+    }
+};
+
+struct Result
+{
+    std::string benchmark;
+    std::string name;
+    int threads;
+    uint64_t records;
+    double seconds;
+    // per call, in ns
+    std::vector<int64_t> latencies;
+};
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1,
+                           static_cast<size_t>(p * sorted.size()))];
+}
+
+// the powers of two below max_threads, then max_threads itself
+std::vector<int> thread_counts(int max_threads)
+{
+    std::vector<int> counts;
+    for (int nb_threads = 1; nb_threads < max_threads; nb_threads *= 2)
+    {
+        counts.push_back(nb_threads);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+// nb_records split between the threads, every call is timed
+template <typename Statement>
+Result run(std::string benchmark,
+           std::string name,
+           int nb_threads,
+           uint64_t nb_records,
+           Statement statement)
+{
+    Result result{std::move(benchmark), std::move(name), nb_threads,
+                  nb_records / nb_threads * nb_threads, 0, {}};
+    std::vector<std::vector<int64_t>> latencies(nb_threads);
+    std::atomic_bool start{false};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nb_threads; ++i)
+    {
+        threads.emplace_back([&, i] {
+            auto& local = latencies[i];
+            local.reserve(nb_records / nb_threads);
+            while (!start.load(std::memory_order_acquire))
+            {
+            }
+
+            for (uint64_t n = 0; n < nb_records / nb_threads; ++n)
+            {
+                auto begin = TscClock::now();
+                statement(n);
+                local.push_back((TscClock::now() - begin).count());
+            }
+        });
+    }
+
+    auto begin = TscClock::now();
+    start.store(true, std::memory_order_release);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    boost::log::core::get()->flush();
+    std::chrono::duration<double> elapsed = TscClock::now() - begin;
+    result.seconds = elapsed.count();
+
+    for (auto& local : latencies)
+    {
+        result.latencies.insert(result.latencies.end(), local.begin(), local.end());
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+void log_record(uint64_t n)
+{
+    LOG(bench_logger, info) << "benchmark record " << n << " value " << 3.14;
+}
+
+void log_local_record(uint64_t n)
+{
+    LOG(bench_local_logger, info) << "benchmark record " << n << " value " << 3.14;
+}
+
+void log_disabled(uint64_t n)
+{
+    LOG(bench_logger, debug) << "benchmark record " << n << " value " << 3.14;
+}
+
+void log_in_scope(uint64_t n)
+{
+    TRACE_LOG(bench_logger, info) << "benchmark record " << n << " value " << 3.14;
+}
+
+// a new sink for each run
+void reset_sinks(const std::function<void()>& add_sink)
+{
+    // stops the thread of the previous sink
+    core::remove_all_sinks();
+    add_sink();
+}
+
+void write_json(std::ostream& out, int max_threads, const std::vector<Result>& results)
+{
+    out << "{\n  \"max_threads\": " << max_threads
+        << ",\n  \"tsc\": " << (TscClock::uses_tsc() ? "true" : "false")
+        << ",\n  \"results\": [";
+
+    const char* separator = "\n";
+    for (const auto& result : results)
+    {
+        const auto& latencies = result.latencies;
+        out << separator << "    {\"benchmark\": \"" << result.benchmark
+            << "\", \"name\": \"" << result.name
+            << "\", \"threads\": " << result.threads
+            << ", \"records\": " << result.records
+            << ", \"seconds\": " << result.seconds
+            << ", \"records_per_sec\": "
+            << static_cast<uint64_t>(result.records / result.seconds)
+            << ", \"latency_ns\": {\"p50\": " << percentile(latencies, 0.5)
+            << ", \"p90\": " << percentile(latencies, 0.9)
+            << ", \"p99\": " << percentile(latencies, 0.99)
+            << ", \"p999\": " << percentile(latencies, 0.999)
+            << ", \"max\": " << (latencies.empty() ? 0 : latencies.back())
+            << "}}";
+        separator = ",\n";
+    }
+    out << "\n  ]\n}" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t nb_records = 200000;
+    fs::path directory = fs::temp_directory_path() / fs::unique_path();
+
+    if (argc > 1)
+    {
+        max_threads = std::max(1, std::atoi(argv[1]));
+    }
+
+    if (argc > 2)
+    {
+        nb_records = std::strtoull(argv[2], nullptr, 10);
+    }
+
+    if (argc > 3)
+    {
+        directory = argv[3];
+    }
+    fs::create_directories(directory);
+
+    // the JSON goes to the real stdout
+    std::ostream out(std::cout.rdbuf());
+    NullBuffer null_buffer;
+    std::cout.rdbuf(&null_buffer);
+
+    core::init_logging();
+    TscClock::init();
+    thread::set_current_thread_name("bench");
+
+    std::vector<Result> results;
+
+    // the console sink can only be added once, it comes first
+    reset_sinks([] { core::enable_console_logging(); });
+    results.push_back(run("sink", "console", 1, nb_records, log_record));
+
+    reset_sinks([&] { core::add_file_sink((directory / "file.log").string()); });
+    results.push_back(run("sink", "file", 1, nb_records, log_record));
+
+    reset_sinks([&] {
+        core::add_file_sink_rotate((directory / "rotate_%N.log").string(),
+                                   1024 * 1024);
+    });
+    results.push_back(run("sink", "rotated_file", 1, nb_records, log_record));
+
+    reset_sinks([&] {
+        core::MappedFileOptions options;
+        options.segment_size = 16 * 1024 * 1024;
+        core::add_mapped_file_sink((directory / "mapped").string(), options);
+    });
+    results.push_back(run("sink", "mapped_file", 1, nb_records, log_record));
+
+#if HAVE_SYSLOG
+    reset_sinks([] { core::enable_builtin_syslog(); });
+    results.push_back(run("sink", "syslog", 1, nb_records, log_record));
+#endif
+
+    // the formatter and the synchronous frontend, without the I/O
+    reset_sinks([] { core::add_file_sink("/dev/null"); });
+
+    core::set_logging_level(info);
+    results.push_back(run("disabled", "below_level", 1, nb_records, log_disabled));
+    core::set_logging_level(trace);
+
+    for (int nb_threads : thread_counts(max_threads))
+    {
+        results.push_back(run("contention", "logger", nb_threads, nb_records, log_record));
+        results.push_back(run("contention", "thread_local_logger", nb_threads,
+                              nb_records, log_local_record));
+    }
+
+    results.push_back(run("formatter", "no_scope", 1, nb_records, log_record));
+    results.push_back(run("formatter", "named_scope", 1, nb_records, log_in_scope));
+
+    core::remove_all_sinks();
+    if (argc <= 3)
+    {
+        boost::system::error_code error;
+        fs::remove_all(directory, error);
+    }
+
+    write_json(out, max_threads, results);
+    std::cout.rdbuf(out.rdbuf());
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * File: bench/thread/locks.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// Contention benchmark of the commonpp locks against std::mutex: N threads
+// increment a few counters protected by the lock in a tight loop.
+//
+// usage: Bench_thread_locks [max threads] [duration per run in ms]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <commonpp/thread/AdaptiveMutex.hpp>
+#include <commonpp/thread/MCSLock.hpp>
+#include <commonpp/thread/Spinlock.hpp>
+
+using namespace commonpp::thread;
+
+// a short critical section touching a couple of cache lines
+struct alignas(64) Protected
+{
+    uint64_t counters[16] = {};
+};
+
+template <typename Lock>
+static double run(int nb_threads, std::chrono::milliseconds duration)
+{
+    Lock lock;
+    Protected data;
+    std::atomic_bool start{false};
+    std::atomic_bool stop{false};
+    std::vector<uint64_t> ops(nb_threads * 8, 0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nb_threads; ++i)
+    {
+        threads.emplace_back(
+            [&, i]
+            {
+                while (!start.load(std::memory_order_acquire))
+                {
+                    cpu_relax();
+                }
+
+                uint64_t local = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    {
+                        std::lock_guard<Lock> guard(lock);
+                        for (auto& counter : data.counters)
+                        {
+                            ++counter;
+                        }
+                    }
+                    ++local;
+                }
+                ops[i * 8] = local;
+            });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stop = true;
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    uint64_t total = 0;
+    for (int i = 0; i < nb_threads; ++i)
+    {
+        total += ops[i * 8];
+    }
+
+    return total / elapsed.count();
+}
+
+// the powers of two below max_threads, then max_threads itself
+static std::vector<int> thread_counts(int max_threads)
+{
+    std::vector<int> counts;
+    for (int nb_threads = 1; nb_threads < max_threads; nb_threads *= 2)
+    {
+        counts.push_back(nb_threads);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+template <typename Lock>
+static void bench(const char* name, int max_threads, std::chrono::milliseconds duration)
+{
+    std::cout << std::setw(14) << name;
+    for (int nb_threads : thread_counts(max_threads))
+    {
+        std::cout << std::setw(14) << std::fixed << std::setprecision(2)
+                  << run<Lock>(nb_threads, duration) / 1e6;
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::chrono::milliseconds duration(500);
+
+    if (argc > 1)
+    {
+        max_threads = std::max(1, std::atoi(argv[1]));
+    }
+
+    if (argc > 2)
+    {
+        duration = std::chrono::milliseconds(std::atoi(argv[2]));
+    }
+
+    std::cout << "Mops/s by number of threads" << std::endl;
+    std::cout << std::setw(14) << "lock";
+    for (int nb_threads : thread_counts(max_threads))
+    {
+        std::cout << std::setw(14) << nb_threads;
+    }
+    std::cout << std::endl;
+
+    bench<std::mutex>("std::mutex", max_threads, duration);
+    bench<Spinlock>("Spinlock", max_threads, duration);
+    bench<TicketLock>("TicketLock", max_threads, duration);
+    bench<MCSLock>("MCSLock", max_threads, duration);
+    bench<AdaptiveMutex>("AdaptiveMutex", max_threads, duration);
+
+    return 0;
+}
@@ -0,0 +1,409 @@
+/*
+ * File: include/commonpp/core/DeferredLogging.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <ios>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <commonpp/core/LoggingInterface.hpp>
+#include <commonpp/core/TscClock.hpp>
+
+namespace commonpp
+{
+namespace core
+{
+
+// A DeferredLogger is used with the usual LOG() macros, but the statement
+// does not format anything: the arguments are copied in a ring buffer owned
+// by the logging thread, a background thread turns them into regular
+// boost::log records later on. The records go through the commonpp sinks
+// and formatter like any other.
+//
+// Arithmetic types, enums, pointers, strings and the stream manipulators
+// are copied as is, the C strings (pointers to char, signed char and
+// unsigned char) by content. Any other type is formatted on the logging
+// thread, unless deferred_by_copy is specialized for it: it is then copied and its
+// operator<< is called by the background thread, it must therefore not
+// refer to memory it does not own.
+//
+// When the ring of a thread is full the records are dropped and counted.
+class DeferredLogger
+{
+public:
+    explicit DeferredLogger(const std::string& channel);
+
+    const std::string& channel() const noexcept
+    {
+        return *channel_;
+    }
+
+    bool is_enabled(LoggingLevel level) const noexcept
+    {
+        return level >= min_level_->load(std::memory_order_relaxed);
+    }
+
+private:
+    // interned, never released
+    const std::string* channel_;
+    const std::atomic<int>* min_level_;
+};
+
+#define CREATE_DEFERRED_LOGGER(logger, component_name)                         \
+    static ::commonpp::core::DeferredLogger logger(component_name)
+
+template <typename T>
+struct deferred_by_copy
+    : std::bool_constant<std::is_arithmetic_v<T> || std::is_enum_v<T> ||
+                         std::is_pointer_v<T>>
+{
+};
+
+// clang-format off
+template <> struct deferred_by_copy<decltype(std::setw(0))> : std::true_type {};
+template <> struct deferred_by_copy<decltype(std::setprecision(0))> : std::true_type {};
+template <> struct deferred_by_copy<decltype(std::setbase(0))> : std::true_type {};
+template <> struct deferred_by_copy<decltype(std::setfill(' '))> : std::true_type {};
+template <> struct deferred_by_copy<detail::LogSample> : std::true_type {};
+// clang-format on
+
+struct DeferredLoggingStats
+{
+    // records lost because the ring of their thread was full
+    uint64_t dropped = 0;
+    uint64_t decoded = 0;
+    size_t threads = 0;
+};
+
+// Size of the rings of the threads logging for the first time after the
+// call, 1MiB by default.
+void set_deferred_ring_size(size_t bytes);
+// Waits for the records logged so far to reach the sinks.
+void flush_deferred_logging();
+DeferredLoggingStats deferred_logging_stats();
+
+namespace detail
+{
+
+struct DeferredRing;
+
+enum class DeferredArg : uint8_t
+{
+    Bool,
+    Char,
+    Int,
+    UInt,
+    Double,
+    String,
+    Copy,
+    IosManip,
+    OstreamManip,
+};
+
+struct DeferredHeader
+{
+    // header and arguments, the next record starts at the following
+    // multiple of 8
+    uint32_t size;
+    uint32_t severity;
+    // see thread::get_current_thread_name_id()
+    uint32_t thread_name;
+    const std::string* channel;
+    TscClock::rep timestamp;
+};
+
+// returns the size of the decoded argument
+template <typename T>
+size_t decode_copy(std::ostream& os, const char* data)
+{
+    alignas(T) unsigned char storage[sizeof(T)];
+    std::memcpy(storage, data, sizeof(T));
+    os << *std::launder(reinterpret_cast<const T*>(storage));
+    return sizeof(T);
+}
+
+using DecodeCopy = size_t (*)(std::ostream&, const char*);
+using IosManip = std::ios_base& (*)(std::ios_base&);
+using OstreamManip = std::ostream& (*)(std::ostream&);
+
+template <typename T>
+constexpr bool is_char_v =
+    std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+    std::is_same_v<T, unsigned char> || std::is_same_v<T, wchar_t> ||
+    std::is_same_v<T, char8_t> || std::is_same_v<T, char16_t> ||
+    std::is_same_v<T, char32_t>;
+
+template <typename T>
+constexpr bool is_char_pointer_v =
+    std::is_pointer_v<T> && is_char_v<std::remove_const_t<std::remove_pointer_t<T>>>;
+
+// Per thread staging buffer: a record is encoded here then copied at once
+// in the ring of the thread. A record opened while another one is being
+// built (e.g. from an operator<<) gets the buffer of a nested stream.
+class DeferredStream
+{
+public:
+    explicit DeferredStream(DeferredRing* ring);
+    ~DeferredStream();
+    DeferredStream(const DeferredStream&) = delete;
+    DeferredStream& operator=(const DeferredStream&) = delete;
+
+    bool is_open() const noexcept
+    {
+        return open_;
+    }
+
+    // the stream of the records opened while this one is
+    DeferredStream& nested();
+
+    void begin(const std::string* channel, LoggingLevel level) noexcept
+    {
+        open_ = true;
+        auto header = reinterpret_cast<DeferredHeader*>(buffer_);
+        header->severity = level;
+        header->channel = channel;
+        header->timestamp = TscClock::now().time_since_epoch().count();
+        cur_ = buffer_ + sizeof(DeferredHeader);
+    }
+
+    void commit() noexcept;
+
+    void discard() noexcept
+    {
+        open_ = false;
+    }
+
+    template <typename T>
+    DeferredStream& operator<<(const T& value)
+    {
+        using U = std::decay_t<T>;
+
+        if constexpr (std::is_same_v<U, bool>)
+        {
+            put(DeferredArg::Bool, value);
+        }
+        else if constexpr (std::is_same_v<U, char>)
+        {
+            put(DeferredArg::Char, value);
+        }
+        else if constexpr (std::is_integral_v<U> && !is_char_v<U> &&
+                           std::is_signed_v<U>)
+        {
+            put(DeferredArg::Int, static_cast<int64_t>(value));
+        }
+        else if constexpr (std::is_integral_v<U> && !is_char_v<U>)
+        {
+            put(DeferredArg::UInt, static_cast<uint64_t>(value));
+        }
+        else if constexpr (std::is_same_v<U, float> || std::is_same_v<U, double>)
+        {
+            put(DeferredArg::Double, static_cast<double>(value));
+        }
+        else if constexpr (std::is_array_v<T> &&
+                           std::is_same_v<std::remove_extent_t<T>, char>)
+        {
+            put_string(value);
+        }
+        else if constexpr (is_char_pointer_v<U>)
+        {
+            // printed as a C string by std::ostream, the pointee is copied
+            using C = std::remove_const_t<std::remove_pointer_t<U>>;
+            static_assert(std::is_same_v<C, char> || std::is_same_v<C, signed char> ||
+                              std::is_same_v<C, unsigned char>,
+                          "wide character strings cannot be logged");
+            put_string(value ? std::string_view(reinterpret_cast<const char*>(value))
+                             : std::string_view("(null)"));
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            put_string(value);
+        }
+        else if constexpr (deferred_by_copy<U>::value)
+        {
+            static_assert(std::is_trivially_copyable_v<U>,
+                          "deferred_by_copy types must be trivially copyable");
+            reserve(1 + sizeof(DecodeCopy) + sizeof(U));
+            *cur_++ = static_cast<char>(DeferredArg::Copy);
+            DecodeCopy decode = &decode_copy<U>;
+            std::memcpy(cur_, &decode, sizeof(decode));
+            std::memcpy(cur_ + sizeof(decode), &value, sizeof(U));
+            cur_ += sizeof(decode) + sizeof(U);
+        }
+        else
+        {
+            std::ostringstream os;
+            os << value;
+            put_string(os.str());
+        }
+
+        return *this;
+    }
+
+    DeferredStream& operator<<(IosManip manip)
+    {
+        put(DeferredArg::IosManip, manip);
+        return *this;
+    }
+
+    DeferredStream& operator<<(OstreamManip manip)
+    {
+        put(DeferredArg::OstreamManip, manip);
+        return *this;
+    }
+
+private:
+    template <typename T>
+    void put(DeferredArg type, const T& value)
+    {
+        reserve(1 + sizeof(T));
+        *cur_ = static_cast<char>(type);
+        std::memcpy(cur_ + 1, &value, sizeof(T));
+        cur_ += 1 + sizeof(T);
+    }
+
+    void put_string(std::string_view str)
+    {
+        auto size = static_cast<uint32_t>(str.size());
+        reserve(1 + sizeof(size) + str.size());
+        *cur_ = static_cast<char>(DeferredArg::String);
+        std::memcpy(cur_ + 1, &size, sizeof(size));
+        std::memcpy(cur_ + 1 + sizeof(size), str.data(), str.size());
+        cur_ += 1 + sizeof(size) + str.size();
+    }
+
+    void reserve(size_t size)
+    {
+        if (BOOST_UNLIKELY(static_cast<size_t>(end_ - cur_) < size))
+        {
+            grow(size);
+        }
+    }
+
+    void grow(size_t size);
+
+private:
+    DeferredRing* ring_;
+    char* buffer_;
+    char* cur_;
+    char* end_;
+    bool open_ = false;
+    std::unique_ptr<DeferredStream> nested_;
+};
+
+extern thread_local DeferredStream* current_deferred_stream;
+DeferredStream& create_deferred_stream();
+
+inline DeferredStream& deferred_stream()
+{
+    auto stream = current_deferred_stream;
+    if (BOOST_LIKELY(stream != nullptr))
+    {
+        return *stream;
+    }
+
+    return create_deferred_stream();
+}
+
+class DeferredRecord
+{
+public:
+    explicit DeferredRecord(DeferredStream* stream) noexcept
+    : stream_(stream)
+    {
+    }
+
+    bool operator!() const noexcept
+    {
+        return stream_ == nullptr;
+    }
+
+private:
+    friend class DeferredPump;
+    DeferredStream* stream_;
+};
+
+// Commits the record once the statement is complete, unless it threw.
+class DeferredPump
+{
+public:
+    explicit DeferredPump(DeferredRecord& record) noexcept
+    : record_(record)
+    , exceptions_(std::uncaught_exceptions())
+    {
+    }
+
+    DeferredPump(const DeferredPump&) = delete;
+    DeferredPump& operator=(const DeferredPump&) = delete;
+
+    ~DeferredPump()
+    {
+        auto stream = record_.stream_;
+        record_.stream_ = nullptr;
+        if (BOOST_LIKELY(std::uncaught_exceptions() <= exceptions_))
+        {
+            stream->commit();
+        }
+        else
+        {
+            stream->discard();
+        }
+    }
+
+    DeferredStream& stream() noexcept
+    {
+        return *record_.stream_;
+    }
+
+private:
+    DeferredRecord& record_;
+    int exceptions_;
+};
+
+inline bool is_enabled(const DeferredLogger& logger, LoggingLevel level) noexcept
+{
+    return logger.is_enabled(level);
+}
+
+inline DeferredRecord open_record(DeferredLogger& logger,
+                                  LoggingLevel level,
+                                  const char* /* file */,
+                                  unsigned /* line */)
+{
+    auto* stream = &deferred_stream();
+    while (BOOST_UNLIKELY(stream->is_open()))
+    {
+        stream = &stream->nested();
+    }
+
+    stream->begin(&logger.channel(), level);
+    return DeferredRecord(stream);
+}
+
+inline DeferredPump make_pump(DeferredLogger&, DeferredRecord& record)
+{
+    return DeferredPump(record);
+}
+
+// Decodes what remains in the rings and stops the background thread.
+void stop_deferred_logging();
+
+} // namespace detail
+} // namespace core
+} // namespace commonpp
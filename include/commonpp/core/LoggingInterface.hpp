@@ -11,8 +11,19 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <iosfwd>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -22,12 +33,18 @@
 #include <boost/log/common.hpp>
 #include <boost/log/core.hpp>
 #include <boost/log/expressions/keyword.hpp>
+#include <boost/log/keywords/severity.hpp>
+#include <boost/log/sinks/sink.hpp>
 #include <boost/log/sources/logger.hpp>
+#include <boost/log/sources/record_ostream.hpp>
 #include <boost/log/sources/severity_channel_logger.hpp>
 #include <boost/log/sources/severity_feature.hpp>
 #include <boost/log/sources/severity_logger.hpp>
+#include <boost/log/utility/formatting_ostream.hpp>
 
+#include <commonpp/core/TscClock.hpp>
 #include <commonpp/core/config.hpp>
+#include <commonpp/core/string/date.hpp>
 
 namespace commonpp
 {
@@ -94,8 +111,400 @@ BOOST_LOG_ATTRIBUTE_KEYWORD(Severity, "Severity", LoggingLevel);
 BOOST_LOG_ATTRIBUTE_KEYWORD(Channel, "Channel", std::string);
 BOOST_LOG_ATTRIBUTE_KEYWORD(CommonppRecord, "CommonppRecord", bool);
 
-using BasicLogger = boost::log::sources::severity_logger_mt<LoggingLevel>;
-using Logger = boost::log::sources::severity_channel_logger_mt<LoggingLevel>;
+// The value of the "ThreadName" attribute: the interned name of the thread
+// which opened the record (see thread::get_current_thread_name_id()). The
+// record only carries the id, the name is looked up when it is written.
+//
+// This attribute used to be a std::string: a filter or a formatter reading
+// expr::attr<std::string>("ThreadName") finds no value anymore, it must use
+// the ThreadName keyword (or InternedThreadName) and str(), or compare the
+// value to a string.
+struct InternedThreadName
+{
+    uint32_t id;
+
+    const std::string& str() const noexcept;
+};
+
+std::ostream& operator<<(std::ostream& os, InternedThreadName name);
+
+inline bool operator==(InternedThreadName name, const std::string& str) noexcept
+{
+    return name.str() == str;
+}
+
+inline bool operator!=(InternedThreadName name, const std::string& str) noexcept
+{
+    return !(name == str);
+}
+
+BOOST_LOG_ATTRIBUTE_KEYWORD(ThreadName, "ThreadName", InternedThreadName);
+
+namespace detail
+{
+// The minimum level of a channel, kept up to date by set_logging_level()
+// and set_logging_level_for_channel(). The cells are never destroyed.
+const std::atomic<int>& channel_min_level(const std::string& channel);
+const std::atomic<int>& global_min_level();
+} // namespace detail
+
+// The commonpp loggers cache the minimum level of their channel: a disabled
+// statement costs a relaxed load instead of opening a record and running
+// the core filter. The cache follows the channel given at construction.
+class BasicLogger : public boost::log::sources::severity_logger_mt<LoggingLevel>
+{
+    using base_type = boost::log::sources::severity_logger_mt<LoggingLevel>;
+
+public:
+    BasicLogger()
+    : min_level_(&detail::global_min_level())
+    {
+    }
+
+    template <typename ArgsT>
+    explicit BasicLogger(const ArgsT& args)
+    : base_type(args)
+    , min_level_(&detail::global_min_level())
+    {
+    }
+
+    bool is_enabled(LoggingLevel level) const noexcept
+    {
+        return level >= min_level_->load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::atomic<int>* min_level_;
+};
+
+class Logger : public boost::log::sources::severity_channel_logger_mt<LoggingLevel>
+{
+    using base_type = boost::log::sources::severity_channel_logger_mt<LoggingLevel>;
+
+public:
+    Logger()
+    : channel_name_(channel())
+    , min_level_(&detail::channel_min_level(channel_name_))
+    {
+    }
+
+    template <typename ArgsT>
+    explicit Logger(const ArgsT& args)
+    : base_type(args)
+    , channel_name_(channel())
+    , min_level_(&detail::channel_min_level(channel_name_))
+    {
+    }
+
+    bool is_enabled(LoggingLevel level) const noexcept
+    {
+        return level >= min_level_->load(std::memory_order_relaxed);
+    }
+
+    // the channel given at construction, read without lock
+    const std::string& channel_name() const noexcept
+    {
+        return channel_name_;
+    }
+
+private:
+    std::string channel_name_;
+    const std::atomic<int>* min_level_;
+};
+
+// Every thread logging through it lazily gets its own unsynchronized
+// source, with the channel and the attributes of the logger: opening a
+// record takes no lock. The attributes must be added before the first
+// record, they are copied in the sources when they are created.
+//
+// The ids of the destroyed loggers are reused: a thread keeps at most one
+// source per logger alive at once, until it exits.
+class ThreadLocalLogger
+{
+public:
+    using source_type = boost::log::sources::severity_channel_logger<LoggingLevel>;
+
+    explicit ThreadLocalLogger(std::string channel);
+    ~ThreadLocalLogger();
+
+    ThreadLocalLogger(const ThreadLocalLogger&) = delete;
+    ThreadLocalLogger& operator=(const ThreadLocalLogger&) = delete;
+
+    bool is_enabled(LoggingLevel level) const noexcept
+    {
+        return level >= min_level_->load(std::memory_order_relaxed);
+    }
+
+    void add_attribute(const boost::log::attribute_name& name,
+                       const boost::log::attribute& attribute);
+
+    const std::string& channel() const noexcept
+    {
+        return channel_;
+    }
+
+    // the source of the calling thread
+    source_type& source();
+
+private:
+    ThreadLocalLogger(std::string channel, std::pair<size_t, uint64_t> id);
+
+    source_type& create_source();
+
+    const std::string channel_;
+    const size_t id_;
+    const uint64_t generation_;
+    const std::atomic<int>* min_level_;
+
+    std::mutex attributes_lock_;
+    boost::log::attribute_set attributes_;
+};
+
+namespace detail
+{
+// any other boost::log logger goes through the core filter only
+template <typename OtherLogger>
+inline bool is_enabled(const OtherLogger&, LoggingLevel) noexcept
+{
+    return true;
+}
+
+inline bool is_enabled(const BasicLogger& logger, LoggingLevel level) noexcept
+{
+    return logger.is_enabled(level);
+}
+
+inline bool is_enabled(const Logger& logger, LoggingLevel level) noexcept
+{
+    return logger.is_enabled(level);
+}
+
+inline bool is_enabled(const ThreadLocalLogger& logger, LoggingLevel level) noexcept
+{
+    return logger.is_enabled(level);
+}
+
+// The level from which the flight recorder captures the records (see
+// enable_flight_recorder()), above fatal while it is disabled.
+extern std::atomic<int> flight_recorder_level;
+
+// A statement of a commonpp logger below the logging levels is captured by
+// the flight recorder without opening a boost record: the message is
+// streamed in a per thread buffer then copied in the ring of the thread.
+template <typename OtherLogger>
+inline bool is_captured(const OtherLogger&, LoggingLevel) noexcept
+{
+    return false;
+}
+
+inline bool is_captured_level(LoggingLevel level) noexcept
+{
+    return BOOST_UNLIKELY(level >= flight_recorder_level.load(std::memory_order_relaxed));
+}
+
+inline bool is_captured(const BasicLogger&, LoggingLevel level) noexcept
+{
+    return is_captured_level(level);
+}
+
+inline bool is_captured(const Logger&, LoggingLevel level) noexcept
+{
+    return is_captured_level(level);
+}
+
+inline bool is_captured(const ThreadLocalLogger&, LoggingLevel level) noexcept
+{
+    return is_captured_level(level);
+}
+
+// A record being captured, nested when a captured statement runs while
+// another one is being streamed (e.g. from an operator<<).
+struct CaptureStream
+{
+    std::string message;
+    boost::log::formatting_ostream stream{message};
+    bool open = false;
+    std::unique_ptr<CaptureStream> nested;
+};
+
+CaptureStream& open_capture();
+// pushes the message in the ring of the thread unless discarded
+void close_capture(CaptureStream& capture,
+                   LoggingLevel level,
+                   std::string_view channel,
+                   bool discard) noexcept;
+
+// What open_record returns for the commonpp loggers: the boost record of a
+// logged statement, or what the flight recorder needs of a captured one.
+struct LogRecord
+{
+    boost::log::record record;
+    bool captured = false;
+    LoggingLevel level = trace;
+    std::string_view channel;
+
+    bool operator!() const noexcept
+    {
+        return !record && !captured;
+    }
+};
+
+template <typename Source>
+inline LogRecord open_log_record(Source& source,
+                                 bool logged,
+                                 LoggingLevel level,
+                                 std::string_view channel)
+{
+    if (BOOST_LIKELY(logged))
+    {
+        return {source.open_record((boost::log::keywords::severity = level)), false,
+                level, channel};
+    }
+    return {boost::log::record(), true, level, channel};
+}
+
+// A record_ostream of the calling thread attached to a record, reused from
+// one record to the next. The records opened while it is attached get a
+// nested one.
+struct RecordStream
+{
+    boost::log::record_ostream stream;
+    bool open = false;
+    std::unique_ptr<RecordStream> nested;
+};
+
+RecordStream& open_record_stream(boost::log::record& rec);
+
+// The record_pump of boost::log, or the capture: both stream in a
+// formatting_ostream.
+template <typename Source>
+class LogPump
+{
+public:
+    LogPump(Source& source, LogRecord& rec)
+    : source_(source)
+    , record_(rec)
+    , exceptions_(std::uncaught_exceptions())
+    {
+        if (BOOST_LIKELY(!rec.captured))
+        {
+            stream_ = &open_record_stream(rec.record);
+        }
+        else
+        {
+            capture_ = &open_capture();
+        }
+    }
+
+    LogPump(const LogPump&) = delete;
+    LogPump& operator=(const LogPump&) = delete;
+
+    ~LogPump() noexcept(false)
+    {
+        bool discard = std::uncaught_exceptions() > exceptions_;
+        if (BOOST_LIKELY(stream_ != nullptr))
+        {
+            Release release{stream_};
+            if (!discard)
+            {
+                source_.push_record(boost::move(stream_->stream.get_record()));
+            }
+        }
+        else
+        {
+            record_.captured = false;
+            close_capture(*capture_, record_.level, record_.channel, discard);
+        }
+    }
+
+    boost::log::formatting_ostream& stream() const noexcept
+    {
+        if (BOOST_LIKELY(stream_ != nullptr))
+        {
+            return stream_->stream;
+        }
+        return capture_->stream;
+    }
+
+private:
+    struct Release
+    {
+        ~Release()
+        {
+            stream->stream.detach_from_record();
+            stream->open = false;
+        }
+
+        RecordStream* stream;
+    };
+
+    Source& source_;
+    LogRecord& record_;
+    const int exceptions_;
+    RecordStream* stream_ = nullptr;
+    CaptureStream* capture_ = nullptr;
+};
+
+// What BOOST_LOG_SEV does with a boost::log logger, LOG_SEV goes through
+// these so that other logger kinds (see DeferredLogging.hpp) can provide
+// their own record and stream.
+template <typename BoostLogger>
+inline LogRecord open_record(BoostLogger& logger,
+                             LoggingLevel level,
+                             const char* /* file */,
+                             unsigned /* line */)
+{
+    return open_log_record(logger, true, level, {});
+}
+
+template <typename BoostLogger>
+inline LogPump<BoostLogger> make_pump(BoostLogger& logger, LogRecord& rec)
+{
+    return LogPump<BoostLogger>(logger, rec);
+}
+
+inline LogRecord open_record(BasicLogger& logger,
+                             LoggingLevel level,
+                             const char* /* file */,
+                             unsigned /* line */)
+{
+    return open_log_record(logger, logger.is_enabled(level), level, {});
+}
+
+inline LogPump<BasicLogger> make_pump(BasicLogger& logger, LogRecord& rec)
+{
+    return LogPump<BasicLogger>(logger, rec);
+}
+
+inline LogRecord open_record(Logger& logger,
+                             LoggingLevel level,
+                             const char* /* file */,
+                             unsigned /* line */)
+{
+    return open_log_record(logger, logger.is_enabled(level), level,
+                           logger.channel_name());
+}
+
+inline LogPump<Logger> make_pump(Logger& logger, LogRecord& rec)
+{
+    return LogPump<Logger>(logger, rec);
+}
+
+inline LogRecord open_record(ThreadLocalLogger& logger,
+                             LoggingLevel level,
+                             const char* /* file */,
+                             unsigned /* line */)
+{
+    bool logged = logger.is_enabled(level);
+    return open_log_record(logger.source(), logged, level, logger.channel());
+}
+
+inline LogPump<ThreadLocalLogger::source_type> make_pump(ThreadLocalLogger& logger,
+                                                         LogRecord& rec)
+{
+    return LogPump<ThreadLocalLogger::source_type>(logger.source(), rec);
+}
+} // namespace detail
 
 #define COMPONENT(component_name)                                              \
     (boost::log::keywords::channel = component_name)
@@ -160,20 +569,254 @@ FWD_DECLARE_LOGGER(global_logger, BasicLogger);
         return l;                                                              \
     }();
 
-#define LOG_SEV(l, s) BOOST_LOG_SEV(l, s)
+// The same as CREATE_LOGGER for a ThreadLocalLogger, used with the same
+// LOG() macros.
+#define CREATE_THREAD_LOCAL_LOGGER(logger, component_name)                     \
+    static auto& logger = []() -> ::commonpp::core::ThreadLocalLogger&         \
+    {                                                                          \
+        static ::commonpp::core::ThreadLocalLogger l(component_name);          \
+        l.add_attribute("CommonppRecord",                                      \
+                        boost::log::attributes::constant<bool>(true));         \
+        return l;                                                              \
+    }();
+
+#define CREATE_THREAD_LOCAL_LOGGER_WITH_INIT(logger, component_name,           \
+                                             init_fn_like)                     \
+    static auto& logger = []() -> ::commonpp::core::ThreadLocalLogger&         \
+    {                                                                          \
+        static ::commonpp::core::ThreadLocalLogger l(component_name);          \
+        l.add_attribute("CommonppRecord",                                      \
+                        boost::log::attributes::constant<bool>(true));         \
+        init_fn_like(l);                                                       \
+        return l;                                                              \
+    }();
+
+// A statement below COMMONPP_LOG_MIN_LEVEL (see config.hpp) is dead code:
+// no record is opened and the streamed expressions are never evaluated.
+// Above it, the level cached by the logger is checked first.
+#define COMMONPP_LOG_ENABLED(s) ((s) >= COMMONPP_LOG_MIN_LEVEL)
+
+#define LOG_SEV(l, s)                                                          \
+    for (bool commonpp_log_enabled_ =                                          \
+             COMMONPP_LOG_ENABLED(s) &&                                        \
+             (::commonpp::core::detail::is_enabled(l, s) ||                    \
+              ::commonpp::core::detail::is_captured(l, s));                    \
+         commonpp_log_enabled_; commonpp_log_enabled_ = false)                 \
+        for (auto commonpp_log_record_ = ::commonpp::core::detail::open_record( \
+                 l, s, __FILE__, __LINE__);                                    \
+             !!commonpp_log_record_;)                                          \
+    ::commonpp::core::detail::make_pump(l, commonpp_log_record_).stream()
 #define GLOG_SEV(sev) LOG_SEV(::commonpp::core::global_logger, sev)
-#define LOG(l, s) BOOST_LOG_SEV(l, ::commonpp::s)
+#define LOG(l, s) LOG_SEV(l, ::commonpp::s)
 #define GLOG(sev) LOG(::commonpp::core::global_logger, sev)
+
+namespace detail
+{
+// What a sampled statement should do: emit or not, and how many records
+// of the call site were suppressed since the last one emitted.
+struct LogSample
+{
+    bool emit = false;
+    uint64_t suppressed = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const LogSample& sample)
+{
+    if (sample.suppressed)
+    {
+        os << "[suppressed " << sample.suppressed << " messages] ";
+    }
+    return os;
+}
+
+// The per call site states, a single atomic updated by the enabled
+// statements only.
+class EveryNSite
+{
+public:
+    LogSample sample(uint64_t n) noexcept
+    {
+        auto count = count_.fetch_add(1, std::memory_order_relaxed);
+        if (n <= 1)
+        {
+            return {true, 0};
+        }
+        return {count % n == 0, count == 0 ? 0 : n - 1};
+    }
+
+private:
+    std::atomic<uint64_t> count_{0};
+};
+
+class FirstNSite
+{
+public:
+    LogSample sample(uint64_t n) noexcept
+    {
+        // stop writing the cache line once done
+        if (count_.load(std::memory_order_relaxed) >= n)
+        {
+            return {};
+        }
+        return {count_.fetch_add(1, std::memory_order_relaxed) < n, 0};
+    }
+
+private:
+    std::atomic<uint64_t> count_{0};
+};
+
+class EveryTSite
+{
+public:
+    template <typename Duration>
+    LogSample sample(Duration period) noexcept
+    {
+        auto now = TscClock::now().time_since_epoch().count();
+        auto next = next_.load(std::memory_order_relaxed);
+        if (now >= next &&
+            next_.compare_exchange_strong(
+                next,
+                now + std::chrono::duration_cast<TscClock::duration>(period).count(),
+                std::memory_order_relaxed))
+        {
+            return {true, suppressed_.exchange(0, std::memory_order_relaxed)};
+        }
+
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+private:
+    std::atomic<TscClock::rep> next_{std::numeric_limits<TscClock::rep>::min()};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+// Token bucket of burst tokens refilled at rate per second, implemented as
+// the equivalent generic cell rate algorithm: only the theoretical arrival
+// time of the next record is stored. A rate that is not positive never
+// emits.
+class RateLimitedSite
+{
+public:
+    LogSample sample(double rate, uint64_t burst) noexcept
+    {
+        // also false for NaN
+        if (BOOST_UNLIKELY(!(rate > 0)))
+        {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+
+        // computed in double and clamped, now + tolerance + interval
+        // cannot overflow for the tiny rates or the huge bursts
+        const double interval_ns = std::min(1e9 / rate, MAX_NS);
+        const auto interval = static_cast<TscClock::rep>(interval_ns);
+        const auto tolerance = static_cast<TscClock::rep>(std::min(
+            interval_ns * static_cast<double>(std::max<uint64_t>(burst, 1) - 1), MAX_NS));
+        auto now = TscClock::now().time_since_epoch().count();
+
+        auto tat = tat_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto start = std::max(tat, now);
+            if (start - now > tolerance)
+            {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return {};
+            }
+
+            if (tat_.compare_exchange_weak(tat, start + interval,
+                                           std::memory_order_relaxed))
+            {
+                return {true, suppressed_.exchange(0, std::memory_order_relaxed)};
+            }
+        }
+    }
+
+private:
+    // about 73 years
+    static constexpr double MAX_NS =
+        static_cast<double>(std::numeric_limits<TscClock::rep>::max() / 4);
+
+    std::atomic<TscClock::rep> tat_{std::numeric_limits<TscClock::rep>::min()};
+    std::atomic<uint64_t> suppressed_{0};
+};
+} // namespace detail
+
+// The call site state lives in a static of a lambda unique to the
+// expansion. A suppressed statement evaluates none of its streamed
+// expressions, an emitted one is prefixed with the number of records
+// suppressed since the previous one.
+#define COMMONPP_LOG_SAMPLED(l, s, site_type, ...)                             \
+    for (::commonpp::core::detail::LogSample commonpp_log_sample_ =            \
+             COMMONPP_LOG_ENABLED(s) &&                                        \
+                     ::commonpp::core::detail::is_enabled(l, s)                \
+                 ? []() -> site_type& {                                        \
+                       static site_type site;                                  \
+                       return site;                                            \
+                   }()                                                         \
+                       .sample(__VA_ARGS__)                                    \
+                 : ::commonpp::core::detail::LogSample{};                      \
+         commonpp_log_sample_.emit; commonpp_log_sample_.emit = false)         \
+    LOG_SEV(l, s) << commonpp_log_sample_
+
+// one record out of n
+#define LOG_EVERY_N(l, sev, n)                                                 \
+    COMMONPP_LOG_SAMPLED(l, ::commonpp::sev,                                   \
+                         ::commonpp::core::detail::EveryNSite, n)
+// the n first records only
+#define LOG_FIRST_N(l, sev, n)                                                 \
+    COMMONPP_LOG_SAMPLED(l, ::commonpp::sev,                                   \
+                         ::commonpp::core::detail::FirstNSite, n)
+// at most one record per period (a std::chrono duration)
+#define LOG_EVERY_T(l, sev, period)                                            \
+    COMMONPP_LOG_SAMPLED(l, ::commonpp::sev,                                   \
+                         ::commonpp::core::detail::EveryTSite, period)
+// rate records per second on average, up to burst at once
+#define LOG_RATE_LIMITED(l, sev, rate, burst)                                  \
+    COMMONPP_LOG_SAMPLED(l, ::commonpp::sev,                                   \
+                         ::commonpp::core::detail::RateLimitedSite, rate, burst)
+
+#define GLOG_EVERY_N(sev, n) LOG_EVERY_N(::commonpp::core::global_logger, sev, n)
+#define GLOG_FIRST_N(sev, n) LOG_FIRST_N(::commonpp::core::global_logger, sev, n)
+#define GLOG_EVERY_T(sev, period)                                              \
+    LOG_EVERY_T(::commonpp::core::global_logger, sev, period)
+#define GLOG_RATE_LIMITED(sev, rate, burst)                                    \
+    LOG_RATE_LIMITED(::commonpp::core::global_logger, sev, rate, burst)
+
+namespace detail
+{
+struct NoScope
+{
+    template <typename... Args>
+    explicit NoScope(const Args&...) noexcept
+    {
+    }
+};
+
+template <bool enabled>
+using FunctionScope =
+    std::conditional_t<enabled, boost::log::attributes::named_scope::sentry, NoScope>;
+} // namespace detail
+
+// ENABLE_CURRENT_FCT_LOGGING() for a statement of this level, nothing is
+// pushed below COMMONPP_LOG_MIN_LEVEL.
+#define COMMONPP_LOG_FUNCTION_SCOPE(s)                                         \
+    ::commonpp::core::detail::FunctionScope<COMMONPP_LOG_ENABLED(s)>           \
+    BOOST_LOG_UNIQUE_IDENTIFIER_NAME(commonpp_log_scope_)(                     \
+        BOOST_CURRENT_FUNCTION, __FILE__, __LINE__,                            \
+        ::boost::log::attributes::named_scope_entry::function)
+
 #define TRACE(sev)                                                             \
-    ENABLE_CURRENT_FCT_LOGGING();                                              \
+    COMMONPP_LOG_FUNCTION_SCOPE(::commonpp::sev);                              \
     GLOG(sev)
 #define TRACE_LOG(l, sev)                                                      \
-    ENABLE_CURRENT_FCT_LOGGING();                                              \
+    COMMONPP_LOG_FUNCTION_SCOPE(::commonpp::sev);                              \
     LOG(l, sev)
 
 // clang-format off
 #ifndef NDEBUG
-# define DLOG(l, s) BOOST_LOG_SEV(l, commonpp::s)
+# define DLOG(l, s) LOG(l, s)
 # define DGLOG(sev) LOG(::commonpp::core::global_logger, sev)
 #else
 // LOG() and GLOG() are way too complex to be in a ternary expression.
@@ -192,17 +835,21 @@ struct Voidify { void operator&(NullSink&){}};
 #endif
 // clang-format on
 
-#define DTRACE(sev)                                                            \
-    ENABLE_CURRENT_FCT_LOGGING();                                              \
-    DGLOG(sev)
-#define DTRACE_LOG(l, sev)                                                     \
-    ENABLE_CURRENT_FCT_LOGGING();                                              \
-    DLOG(l, sev)
+#ifndef NDEBUG
+# define DTRACE(sev) TRACE(sev)
+# define DTRACE_LOG(l, sev) TRACE_LOG(l, sev)
+#else
+# define DTRACE(sev) DGLOG(sev)
+# define DTRACE_LOG(l, sev) DLOG(l, sev)
+#endif
 
 void init_logging();
 void enable_console_logging();
 void enable_builtin_syslog();
 void auto_flush_console(bool b = true);
+// format of the timestamps written by the commonpp sinks, see
+// string::TimestampFormat
+void set_log_timestamp_format(string::TimestampFormat format);
 void set_logging_level(LoggingLevel level);
 
 // default file pattern looks like: file_2008-07-05_13-44-23.1.log
@@ -212,13 +859,175 @@ void add_file_sink_rotate(
     size_t max_size = 0,
     boost::posix_time::hours period = boost::posix_time::hours(1));
 
+struct RotatedFilesOptions
+{
+    // gzip the closed files (when built with zlib), file.log -> file.log.gz
+    bool compress = true;
+    int compression_level = 6;
+    // the oldest closed files are removed beyond these limits, 0 for none
+    uintmax_t max_total_size = 0;
+    std::chrono::hours max_age{0};
+};
+
+// The closed files are handed to a background worker running at idle CPU
+// and IO priority: it compresses them one at a time and applies the
+// retention limits to the closed files matching the path pattern, those of
+// the previous runs included. A file left uncompressed by a previous run
+// is compressed when the sink is created.
+void add_file_sink_rotate(const std::string& path,
+                          size_t max_size,
+                          boost::posix_time::hours period,
+                          const RotatedFilesOptions& options);
+
+struct RotatedFilesStats
+{
+    // closed files waiting for the worker
+    uint64_t pending = 0;
+    uint64_t compressed = 0;
+    // progress, the file being compressed included
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    // by the retention limits
+    uint64_t removed = 0;
+    uint64_t errors = 0;
+};
+
+// the counters of all the rotating sinks with options
+RotatedFilesStats rotated_files_stats();
+
+struct MappedFileOptions
+{
+    // size of every segment, preallocated when the segment is created
+    size_t segment_size = 64 * 1024 * 1024;
+    // the written pages are synced by a background thread at this period,
+    // zero leaves the write back to the kernel
+    std::chrono::milliseconds sync_period = std::chrono::seconds(1);
+};
+
+// Writes the records in preallocated, memory mapped segment files named
+// <prefix>.000001.log, <prefix>.000002.log, ... A background thread
+// prepares the next segment, the rotation only swaps the mapping. A segment
+// is truncated to its content once full. While open, a segment ends with
+// the length of its complete records: after a crash the segments left open
+// are truncated to that length when the sink is created again with the same
+// prefix. When the next segment cannot be created (no space or file left)
+// the records are dropped, their number is written at the beginning of the
+// next segment created.
+void add_mapped_file_sink(const std::string& prefix,
+                          const MappedFileOptions& options = {});
+
+struct FlightRecorderOptions
+{
+    // captured from this level, whatever the logging levels are
+    LoggingLevel level = trace;
+    // bytes per thread, the oldest records are overwritten
+    size_t ring_size = 64 * 1024;
+    // where the rings are dumped, the dumps are appended
+    std::string path = "commonpp-flight-recorder.log";
+    // dumps on SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT before the
+    // previous handler runs
+    bool dump_on_crash = true;
+    // dumps on this signal too (e.g. SIGUSR2), 0 for none
+    int signal = 0;
+};
+
+// Keeps the last commonpp records of every thread in memory, at all levels
+// from options.level, to be dumped when something goes wrong. The records
+// are stored unformatted in a per thread ring by the thread logging them;
+// they are formatted only when dumped. A statement of a commonpp logger
+// below the logging levels opens no boost record: only its message is
+// streamed and copied in the ring, the core and the other sinks never see
+// it. The records of the deferred loggers and the sampled statements are
+// captured when they are logged only. Only the first call has an effect.
+void enable_flight_recorder(const FlightRecorderOptions& options = {});
+
+// Appends the rings, thread by thread, oldest records first, to the file of
+// the options (or to path when given). The rings are left as they are.
+// Returns the number of records written.
+size_t dump_flight_recorder(const std::string& path = "");
+
 // this should be called before any log happens
 void set_logging_level_for_channel(const std::string& channel, LoggingLevel level);
 
+struct GelfOptions
+{
+    // "host" field of the messages, the machine hostname by default
+    std::string host;
+    // zlib compression of the payloads (if commonpp is built with zlib)
+    bool compress = false;
+    // datagram size, longer messages are chunked (at most 128 chunks)
+    size_t max_chunk_size = 1420;
+    // records waiting for the sender thread, the new ones are dropped when
+    // it is full and their number is sent in a message of its own
+    size_t queue_size = 8192;
+};
+
+// Sends the commonpp records as GELF 1.1 UDP messages (Graylog). The
+// records are serialized and sent in batches by a background thread. The
+// static fields are added to every message, prefixed with '_' when needed.
 void add_gelf_sink(
     std::string server,
     std::string port,
-    std::vector<std::pair<std::string, std::string>> static_fields = {});
+    std::vector<std::pair<std::string, std::string>> static_fields = {},
+    const GelfOptions& options = {});
+
+struct GelfStats
+{
+    // records dropped when the queue was full
+    uint64_t dropped = 0;
+    // datagrams the socket did not send
+    uint64_t send_errors = 0;
+};
+
+// the counters of all the GELF sinks
+GelfStats gelf_stats();
+
+// In asynchronous mode the logging thread only pushes the records of the
+// commonpp sinks (console, syslog, files, ...) in a bounded lock-free
+// queue, a single background thread formats and writes them.
+enum class OverflowPolicy
+{
+    // the logging thread waits for some room
+    Block,
+    // the record being logged is dropped
+    DropNewest,
+    // records below keep_level are dropped once the queue is 3/4 full, the
+    // others wait for some room
+    DropBySeverity,
+};
+
+struct AsyncLoggingOptions
+{
+    size_t queue_size = 8192;
+    OverflowPolicy overflow = OverflowPolicy::Block;
+    LoggingLevel keep_level = warning;
+};
+
+struct AsyncLoggingStats
+{
+    uint64_t dropped = 0;
+    uint64_t dropped_by_level[fatal + 1] = {};
+    // records whose logging thread had to wait for some room
+    uint64_t blocked = 0;
+    size_t queued = 0;
+    size_t capacity = 0;
+};
+
+// The sinks already added and the ones added later become asynchronous.
+void enable_async_logging(const AsyncLoggingOptions& options = {});
+// Drains the queue, the sinks are synchronous again. Called at exit.
+void disable_async_logging();
+AsyncLoggingStats async_logging_stats();
+
+// Remove the sinks from the logging core and from the asynchronous
+// dispatcher, the sinks added by commonpp are forgotten: they are not added
+// back by enable_async_logging(). The records already queued are written
+// first. The background thread of a sink (mapped files, GELF, ...) stops
+// with its last reference, i.e. in remove_all_sinks(), and in remove_sink()
+// unless the caller holds another reference. To be used instead of the
+// boost::log core functions.
+void remove_sink(const boost::shared_ptr<boost::log::sinks::sink>& sink);
+void remove_all_sinks();
 
 } // namespace core
 } // namespace commonpp
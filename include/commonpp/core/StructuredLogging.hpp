@@ -0,0 +1,143 @@
+/*
+ * File: include/commonpp/core/StructuredLogging.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <boost/smart_ptr/shared_ptr.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+namespace commonpp
+{
+namespace core
+{
+
+// A typed field of a record, see LOG_KV.
+struct LogField
+{
+    using Value = std::variant<bool, int64_t, uint64_t, double, std::string>;
+
+    std::string name;
+    Value value;
+};
+
+// The value of the "Fields" attribute of the records logged with LOG_KV.
+using LogFields = std::vector<LogField>;
+
+// written by the text formatter as " name=value" pairs
+std::ostream& operator<<(std::ostream& os, const LogField& field);
+std::ostream& operator<<(std::ostream& os, const LogFields& fields);
+
+template <typename T>
+LogField kv(std::string name, T&& value)
+{
+    using U = std::decay_t<T>;
+
+    if constexpr (std::is_same_v<U, bool>)
+    {
+        return {std::move(name), LogField::Value(std::in_place_type<bool>, value)};
+    }
+    else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>)
+    {
+        return {std::move(name),
+                LogField::Value(std::in_place_type<int64_t>, value)};
+    }
+    else if constexpr (std::is_integral_v<U>)
+    {
+        return {std::move(name),
+                LogField::Value(std::in_place_type<uint64_t>, value)};
+    }
+    else if constexpr (std::is_floating_point_v<U>)
+    {
+        return {std::move(name), LogField::Value(std::in_place_type<double>, value)};
+    }
+    else if constexpr (std::is_constructible_v<std::string, T&&>)
+    {
+        return {std::move(name), LogField::Value(std::in_place_type<std::string>,
+                                                 std::forward<T>(value))};
+    }
+    else if constexpr (std::is_convertible_v<const U&, std::string_view>)
+    {
+        return {std::move(name),
+                LogField::Value(std::in_place_type<std::string>,
+                                std::string_view(value))};
+    }
+    else
+    {
+        std::ostringstream os;
+        os << value;
+        return {std::move(name),
+                LogField::Value(std::in_place_type<std::string>, os.str())};
+    }
+}
+
+namespace detail
+{
+const boost::log::attribute_name& fields_attribute_name();
+
+// Attaches the fields to the record being built, the message is then
+// streamed as usual.
+template <typename Message, typename... Fields>
+Message&& with_fields(boost::log::record& rec, Message&& message, Fields&&... fields)
+{
+    LogFields values;
+    values.reserve(sizeof...(Fields));
+    (values.push_back(std::forward<Fields>(fields)), ...);
+    rec.attribute_values().insert(
+        fields_attribute_name(),
+        boost::log::attributes::make_attribute_value(std::move(values)));
+    return std::forward<Message>(message);
+}
+
+// a record captured by the flight recorder keeps its message only
+template <typename Message, typename... Fields>
+Message&& with_fields(LogRecord& rec, Message&& message, Fields&&... fields)
+{
+    if (rec.record)
+    {
+        return with_fields(rec.record, std::forward<Message>(message),
+                           std::forward<Fields>(fields)...);
+    }
+    return std::forward<Message>(message);
+}
+} // namespace detail
+
+// LOG_KV(logger, info, "request served", kv("user", id), kv("ms", duration));
+// The fields are only built when the record is enabled. They are kept
+// typed in the record, the JSON sink writes them as JSON values. This
+// works with the boost::log based loggers only.
+#define LOG_KV(l, sev, message, ...)                                           \
+    LOG(l, sev) << ::commonpp::core::detail::with_fields(                      \
+        commonpp_log_record_, message __VA_OPT__(, ) __VA_ARGS__)
+#define GLOG_KV(sev, message, ...)                                             \
+    LOG_KV(::commonpp::core::global_logger, sev, message __VA_OPT__(, ) __VA_ARGS__)
+
+// One JSON object per line, the commonpp records only:
+// {"timestamp":...,"severity":"info","channel":"...","thread":"...",
+//  "message":"...", <fields>}
+// The fields are written as members of the object, after the fixed ones. A
+// field named after a fixed member is prefixed with '_' ("_message"). When
+// several fields end up with the same member name, only the last one is
+// written, at its place.
+void add_json_sink(boost::shared_ptr<std::ostream> stream);
+void add_json_file_sink(const std::string& path = "file_%Y-%m-%d_%H-%M-%S.%N.json");
+
+} // namespace core
+} // namespace commonpp
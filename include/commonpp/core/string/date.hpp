@@ -11,13 +11,42 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 #include <string>
 
+namespace boost
+{
+namespace posix_time
+{
+class ptime;
+} // namespace posix_time
+} // namespace boost
+
 namespace commonpp
 {
 namespace string
 {
 std::string get_current_date();
 std::string get_date(std::chrono::system_clock::time_point time_point);
+
+enum class TimestampFormat
+{
+    // 2015-07-05 13:44:23.123456
+    Default,
+    // 2015-07-05T13:44:23.123456
+    Iso8601,
+    // microseconds since the epoch, the timestamp being in local time
+    EpochMicros,
+};
+
+static constexpr size_t MAX_TIMESTAMP_SIZE = 32;
+
+// Formats a boost::log TimeStamp without going through the date_time
+// facets. The part up to the seconds is cached per thread, consecutive
+// timestamps within the same second only format their fractional part.
+// Returns the number of characters written to out.
+size_t format_timestamp(const boost::posix_time::ptime& timestamp,
+                        TimestampFormat format,
+                        char (&out)[MAX_TIMESTAMP_SIZE]);
 } // namespace string
 } // namespace commonpp
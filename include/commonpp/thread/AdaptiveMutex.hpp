@@ -0,0 +1,97 @@
+/*
+ * File: include/commonpp/thread/AdaptiveMutex.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Spinlock.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Spins a bounded number of times hoping the holder releases the lock soon,
+// then sleeps (std::atomic::wait, a futex on Linux). The unlock only calls
+// into the kernel when a thread is actually sleeping. This is the mutex
+// described by Drepper in "Futexes Are Tricky".
+class AdaptiveMutex
+{
+public:
+    static constexpr uint32_t DEFAULT_SPINS = 100;
+
+    explicit AdaptiveMutex(uint32_t spins = DEFAULT_SPINS) noexcept
+    : spins_(spins)
+    {
+    }
+
+    AdaptiveMutex(const AdaptiveMutex&) = delete;
+    AdaptiveMutex& operator=(const AdaptiveMutex&) = delete;
+
+    void lock() noexcept
+    {
+        int state = UNLOCKED;
+        for (uint32_t i = 0; i < spins_; ++i)
+        {
+            state = state_.load(std::memory_order_relaxed);
+            if (state == UNLOCKED &&
+                state_.compare_exchange_weak(state, LOCKED, std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            if (state == CONTENDED)
+            {
+                break; // others are already sleeping, don't jump the queue
+            }
+
+            cpu_relax();
+        }
+
+        state = state_.exchange(CONTENDED, std::memory_order_acquire);
+        while (state != UNLOCKED)
+        {
+            state_.wait(CONTENDED, std::memory_order_relaxed);
+            state = state_.exchange(CONTENDED, std::memory_order_acquire);
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        int state = UNLOCKED;
+        return state_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire,
+                                              std::memory_order_relaxed);
+    }
+
+    void unlock() noexcept
+    {
+        if (state_.exchange(UNLOCKED, std::memory_order_release) == CONTENDED)
+        {
+            state_.notify_one();
+        }
+    }
+
+private:
+    enum : int
+    {
+        UNLOCKED = 0,
+        LOCKED = 1,
+        CONTENDED = 2, // locked, and there might be sleepers
+    };
+
+    std::atomic_int state_{UNLOCKED};
+    const uint32_t spins_;
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,164 @@
+/*
+ * File: include/commonpp/thread/BoundedQueue.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "PerThread.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Bounded lock-free multi producer multi consumer queue (Dmitry Vyukov's
+// algorithm): every cell carries a sequence number telling whether it is
+// ready to be written or read for the current lap, a push or a pop is a
+// single CAS on the position when uncontended. The capacity is rounded up
+// to a power of two.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    : capacity_(round_up(capacity))
+    , mask_(capacity_ - 1)
+    , cells_(new Cell[capacity_])
+    {
+        for (size_t i = 0; i < capacity_; ++i)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~BoundedQueue()
+    {
+        auto end = enqueue_pos_.load(std::memory_order_relaxed);
+        for (auto pos = dequeue_pos_.load(std::memory_order_relaxed); pos != end; ++pos)
+        {
+            std::launder(reinterpret_cast<T*>(cells_[pos & mask_].storage))->~T();
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    template <typename U>
+    bool try_push(U&& value)
+    {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells_[pos & mask_];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed))
+                {
+                    new (cell.storage) T(std::forward<U>(value));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& value)
+    {
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells_[pos & mask_];
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) -
+                        static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                                       std::memory_order_relaxed))
+                {
+                    auto ptr = std::launder(reinterpret_cast<T*>(cell.storage));
+                    value = std::move(*ptr);
+                    ptr->~T();
+                    cell.sequence.store(pos + capacity_, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const noexcept
+    {
+        return capacity_;
+    }
+
+    // only a hint when the queue is used concurrently
+    size_t size() const noexcept
+    {
+        auto dequeued = dequeue_pos_.load(std::memory_order_acquire);
+        auto enqueued = enqueue_pos_.load(std::memory_order_acquire);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+private:
+    static size_t round_up(size_t capacity) noexcept
+    {
+        size_t result = 2;
+        while (result < capacity)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos_{0};
+};
+
+} // namespace thread
+} // namespace commonpp
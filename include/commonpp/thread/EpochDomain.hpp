@@ -0,0 +1,181 @@
+/*
+ * File: include/commonpp/thread/EpochDomain.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "PerThread.hpp"
+#include "QuiescentState.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Epoch based reclamation (Fraser). A thread accesses the shared objects
+// of a lock-free structure within a pinned section, an object unlinked and
+// retired is destroyed once the global epoch moved twice, which requires
+// every pinned thread to have observed the new epochs.
+//
+// Any thread can pin itself with a Guard, this costs a store and a fence.
+// The threads of a ThreadPool with enable_quiescent_states() are pinned for
+// their whole life instead and refresh their epoch between two handlers, a
+// handler does not need any Guard.
+//
+// Retired objects are kept in a list per thread and collected by the
+// thread retiring them, without any lock. What a thread leaves when it
+// unregisters or exits is handed to a shared orphan list, drained by the
+// collections of the other threads.
+class EpochDomain final : public QuiescentStateDomain
+{
+public:
+    // retired objects waiting before a collection is attempted
+    static constexpr size_t COLLECT_THRESHOLD = 64;
+
+    class Guard
+    {
+    public:
+        explicit Guard(EpochDomain& domain) noexcept
+        : domain_(&domain)
+        {
+            domain_->enter();
+        }
+
+        ~Guard()
+        {
+            if (domain_)
+            {
+                domain_->leave();
+            }
+        }
+
+        Guard(Guard&& other) noexcept
+        : domain_(std::exchange(other.domain_, nullptr))
+        {
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard& operator=(Guard&&) = delete;
+
+    private:
+        EpochDomain* domain_;
+    };
+
+    EpochDomain() = default;
+    // destroys whatever is still retired, there must be no reader left
+    ~EpochDomain();
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    static EpochDomain& global();
+
+    Guard pin() noexcept
+    {
+        return Guard(*this);
+    }
+
+    void register_thread() noexcept override;
+    void unregister_thread() noexcept override;
+    // Refresh the epoch of a registered thread holding no Guard.
+    void quiescent() noexcept override;
+
+    void retire(std::function<void()> deleter);
+
+    template <typename T>
+    void retire(T* ptr)
+    {
+        retire([ptr] { delete ptr; });
+    }
+
+    // Try to advance the epoch and destroy what the calling thread retired,
+    // and the orphans, that is safe to; returns how many objects were
+    // destroyed.
+    size_t collect();
+
+    // Wait until everything the calling thread retired, and the orphans,
+    // are destroyed. The caller must not hold a Guard.
+    void synchronize();
+
+    uint64_t epoch() const noexcept
+    {
+        return epoch_.load(std::memory_order_relaxed);
+    }
+
+private:
+    using Retired = std::pair<uint64_t, std::function<void()>>;
+
+    struct Record
+    {
+        // (epoch << 1) | 1 while pinned, 0 otherwise
+        std::atomic<uint64_t> state{0};
+        // only accessed by the owner
+        uint32_t nesting = 0;
+        bool exit_hook = false;
+        std::vector<Retired> limbo;
+    };
+
+    struct ThreadExit;
+
+    void enter() noexcept
+    {
+        auto& record = records_.local();
+        if (record.nesting++ == 0)
+        {
+            pin(record);
+        }
+    }
+
+    void leave() noexcept
+    {
+        auto& record = records_.local();
+        if (--record.nesting == 0)
+        {
+            record.state.store(0, std::memory_order_release);
+        }
+    }
+
+    void pin(Record& record) noexcept
+    {
+        record.state.store(epoch_.load(std::memory_order_relaxed) << 1 | 1,
+                           std::memory_order_relaxed);
+        // the scan of try_advance() must see us pinned before we read
+        // anything shared
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    bool try_advance() noexcept;
+    size_t collect(Record& record);
+    void add_exit_hook(Record& record);
+    void orphan(Record& record) noexcept;
+    size_t collect_orphans(uint64_t epoch);
+
+private:
+    std::atomic<uint64_t> epoch_{0};
+    PerThread<Record> records_;
+
+    std::mutex orphans_lock_;
+    std::vector<Retired> orphans_;
+    std::atomic_bool has_orphans_{false};
+
+    // what the exit hooks of the threads refer to, reset when destroyed
+    std::shared_ptr<EpochDomain*> self_{std::make_shared<EpochDomain*>(this)};
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,396 @@
+/*
+ * File: include/commonpp/thread/Fiber.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/context/fiber.hpp>
+#include <boost/context/protected_fixedsize_stack.hpp>
+#include <boost/context/stack_context.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <commonpp/core/traits/is_duration.hpp>
+
+#include "ThreadPool.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Keeps the stacks of finished fibers around so that spawning a fiber does
+// not cost a mmap/munmap pair. Every stack has a guard page below it, an
+// overflow crashes instead of silently corrupting the heap.
+class FiberStackPool
+{
+public:
+    static constexpr std::size_t DEFAULT_STACK_SIZE = 64 * 1024;
+    static constexpr std::size_t DEFAULT_MAX_CACHED = 1024;
+
+    explicit FiberStackPool(std::size_t stack_size = DEFAULT_STACK_SIZE,
+                            std::size_t max_cached = DEFAULT_MAX_CACHED);
+    ~FiberStackPool();
+
+    FiberStackPool(const FiberStackPool&) = delete;
+    FiberStackPool& operator=(const FiberStackPool&) = delete;
+
+    boost::context::stack_context allocate();
+    void deallocate(boost::context::stack_context& sctx) noexcept;
+
+    std::size_t stack_size() const noexcept;
+    std::size_t cached() const;
+
+    // process wide pool used when none is given to spawn_fiber
+    static const std::shared_ptr<FiberStackPool>& default_pool();
+
+private:
+    boost::context::protected_fixedsize_stack allocator_;
+    const std::size_t stack_size_;
+    const std::size_t max_cached_;
+
+    mutable std::mutex lock_;
+    std::vector<boost::context::stack_context> free_;
+};
+
+// Boost.Context StackAllocator concept on top of a FiberStackPool
+class FiberStackAllocator
+{
+public:
+    explicit FiberStackAllocator(std::shared_ptr<FiberStackPool> pool)
+    : pool_(std::move(pool))
+    {
+    }
+
+    boost::context::stack_context allocate()
+    {
+        return pool_->allocate();
+    }
+
+    void deallocate(boost::context::stack_context& sctx) noexcept
+    {
+        pool_->deallocate(sctx);
+    }
+
+private:
+    std::shared_ptr<FiberStackPool> pool_;
+};
+
+namespace detail
+{
+
+class Fiber : public std::enable_shared_from_this<Fiber>
+{
+public:
+    using executor = boost::asio::io_context::executor_type;
+
+    explicit Fiber(executor ex);
+    ~Fiber();
+
+    Fiber(const Fiber&) = delete;
+    Fiber& operator=(const Fiber&) = delete;
+
+    template <typename Callable>
+    void start(const std::shared_ptr<FiberStackPool>& pool, Callable&& callable);
+
+    // Switch back to the thread which resumed us; after_suspend is called
+    // once the switch is done so that it is safe to resume this fiber from
+    // there (or from any other thread).
+    void suspend(std::function<void()> after_suspend = {});
+
+    // Must be called from a thread running the executor
+    void resume();
+
+    const executor& get_executor() const noexcept
+    {
+        return executor_;
+    }
+
+private:
+    executor executor_;
+    boost::context::fiber self_;
+    boost::context::fiber caller_;
+    std::function<void()> after_suspend_;
+    std::exception_ptr exception_;
+};
+
+template <typename Callable>
+void Fiber::start(const std::shared_ptr<FiberStackPool>& pool, Callable&& callable)
+{
+    self_ = boost::context::fiber(
+        std::allocator_arg, FiberStackAllocator(pool),
+        [this, fn = std::forward<Callable>(callable)](
+            boost::context::fiber&& caller) mutable
+        {
+            caller_ = std::move(caller);
+            try
+            {
+                fn();
+            }
+            catch (const boost::context::detail::forced_unwind&)
+            {
+                throw;
+            }
+            catch (...)
+            {
+                exception_ = std::current_exception();
+            }
+
+            return std::move(caller_);
+        });
+}
+
+} // namespace detail
+
+// Completion token given to the fiber body. Any asio asynchronous operation
+// started with it suspends the fiber until the operation completes, the
+// pool thread is free to run other fibers in the mean time.
+//
+// As with boost::asio::yield_context, errors are thrown as
+// boost::system::system_error unless an error_code is bound with
+// operator[].
+class Yield
+{
+public:
+    explicit Yield(detail::Fiber& fiber) noexcept
+    : fiber_(&fiber)
+    {
+    }
+
+    Yield operator[](boost::system::error_code& ec) const noexcept
+    {
+        Yield tmp = *this;
+        tmp.ec_ = &ec;
+        return tmp;
+    }
+
+    // Give the other fibers and handlers of the service a chance to run.
+    void yield() const;
+
+    const detail::Fiber::executor& get_executor() const noexcept
+    {
+        return fiber_->get_executor();
+    }
+
+    detail::Fiber& fiber() const noexcept
+    {
+        return *fiber_;
+    }
+
+    boost::system::error_code* error_code() const noexcept
+    {
+        return ec_;
+    }
+
+private:
+    detail::Fiber* fiber_;
+    boost::system::error_code* ec_ = nullptr;
+};
+
+// Runs callable(Yield) in a new fiber on the given service.
+template <typename Callable>
+void spawn_fiber(boost::asio::io_context& service,
+                 Callable&& callable,
+                 std::shared_ptr<FiberStackPool> pool = FiberStackPool::default_pool())
+{
+    auto fiber = std::make_shared<detail::Fiber>(service.get_executor());
+    fiber->start(pool,
+                 [f = fiber.get(), fn = std::forward<Callable>(callable)]() mutable
+                 { fn(Yield(*f)); });
+    boost::asio::post(service, [fiber] { fiber->resume(); });
+}
+
+template <typename Callable>
+void spawn_fiber(ThreadPool& pool,
+                 Callable&& callable,
+                 int service_id = ThreadPool::ROUND_ROBIN,
+                 std::shared_ptr<FiberStackPool> stacks = FiberStackPool::default_pool())
+{
+    spawn_fiber(pool.getService(service_id), std::forward<Callable>(callable),
+                std::move(stacks));
+}
+
+namespace detail
+{
+
+template <typename... Args>
+struct FiberResult
+{
+    using type = std::tuple<std::decay_t<Args>...>;
+};
+
+template <typename Arg>
+struct FiberResult<Arg>
+{
+    using type = std::decay_t<Arg>;
+};
+
+template <>
+struct FiberResult<>
+{
+    using type = void;
+};
+
+template <typename... Args>
+class FiberHandler
+{
+public:
+    using executor_type = Fiber::executor;
+    using Storage = std::optional<std::tuple<std::decay_t<Args>...>>;
+
+    FiberHandler(std::shared_ptr<Fiber> fiber,
+                 boost::system::error_code* ec,
+                 Storage* storage)
+    : fiber_(std::move(fiber))
+    , ec_(ec)
+    , storage_(storage)
+    {
+    }
+
+    template <typename... T>
+    void operator()(boost::system::error_code ec, T&&... values)
+    {
+        *ec_ = ec;
+        storage_->emplace(std::forward<T>(values)...);
+        fiber_->resume();
+    }
+
+    template <typename... T>
+    void operator()(T&&... values)
+    {
+        storage_->emplace(std::forward<T>(values)...);
+        fiber_->resume();
+    }
+
+    executor_type get_executor() const noexcept
+    {
+        return fiber_->get_executor();
+    }
+
+private:
+    std::shared_ptr<Fiber> fiber_;
+    boost::system::error_code* ec_;
+    Storage* storage_;
+};
+
+template <bool HasErrorCode, typename... Args>
+struct YieldInitiate
+{
+    using Handler = FiberHandler<Args...>;
+    using return_type = typename FiberResult<Args...>::type;
+
+    template <typename Initiation, typename... InitArgs>
+    static return_type initiate(Initiation&& initiation, Yield yield, InitArgs&&... args)
+    {
+        boost::system::error_code ec;
+        typename Handler::Storage storage;
+
+        // The operation may complete and resume the fiber on another thread
+        // while the initiation still runs: it must not use the fiber stack,
+        // only ec and storage, which are written before the resumption.
+        auto state = std::make_shared<
+            std::tuple<std::decay_t<Initiation>, std::decay_t<InitArgs>...>>(
+            std::forward<Initiation>(initiation), std::forward<InitArgs>(args)...);
+
+        auto& fiber = yield.fiber();
+        fiber.suspend(
+            [state, fiber = fiber.shared_from_this(), ec = &ec, storage = &storage]
+            {
+                std::apply(
+                    [&](auto& init, auto&... init_args)
+                    {
+                        std::move(init)(Handler(fiber, ec, storage),
+                                        std::move(init_args)...);
+                    },
+                    *state);
+            });
+
+        if (HasErrorCode)
+        {
+            if (yield.error_code())
+            {
+                *yield.error_code() = ec;
+            }
+            else if (ec)
+            {
+                throw boost::system::system_error(ec);
+            }
+        }
+
+        if constexpr (sizeof...(Args) == 1)
+        {
+            return std::move(std::get<0>(*storage));
+        }
+        else if constexpr (sizeof...(Args) > 1)
+        {
+            return std::move(*storage);
+        }
+    }
+};
+
+} // namespace detail
+} // namespace thread
+} // namespace commonpp
+
+namespace boost
+{
+namespace asio
+{
+
+template <typename... Args>
+class async_result<commonpp::thread::Yield, void(boost::system::error_code, Args...)>
+    : public commonpp::thread::detail::YieldInitiate<true, Args...>
+{
+};
+
+template <typename... Args>
+class async_result<commonpp::thread::Yield, void(Args...)>
+    : public commonpp::thread::detail::YieldInitiate<false, Args...>
+{
+};
+
+} // namespace asio
+} // namespace boost
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Suspend the current fiber for the given duration without blocking the
+// pool thread, on a timer of the pool (see ThreadPool::schedule()) bound to
+// the service running the fiber.
+template <typename Duration>
+void sleep_for(Yield yield, Duration duration)
+{
+    static_assert(traits::is_duration<Duration>::value,
+                  "A std::chrono::duration is expected here");
+
+    ThreadPool::steady_timer timer(yield.get_executor());
+    timer.expires_after(duration);
+    timer.async_wait(yield);
+}
+
+} // namespace thread
+} // namespace commonpp
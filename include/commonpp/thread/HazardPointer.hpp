@@ -0,0 +1,172 @@
+/*
+ * File: include/commonpp/thread/HazardPointer.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "PerThread.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Hazard pointers (Michael). A thread publishes the pointers it is about to
+// dereference, a retired object is destroyed once no hazard pointer
+// references it. Unlike the EpochDomain, a thread stalled while holding a
+// hazard pointer only keeps that object alive, and nothing has to be
+// reported periodically: this is the scheme for threads outside of a
+// ThreadPool (or blocking for long).
+//
+// The hazard slots are never freed before the domain, they are reused by
+// the next HazardPointer. What a thread retired and could not destroy yet
+// when it exits is handed to a shared orphan list, scanned by the
+// reclamations of the other threads.
+class HazardPointerDomain
+{
+public:
+    using Deleter = void (*)(void*);
+
+    // retired objects waiting before a scan, at least
+    static constexpr size_t SCAN_THRESHOLD = 64;
+
+    HazardPointerDomain() = default;
+    // destroys whatever is still retired, there must be no reader left
+    ~HazardPointerDomain();
+
+    HazardPointerDomain(const HazardPointerDomain&) = delete;
+    HazardPointerDomain& operator=(const HazardPointerDomain&) = delete;
+
+    static HazardPointerDomain& global();
+
+    struct Slot
+    {
+        std::atomic<const void*> pointer{nullptr};
+        std::atomic_bool used{false};
+        Slot* next = nullptr;
+    };
+
+    Slot* acquire_slot();
+    void release_slot(Slot* slot) noexcept;
+
+    template <typename T>
+    void retire(T* ptr)
+    {
+        retire(const_cast<void*>(static_cast<const void*>(ptr)),
+               [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    void retire(void* ptr, Deleter deleter);
+
+    // Destroy what the calling thread retired, and the orphans, that is not
+    // protected anymore; returns how many objects were destroyed.
+    size_t reclaim();
+
+private:
+    struct Retired
+    {
+        void* ptr;
+        Deleter deleter;
+    };
+
+    struct Record
+    {
+        bool exit_hook = false;
+        std::vector<Retired> retired;
+    };
+
+    struct ThreadExit;
+
+    void add_exit_hook(Record& record);
+    void orphan(Record& record) noexcept;
+    std::vector<const void*> hazards() const;
+    static std::vector<Retired> take_unprotected(const std::vector<const void*>& hazards,
+                                                 std::vector<Retired>& retired);
+
+    std::atomic<Slot*> slots_{nullptr};
+    std::atomic<size_t> nb_slots_{0};
+    PerThread<Record> records_;
+
+    std::mutex orphans_lock_;
+    std::vector<Retired> orphans_;
+    std::atomic_bool has_orphans_{false};
+
+    // what the exit hooks of the threads refer to, reset when destroyed
+    std::shared_ptr<HazardPointerDomain*> self_{
+        std::make_shared<HazardPointerDomain*>(this)};
+};
+
+// One hazard pointer, owns a slot of the domain for its lifetime.
+class HazardPointer
+{
+public:
+    explicit HazardPointer(HazardPointerDomain& domain = HazardPointerDomain::global())
+    : domain_(&domain)
+    , slot_(domain.acquire_slot())
+    {
+    }
+
+    ~HazardPointer()
+    {
+        if (slot_)
+        {
+            slot_->pointer.store(nullptr, std::memory_order_release);
+            domain_->release_slot(slot_);
+        }
+    }
+
+    HazardPointer(HazardPointer&& other) noexcept
+    : domain_(other.domain_)
+    , slot_(std::exchange(other.slot_, nullptr))
+    {
+    }
+
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+    HazardPointer& operator=(HazardPointer&&) = delete;
+
+    // Load the source and protect the value loaded, the returned object
+    // cannot be destroyed until reset() or the protection of another one.
+    template <typename T>
+    T* protect(const std::atomic<T*>& source) noexcept
+    {
+        auto ptr = source.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            slot_->pointer.store(ptr, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            auto current = source.load(std::memory_order_acquire);
+            if (current == ptr)
+            {
+                return ptr;
+            }
+            ptr = current;
+        }
+    }
+
+    void reset() noexcept
+    {
+        slot_->pointer.store(nullptr, std::memory_order_release);
+    }
+
+private:
+    HazardPointerDomain* domain_;
+    HazardPointerDomain::Slot* slot_;
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,167 @@
+/*
+ * File: include/commonpp/thread/MCSLock.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+#include "Spinlock.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Mellor-Crummey and Scott queue lock: every waiter spins on its own node,
+// the lock word is only touched once per acquisition, whatever the
+// contention is.
+//
+// lock()/unlock() take the queue node from a small per thread pool, a
+// thread can hold up to MAX_HELD_LOCKS MCSLock at the same time. The
+// lock(Node&)/unlock(Node&) overloads let the caller provide the node.
+class MCSLock
+{
+public:
+    static constexpr unsigned MAX_HELD_LOCKS = 32;
+
+    struct alignas(64) Node
+    {
+        std::atomic<Node*> next{nullptr};
+        std::atomic_bool locked{false};
+    };
+
+    MCSLock() = default;
+    MCSLock(const MCSLock&) = delete;
+    MCSLock& operator=(const MCSLock&) = delete;
+
+    void lock() noexcept
+    {
+        auto node = acquire_node();
+        lock(*node);
+        owner_ = node;
+    }
+
+    bool try_lock() noexcept
+    {
+        auto node = acquire_node();
+        if (try_lock(*node))
+        {
+            owner_ = node;
+            return true;
+        }
+
+        release_node(node);
+        return false;
+    }
+
+    void unlock() noexcept
+    {
+        auto node = owner_;
+        unlock(*node);
+        release_node(node);
+    }
+
+    void lock(Node& node) noexcept
+    {
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.locked.store(true, std::memory_order_relaxed);
+
+        auto previous = tail_.exchange(&node, std::memory_order_acq_rel);
+        if (previous)
+        {
+            previous->next.store(&node, std::memory_order_release);
+            Backoff backoff;
+            while (node.locked.load(std::memory_order_acquire))
+            {
+                backoff.pause();
+            }
+        }
+    }
+
+    bool try_lock(Node& node) noexcept
+    {
+        node.next.store(nullptr, std::memory_order_relaxed);
+        Node* expected = nullptr;
+        return tail_.compare_exchange_strong(expected, &node,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_relaxed);
+    }
+
+    void unlock(Node& node) noexcept
+    {
+        auto next = node.next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            auto expected = &node;
+            if (tail_.compare_exchange_strong(expected, nullptr,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            // a thread is enqueuing itself behind us
+            Backoff backoff;
+            while (!(next = node.next.load(std::memory_order_acquire)))
+            {
+                backoff.pause();
+            }
+        }
+
+        next->locked.store(false, std::memory_order_release);
+    }
+
+private:
+    struct NodePool
+    {
+        Node nodes[MAX_HELD_LOCKS];
+        uint32_t used = 0;
+    };
+
+    static NodePool& pool() noexcept
+    {
+        static thread_local NodePool pool;
+        return pool;
+    }
+
+    static Node* acquire_node() noexcept
+    {
+        auto& p = pool();
+        if (p.used == UINT32_MAX)
+        {
+            std::abort(); // more than MAX_HELD_LOCKS held by this thread
+        }
+
+        unsigned idx = 0;
+        while (p.used & (1u << idx))
+        {
+            ++idx;
+        }
+
+        p.used |= (1u << idx);
+        return &p.nodes[idx];
+    }
+
+    static void release_node(Node* node) noexcept
+    {
+        auto& p = pool();
+        p.used &= ~(1u << (node - p.nodes));
+    }
+
+private:
+    std::atomic<Node*> tail_{nullptr};
+    // only accessed by the holder of the lock
+    Node* owner_ = nullptr;
+};
+
+} // namespace thread
+} // namespace commonpp
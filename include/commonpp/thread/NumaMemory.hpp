@@ -0,0 +1,120 @@
+/*
+ * File: include/commonpp/thread/NumaMemory.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Page granular allocations placed on NUMA nodes, the node is the index in
+// Topology::numa_nodes(). Every call maps new pages: these are meant for
+// large and long lived buffers, or as the upstream of a pool such as
+// std::pmr::unsynchronized_pool_resource. They throw std::bad_alloc on
+// failure. Without hwloc the memory comes from the regular heap.
+void* allocate_on_node(std::size_t size, unsigned node);
+// pages are spread round robin over all the NUMA nodes
+void* allocate_interleaved(std::size_t size);
+// pages are touched by the calling thread so they end up on its node
+void* allocate_local(std::size_t size);
+void deallocate_numa(void* ptr, std::size_t size) noexcept;
+
+enum class NumaPolicy
+{
+    OnNode,
+    Interleaved,
+    Local,
+};
+
+void* allocate_numa(std::size_t size, NumaPolicy policy, unsigned node = 0);
+
+template <typename T>
+class NumaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit NumaAllocator(NumaPolicy policy = NumaPolicy::Local, unsigned node = 0) noexcept
+    : policy_(policy)
+    , node_(node)
+    {
+    }
+
+    template <typename U>
+    NumaAllocator(const NumaAllocator<U>& other) noexcept
+    : policy_(other.policy())
+    , node_(other.node())
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(allocate_numa(n * sizeof(T), policy_, node_));
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept
+    {
+        deallocate_numa(ptr, n * sizeof(T));
+    }
+
+    NumaPolicy policy() const noexcept
+    {
+        return policy_;
+    }
+
+    unsigned node() const noexcept
+    {
+        return node_;
+    }
+
+    template <typename U>
+    bool operator==(const NumaAllocator<U>& other) const noexcept
+    {
+        return policy_ == other.policy() && node_ == other.node();
+    }
+
+    template <typename U>
+    bool operator!=(const NumaAllocator<U>& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    NumaPolicy policy_;
+    unsigned node_;
+};
+
+class NumaMemoryResource : public std::pmr::memory_resource
+{
+public:
+    explicit NumaMemoryResource(NumaPolicy policy = NumaPolicy::Local,
+                                unsigned node = 0) noexcept
+    : policy_(policy)
+    , node_(node)
+    {
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    NumaPolicy policy_;
+    unsigned node_;
+};
+
+} // namespace thread
+} // namespace commonpp
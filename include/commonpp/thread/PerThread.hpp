@@ -0,0 +1,142 @@
+/*
+ * File: include/commonpp/thread/PerThread.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+#include "Thread.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
+// One value initialized T per thread, indexed by current_thread_index(). Each T lives on its
+// own cache line(s) so that threads updating their own value never share a
+// line. The slots are allocated by chunks the first time a thread with an
+// index in the chunk accesses it.
+//
+// A slot is not reset when its thread exits, the next thread getting the
+// same index inherits it (which is what a counter wants).
+template <typename T>
+class PerThread
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 64;
+    static constexpr size_t MAX_CHUNKS = 64;
+    static constexpr size_t MAX_THREADS = CHUNK_SIZE * MAX_CHUNKS;
+
+    PerThread() = default;
+
+    ~PerThread()
+    {
+        for (auto& chunk : chunks_)
+        {
+            delete chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    PerThread(const PerThread&) = delete;
+    PerThread& operator=(const PerThread&) = delete;
+
+    // the value of the calling thread
+    T& local()
+    {
+        const auto index = current_thread_index();
+        return get_chunk(index / CHUNK_SIZE).slots[index % CHUNK_SIZE].value;
+    }
+
+    // nullptr instead of throwing when the thread index is beyond
+    // MAX_THREADS or the slots cannot be allocated
+    T* try_local() noexcept
+    {
+        try
+        {
+            return &local();
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+    // Visit the value of every thread index used so far. The values can
+    // be concurrently modified by their owner, T has to cope with it.
+    template <typename Callable>
+    void for_each(Callable&& callable) const
+    {
+        for (const auto& chunk_ptr : chunks_)
+        {
+            auto chunk = chunk_ptr.load(std::memory_order_acquire);
+            if (chunk)
+            {
+                for (const auto& slot : chunk->slots)
+                {
+                    callable(slot.value);
+                }
+            }
+        }
+    }
+
+    template <typename Result, typename Reducer>
+    Result combine(Result init, Reducer&& reducer) const
+    {
+        for_each([&init, &reducer](const T& value) { init = reducer(init, value); });
+        return init;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        T value{};
+    };
+
+    struct Chunk
+    {
+        std::array<Slot, CHUNK_SIZE> slots;
+    };
+
+    Chunk& get_chunk(size_t idx)
+    {
+        if (idx >= MAX_CHUNKS)
+        {
+            throw std::out_of_range("Too many threads for PerThread");
+        }
+
+        auto chunk = chunks_[idx].load(std::memory_order_acquire);
+        if (BOOST_LIKELY(chunk != nullptr))
+        {
+            return *chunk;
+        }
+
+        auto fresh = std::make_unique<Chunk>();
+        if (chunks_[idx].compare_exchange_strong(chunk, fresh.get(),
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire))
+        {
+            return *fresh.release();
+        }
+
+        return *chunk;
+    }
+
+private:
+    std::array<std::atomic<Chunk*>, MAX_CHUNKS> chunks_{};
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,97 @@
+/*
+ * File: include/commonpp/thread/Qsbr.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+#include "PerThread.hpp"
+#include "QuiescentState.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Quiescent state based reclamation.
+//
+// A registered thread may hold references to shared objects between two
+// calls to quiescent(), readers pay nothing more than that. Retired objects
+// are destroyed once every registered thread reported a quiescent state
+// since their retirement, threads not registered are assumed to hold no
+// reference at all. A thread blocking for a long time should unregister
+// itself (or keep reporting) or it will delay the reclamation.
+//
+// ThreadPool::enable_quiescent_states() makes the pool threads report a
+// quiescent state between two handlers.
+class Qsbr final : public QuiescentStateDomain
+{
+public:
+    Qsbr() = default;
+    // destroys whatever is still retired, there must be no reader left
+    ~Qsbr();
+
+    Qsbr(const Qsbr&) = delete;
+    Qsbr& operator=(const Qsbr&) = delete;
+
+    static Qsbr& global();
+
+    void register_thread() noexcept override;
+    void unregister_thread() noexcept override;
+    bool is_registered() noexcept;
+
+    void quiescent() noexcept override
+    {
+        auto& seen = slots_.local();
+        if (seen.load(std::memory_order_relaxed) != OFFLINE)
+        {
+            seen.store(epoch_.load(std::memory_order_acquire),
+                       std::memory_order_release);
+        }
+    }
+
+    void retire(std::function<void()> deleter);
+
+    template <typename T>
+    void retire(T* ptr)
+    {
+        retire([ptr] { delete ptr; });
+    }
+
+    // Run the deleters whose grace period elapsed, returns how many ran.
+    size_t reclaim();
+
+    // Wait for a grace period and reclaim. When called from a registered
+    // thread, the caller must hold no reference (it reports a quiescent
+    // state).
+    void synchronize();
+
+    size_t pending() const;
+
+private:
+    static constexpr uint64_t OFFLINE = 0;
+
+    uint64_t oldest_seen() const noexcept;
+
+private:
+    std::atomic<uint64_t> epoch_{1};
+    PerThread<std::atomic<uint64_t>> slots_;
+
+    mutable std::mutex lock_;
+    std::deque<std::pair<uint64_t, std::function<void()>>> retired_;
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,33 @@
+/*
+ * File: include/commonpp/thread/QuiescentState.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+namespace commonpp
+{
+namespace thread
+{
+
+// A memory reclamation scheme the threads of a ThreadPool report to, see
+// ThreadPool::enable_quiescent_states(). A registered thread may hold
+// references to shared objects until it reports a quiescent state.
+class QuiescentStateDomain
+{
+public:
+    virtual ~QuiescentStateDomain() = default;
+
+    virtual void register_thread() noexcept = 0;
+    virtual void unregister_thread() noexcept = 0;
+    // The calling thread holds no reference on any shared object.
+    virtual void quiescent() noexcept = 0;
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,112 @@
+/*
+ * File: include/commonpp/thread/ReadMostly.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "Qsbr.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// RCU like holder for large objects read everywhere and updated rarely
+// (configuration, routing tables, ...). A reader gets a plain pointer with
+// a single load, without any atomic read-modify-write or shared counter.
+// A writer publishes a new version and the previous one is destroyed by the
+// Qsbr domain once every registered thread went through a quiescent state.
+//
+// The pointer returned by get() stays valid until the reading thread
+// reports its next quiescent state: for the threads of a ThreadPool with
+// enable_quiescent_states(), that is until the end of the current handler.
+// Other threads have to register to the domain and report their quiescent
+// states themselves.
+template <typename T>
+class ReadMostly
+{
+public:
+    explicit ReadMostly(std::unique_ptr<T> initial, Qsbr& domain = Qsbr::global())
+    : current_(initial.release())
+    , domain_(domain)
+    {
+    }
+
+    template <typename... Args>
+    explicit ReadMostly(std::in_place_t, Args&&... args)
+    : ReadMostly(std::make_unique<T>(std::forward<Args>(args)...))
+    {
+    }
+
+    // there must be no reader left
+    ~ReadMostly()
+    {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    ReadMostly(const ReadMostly&) = delete;
+    ReadMostly& operator=(const ReadMostly&) = delete;
+
+    const T* get() const noexcept
+    {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    const T* operator->() const noexcept
+    {
+        return get();
+    }
+
+    const T& operator*() const noexcept
+    {
+        return *get();
+    }
+
+    void update(std::unique_ptr<T> value)
+    {
+        std::lock_guard<std::mutex> lock(writer_);
+        publish(std::move(value));
+    }
+
+    // Copy the current version, modify the copy and publish it. Concurrent
+    // modifications are serialized.
+    template <typename Callable>
+    void modify(Callable&& callable)
+    {
+        std::lock_guard<std::mutex> lock(writer_);
+        auto value = std::make_unique<T>(*current_.load(std::memory_order_relaxed));
+        callable(*value);
+        publish(std::move(value));
+    }
+
+    Qsbr& domain() const noexcept
+    {
+        return domain_;
+    }
+
+private:
+    void publish(std::unique_ptr<T> value)
+    {
+        auto previous = current_.exchange(value.release(), std::memory_order_acq_rel);
+        domain_.retire(previous);
+    }
+
+private:
+    std::atomic<T*> current_;
+    Qsbr& domain_;
+    std::mutex writer_;
+};
+
+} // namespace thread
+} // namespace commonpp
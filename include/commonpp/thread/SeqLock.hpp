@@ -0,0 +1,129 @@
+/*
+ * File: include/commonpp/thread/SeqLock.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+#include "Spinlock.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Sequence lock for small trivially copyable values. Readers never write
+// the shared memory: they copy the value and retry if a writer was active
+// meanwhile, so they do not bounce any cache line between themselves.
+// Writers are serialized by a spinlock. Best for values read very often and
+// written rarely, a reader may starve under a continuous stream of writes.
+//
+// The value is stored as relaxed atomic words so that the racy copy of a
+// reader is well defined.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock requires a trivially copyable type");
+
+public:
+    SeqLock()
+    : SeqLock(T{})
+    {
+    }
+
+    explicit SeqLock(const T& value) noexcept
+    {
+        store_words(value);
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    T load() const noexcept
+    {
+        std::array<uint64_t, NB_WORDS> copy;
+        for (;;)
+        {
+            auto before = seq_.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                cpu_relax();
+                continue;
+            }
+
+            for (size_t i = 0; i < NB_WORDS; ++i)
+            {
+                copy[i] = words_[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == before)
+            {
+                break;
+            }
+        }
+
+        T value;
+        std::memcpy(&value, copy.data(), sizeof(T));
+        return value;
+    }
+
+    void store(const T& value) noexcept
+    {
+        std::lock_guard<Spinlock> lock(writer_);
+        auto seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store_words(value);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    // Read-modify-write under the writer lock
+    template <typename Callable>
+    void update(Callable&& callable)
+    {
+        std::lock_guard<Spinlock> lock(writer_);
+        T value = load();
+        callable(value);
+
+        auto seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store_words(value);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t NB_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void store_words(const T& value) noexcept
+    {
+        std::array<uint64_t, NB_WORDS> copy{};
+        std::memcpy(copy.data(), &value, sizeof(T));
+        for (size_t i = 0; i < NB_WORDS; ++i)
+        {
+            words_[i].store(copy[i], std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::atomic<uint64_t> seq_{0};
+    std::array<std::atomic<uint64_t>, NB_WORDS> words_;
+    Spinlock writer_;
+};
+
+} // namespace thread
+} // namespace commonpp
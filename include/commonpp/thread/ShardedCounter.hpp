@@ -0,0 +1,91 @@
+/*
+ * File: include/commonpp/thread/ShardedCounter.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+
+#include "PerThread.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Counter updated by many threads and rarely read: every thread adds to its
+// own cache line without any atomic read-modify-write, reading sums all the
+// threads' values. The threads without a slot (beyond
+// PerThread::MAX_THREADS) share an atomic overflow shard.
+template <typename T>
+class ShardedCounter
+{
+    static_assert(std::is_arithmetic<T>::value, "An arithmetic type is expected");
+
+public:
+    void add(T value = 1) noexcept
+    {
+        // only the owning thread writes its slot, a load and a store are
+        // enough and avoid the lock prefix
+        auto* slot = shards_.try_local();
+        if (BOOST_UNLIKELY(!slot))
+        {
+            overflow_.fetch_add(value, std::memory_order_relaxed);
+            return;
+        }
+        slot->store(slot->load(std::memory_order_relaxed) + value,
+                    std::memory_order_relaxed);
+    }
+
+    void sub(T value = 1) noexcept
+    {
+        add(-value);
+    }
+
+    ShardedCounter& operator+=(T value) noexcept
+    {
+        add(value);
+        return *this;
+    }
+
+    ShardedCounter& operator-=(T value) noexcept
+    {
+        sub(value);
+        return *this;
+    }
+
+    ShardedCounter& operator++() noexcept
+    {
+        add(1);
+        return *this;
+    }
+
+    T get() const noexcept
+    {
+        return combine(T(0), [](T lhs, T rhs) { return lhs + rhs; });
+    }
+
+    template <typename Result, typename Reducer>
+    Result combine(Result init, Reducer&& reducer) const
+    {
+        auto acc = shards_.combine(
+            init, [&reducer](Result acc, const std::atomic<T>& value) {
+                return reducer(acc, value.load(std::memory_order_relaxed));
+            });
+        return reducer(acc, overflow_.load(std::memory_order_relaxed));
+    }
+
+private:
+    PerThread<std::atomic<T>> shards_;
+    std::atomic<T> overflow_{0};
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,160 @@
+/*
+ * File: include/commonpp/thread/Spinlock.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// clang-format off
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+# include <immintrin.h>
+# define COMMONPP_CPU_RELAX() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+# define COMMONPP_CPU_RELAX() asm volatile("yield" ::: "memory")
+#else
+# define COMMONPP_CPU_RELAX() do {} while (0)
+#endif
+// clang-format on
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Tell the CPU we are in a spin loop: it saves power and avoids the memory
+// order violation pipeline flush when the awaited value changes.
+inline void cpu_relax() noexcept
+{
+    COMMONPP_CPU_RELAX();
+}
+
+// Exponential backoff, the number of pause doubles up to a limit. Past
+// the limit the thread yields: the thread we are waiting for may have been
+// preempted, spinning until the end of our time slice would only delay it.
+class Backoff
+{
+public:
+    static constexpr uint32_t MAX_SPINS = 256;
+
+    void pause() noexcept
+    {
+        if (spins_ >= MAX_SPINS)
+        {
+            std::this_thread::yield();
+            return;
+        }
+
+        for (uint32_t i = 0; i < spins_; ++i)
+        {
+            cpu_relax();
+        }
+
+        spins_ <<= 1;
+    }
+
+private:
+    uint32_t spins_ = 1;
+};
+
+// Test and test-and-set lock: waiters only read the lock word (which stays
+// in their cache) until it is released, then race for it.
+class Spinlock
+{
+public:
+    Spinlock() = default;
+    Spinlock(const Spinlock&) = delete;
+    Spinlock& operator=(const Spinlock&) = delete;
+
+    void lock() noexcept
+    {
+        Backoff backoff;
+        while (locked_.exchange(true, std::memory_order_acquire))
+        {
+            while (locked_.load(std::memory_order_relaxed))
+            {
+                backoff.pause();
+            }
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        return !locked_.load(std::memory_order_relaxed) &&
+               !locked_.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() noexcept
+    {
+        locked_.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic_bool locked_{false};
+};
+
+// FIFO spinlock, every thread takes a ticket and waits for its turn.
+class TicketLock
+{
+public:
+    TicketLock() = default;
+    TicketLock(const TicketLock&) = delete;
+    TicketLock& operator=(const TicketLock&) = delete;
+
+    static constexpr uint32_t YIELD_AFTER = 64;
+
+    void lock() noexcept
+    {
+        const auto ticket = next_.fetch_add(1, std::memory_order_relaxed);
+        for (uint32_t rounds = 0;; ++rounds)
+        {
+            const auto serving = serving_.load(std::memory_order_acquire);
+            if (serving == ticket)
+            {
+                return;
+            }
+
+            // the holder or a thread before us is probably preempted
+            if (rounds >= YIELD_AFTER)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // the further we are in the queue, the longer we wait
+            for (uint32_t i = ticket - serving; i > 0; --i)
+            {
+                cpu_relax();
+            }
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        auto serving = serving_.load(std::memory_order_acquire);
+        return next_.compare_exchange_strong(serving, serving + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed);
+    }
+
+    void unlock() noexcept
+    {
+        serving_.store(serving_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_release);
+    }
+
+private:
+    std::atomic<uint32_t> next_{0};
+    std::atomic<uint32_t> serving_{0};
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -10,9 +10,13 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <thread>
 
+#include <commonpp/core/config.hpp>
+
 namespace commonpp
 {
 namespace thread
@@ -20,6 +24,38 @@ namespace thread
 void set_current_thread_name(const std::string& name);
 const std::string& get_current_thread_name();
 
+// The thread names are interned: a name is given a small id once, the id
+// of the calling thread follows set_current_thread_name() and the name of
+// an id is looked up without lock. The names are never released, so the
+// names of the threads never named are not interned: they are named after
+// their system thread id (as shown by top or gdb), carried by their id.
+// get_thread_name() formats these in a thread local buffer, valid until
+// its next call by the same thread.
+using ThreadNameId = uint32_t;
+ThreadNameId get_current_thread_name_id();
+const std::string& get_thread_name(ThreadNameId id) noexcept;
+
+namespace detail
+{
+static constexpr size_t NO_THREAD_INDEX = static_cast<size_t>(-1);
+extern thread_local size_t current_thread_index;
+size_t register_current_thread_index();
+} // namespace detail
+
+// Small dense index of the calling thread, unique among the running threads
+// and reused once a thread exits. The ThreadPool threads get theirs when
+// they start, other threads on the first call.
+inline size_t current_thread_index()
+{
+    auto index = detail::current_thread_index;
+    if (BOOST_LIKELY(index != detail::NO_THREAD_INDEX))
+    {
+        return index;
+    }
+
+    return detail::register_current_thread_index();
+}
+
 // The following depends on the hwloc lib being present
 // returns -1 if we can't calculate it.
 int get_nb_physical_core();
@@ -31,5 +67,39 @@ bool set_affinity_to_logical_core(int core);
 bool set_affinity_to_physical_core(int core, std::thread&);
 bool set_affinity_to_logical_core(int core, std::thread&);
 
+struct SchedulingPolicy
+{
+    enum Class
+    {
+        Inherit, // leave the scheduling class untouched
+        Other,   // SCHED_OTHER
+        Batch,   // SCHED_BATCH, CPU bound background work
+        Idle,    // SCHED_IDLE, only runs when nothing else wants the CPU
+        Fifo,    // SCHED_FIFO, real time
+        RoundRobin, // SCHED_RR, real time
+    };
+
+    enum IOClass
+    {
+        IOInherit,
+        IORealtime,
+        IOBestEffort,
+        IOIdle,
+    };
+
+    Class policy = Inherit;
+    int priority = 0; // 1..99 for Fifo and RoundRobin
+    bool set_nice = false;
+    int nice = 0;
+    IOClass io_class = IOInherit;
+    int io_priority = 4; // 0 (highest)..7 for IORealtime and IOBestEffort
+};
+
+// Apply the policy to the calling thread. Real time classes, lowering the
+// nice value and the real time IO class usually need CAP_SYS_NICE (or
+// CAP_SYS_ADMIN); failures are logged and false is returned, whatever
+// could be applied stays applied.
+bool set_current_thread_scheduling(const SchedulingPolicy& policy);
+
 } // namespace thread
 } // namespace commonpp
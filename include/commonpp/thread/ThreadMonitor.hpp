@@ -0,0 +1,106 @@
+/*
+ * File: include/commonpp/thread/ThreadMonitor.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+struct ThreadStats
+{
+    std::string name;
+    long tid = 0;
+
+    // cumulative values since the thread started
+    std::chrono::nanoseconds cpu_time{0};
+    std::chrono::nanoseconds run_queue_wait{0};
+    uint64_t voluntary_switches = 0;
+    uint64_t involuntary_switches = 0;
+    uint64_t migrations = 0;
+
+    // ratio of the wall time elapsed since the previous sample spent running
+    // (resp. waiting in the run queue), 0 for the first sample
+    double load = 0;
+    double wait_ratio = 0;
+};
+
+std::ostream& operator<<(std::ostream& os, const ThreadStats& stats);
+
+// Samples the CPU usage and scheduler statistics of the registered threads
+// from a single place. The threads of every ThreadPool register themselves.
+//
+// The CPU time needs a POSIX per thread CPU clock, the scheduler statistics
+// come from /proc/self/task/<tid>/{status,schedstat,sched} and are only
+// available on Linux (migrations need a kernel with CONFIG_SCHED_DEBUG).
+// Anything unavailable stays at 0.
+class ThreadMonitor
+{
+public:
+    using Callback = std::function<void(const std::vector<ThreadStats>&)>;
+
+    static ThreadMonitor& instance();
+
+    void register_current_thread();
+    void unregister_current_thread();
+
+    std::vector<ThreadStats> sample();
+
+    // Samples the threads periodically on the given pool, by default the
+    // result is logged.
+    template <typename Duration>
+    ThreadPool::TimerPtr start(ThreadPool& pool,
+                               Duration period,
+                               Callback callback = &ThreadMonitor::log_stats);
+
+    static void log_stats(const std::vector<ThreadStats>& stats);
+
+private:
+    ThreadMonitor() = default;
+
+    struct Entry
+    {
+        ThreadStats stats;
+        long clock_id = 0;
+        bool has_clock = false;
+        std::chrono::steady_clock::time_point last_sample;
+    };
+
+    std::mutex lock_;
+    std::map<long, Entry> threads_;
+};
+
+template <typename Duration>
+ThreadPool::TimerPtr ThreadMonitor::start(ThreadPool& pool,
+                                          Duration period,
+                                          Callback callback)
+{
+    return pool.schedule(period,
+                         [this, callback]
+                         {
+                             callback(sample());
+                             return true;
+                         });
+}
+
+} // namespace thread
+} // namespace commonpp
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <functional>
 #include <memory>
@@ -28,7 +29,9 @@
 #include <commonpp/core/traits/function_wrapper.hpp>
 #include <commonpp/core/traits/is_duration.hpp>
 
+#include "QuiescentState.hpp"
 #include "Thread.hpp"
+#include "Topology.hpp"
 
 namespace commonpp
 {
@@ -69,6 +72,11 @@ public:
         Random,
         DispatchToPCore,
         DispatchToAllCore,
+        // the threads of a service share a L3 (resp. L2) cache domain
+        DispatchToL3Domain,
+        DispatchToL2Domain,
+        // the threads of a service run on the hyperthreads of one core
+        DispatchToSMTSiblings,
     };
 
     template <typename Callable>
@@ -110,6 +118,20 @@ public:
     // called by each thread before exiting
     void set_cleanup_fn(std::function<void()> cleanup_fn);
 
+    // The threads of the pool will never run on those cpus, whatever the
+    // dispatch policy is. Must be called before start().
+    void set_housekeeping_cpus(const CpuSet& cpus);
+
+    // Applied by every thread of the pool right after being named, before
+    // the ThreadInit function. Must be called before start().
+    void set_scheduling_policy(const SchedulingPolicy& policy);
+
+    // Every thread of the pool registers to the domain and reports a
+    // quiescent state after each handler, and at least every max_period
+    // when idle. Must be called before start().
+    void enable_quiescent_states(
+        QuiescentStateDomain& domain, std::chrono::milliseconds max_period = std::chrono::milliseconds(10));
+
 private:
     template <typename Duration, typename Callable>
     void schedule_timer(TimerPtr& timer, Duration, Callable&& callable);
@@ -129,6 +151,10 @@ private:
     std::vector<std::shared_ptr<io_context>> services_;
     std::vector<boost::asio::executor_work_guard<executor>> works_;
     std::function<void()> on_exit_thread_fn;
+    CpuSet housekeeping_cpus_;
+    SchedulingPolicy scheduling_policy_;
+    std::vector<QuiescentStateDomain*> quiescent_domains_;
+    std::chrono::milliseconds quiescent_period_{10};
 };
 
 template <typename Duration, typename Callable>
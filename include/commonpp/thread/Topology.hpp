@@ -0,0 +1,125 @@
+/*
+ * File: include/commonpp/thread/Topology.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Processing units are identified by their OS index, the same number the
+// kernel uses in /proc/cpuinfo or sched_setaffinity.
+static constexpr std::size_t MAX_CPUS = 1024;
+using CpuSet = std::bitset<MAX_CPUS>;
+
+// Process wide view of the machine, loaded once on first use. Without hwloc
+// every PU is seen as a core of its own, in a single package and NUMA node,
+// and binding always fails.
+class Topology
+{
+public:
+    enum Level
+    {
+        NUMA_NODE,
+        PACKAGE,
+        L3_CACHE,
+        L2_CACHE,
+        CORE,
+        PU,
+        NB_LEVELS,
+    };
+
+    struct Object
+    {
+        Level level;
+        unsigned logical_index;
+        unsigned os_index;
+        CpuSet cpuset;
+    };
+
+    static const Topology& instance();
+
+    Topology(const Topology&) = delete;
+    Topology& operator=(const Topology&) = delete;
+    ~Topology();
+
+    const std::vector<Object>& objects(Level level) const noexcept;
+
+    const std::vector<Object>& numa_nodes() const noexcept
+    {
+        return objects(NUMA_NODE);
+    }
+
+    const std::vector<Object>& packages() const noexcept
+    {
+        return objects(PACKAGE);
+    }
+
+    const std::vector<Object>& l3_domains() const noexcept
+    {
+        return objects(L3_CACHE);
+    }
+
+    const std::vector<Object>& l2_domains() const noexcept
+    {
+        return objects(L2_CACHE);
+    }
+
+    // the PUs when the cores are unknown
+    const std::vector<Object>& cores() const noexcept
+    {
+        return objects(CORE);
+    }
+
+    const std::vector<Object>& pus() const noexcept
+    {
+        return objects(PU);
+    }
+
+    // The object of the given level containing the PU, nullptr if the PU is
+    // unknown or the level is not present on this machine.
+    const Object* object_of(Level level, unsigned pu_os_index) const noexcept;
+
+    // The PUs sharing the core of the given PU (including itself).
+    CpuSet smt_siblings(unsigned pu_os_index) const noexcept;
+
+    const CpuSet& online_cpus() const noexcept;
+
+    // Binding helpers, the current thread or the given one is restricted to
+    // the cpuset. Cores and PUs are looked up by logical index and bound to
+    // a single PU without any allocation.
+    bool bind(const CpuSet& cpuset) const;
+    bool bind(const CpuSet& cpuset, std::thread& thread) const;
+    bool bind_to_core(int core) const;
+    bool bind_to_core(int core, std::thread& thread) const;
+    bool bind_to_pu(int pu) const;
+    bool bind_to_pu(int pu, std::thread& thread) const;
+
+    // Opaque handle on the hwloc topology, nullptr without hwloc.
+    void* native_handle() const noexcept;
+
+private:
+    Topology();
+
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::vector<Object> objects_[NB_LEVELS];
+    CpuSet online_;
+};
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,411 @@
+/*
+ * File: src/commonpp/core/AsyncLogging.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/LoggingInterface.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/log/core.hpp>
+#include <boost/log/core/record_view.hpp>
+#include <boost/log/sinks/sink.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+
+#include "commonpp/thread/BoundedQueue.hpp"
+#include "commonpp/thread/Spinlock.hpp"
+#include "commonpp/thread/Thread.hpp"
+#include "detail/sinks.hpp"
+
+namespace logging = boost::log;
+namespace sinks = logging::sinks;
+
+namespace commonpp
+{
+namespace core
+{
+
+namespace
+{
+
+// The single frontend registered to the logging core in asynchronous mode,
+// it only accepts the commonpp records and feeds the real sinks from its
+// background thread.
+class AsyncDispatcher : public sinks::sink
+{
+public:
+    explicit AsyncDispatcher(const AsyncLoggingOptions& options)
+    : sinks::sink(true)
+    , options_(options)
+    , queue_(options.queue_size)
+    , high_watermark_(queue_.capacity() / 4 * 3)
+    , thread_(&AsyncDispatcher::run, this)
+    {
+    }
+
+    ~AsyncDispatcher() override
+    {
+        stop();
+    }
+
+    void add(boost::shared_ptr<sinks::sink> sink)
+    {
+        std::lock_guard<std::mutex> lock(sinks_lock_);
+        sinks_.push_back(std::move(sink));
+    }
+
+    void remove(const boost::shared_ptr<sinks::sink>& sink)
+    {
+        std::lock_guard<std::mutex> lock(sinks_lock_);
+        sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sink), sinks_.end());
+    }
+
+    void remove_all()
+    {
+        std::lock_guard<std::mutex> lock(sinks_lock_);
+        sinks_.clear();
+    }
+
+    bool will_consume(const logging::attribute_value_set& values) override
+    {
+        auto commonpp_record = values[CommonppRecord];
+        return commonpp_record && *commonpp_record;
+    }
+
+    void consume(const logging::record_view& rec) override
+    {
+        if (options_.overflow == OverflowPolicy::DropBySeverity &&
+            queue_.size() >= high_watermark_ && severity(rec) < options_.keep_level)
+        {
+            drop(rec);
+            return;
+        }
+
+        if (BOOST_LIKELY(queue_.try_push(rec)))
+        {
+            wake_up();
+            return;
+        }
+
+        if (options_.overflow == OverflowPolicy::DropNewest ||
+            (options_.overflow == OverflowPolicy::DropBySeverity &&
+             severity(rec) < options_.keep_level))
+        {
+            drop(rec);
+            return;
+        }
+
+        blocked_.fetch_add(1, std::memory_order_relaxed);
+        thread::Backoff backoff;
+        while (!queue_.try_push(rec))
+        {
+            wake_up();
+            backoff.pause();
+        }
+        wake_up();
+    }
+
+    void flush() override
+    {
+        while (!queue_.empty() || busy_.load())
+        {
+            notify();
+            std::this_thread::yield();
+        }
+
+        std::lock_guard<std::mutex> lock(sinks_lock_);
+        for (auto& sink : sinks_)
+        {
+            sink->flush();
+        }
+    }
+
+    void stop()
+    {
+        if (thread_.joinable())
+        {
+            stopped_.store(true);
+            notify();
+            thread_.join();
+        }
+    }
+
+    AsyncLoggingStats stats() const
+    {
+        AsyncLoggingStats stats;
+        for (size_t i = 0; i < std::size(dropped_); ++i)
+        {
+            stats.dropped_by_level[i] = dropped_[i].load(std::memory_order_relaxed);
+            stats.dropped += stats.dropped_by_level[i];
+        }
+        stats.blocked = blocked_.load(std::memory_order_relaxed);
+        stats.queued = queue_.size();
+        stats.capacity = queue_.capacity();
+        return stats;
+    }
+
+private:
+    static LoggingLevel severity(const logging::record_view& rec)
+    {
+        auto severity = rec[Severity];
+        return severity ? *severity : info;
+    }
+
+    void drop(const logging::record_view& rec)
+    {
+        auto level = static_cast<size_t>(severity(rec));
+        dropped_[std::min(level, std::size(dropped_) - 1)].fetch_add(
+            1, std::memory_order_relaxed);
+    }
+
+    // A logging thread only pays for the wake up when the consumer sleeps.
+    // Without a fence it can miss the consumer going to sleep: the consumer
+    // then finds the record when its wait times out, after IDLE_TIMEOUT at
+    // most.
+    void wake_up()
+    {
+        if (sleeping_.load(std::memory_order_relaxed))
+        {
+            notify();
+        }
+    }
+
+    void notify()
+    {
+        std::lock_guard<std::mutex> lock(sleep_lock_);
+        sleeping_.store(false, std::memory_order_relaxed);
+        sleep_.notify_one();
+    }
+
+    void run()
+    {
+        thread::set_current_thread_name("commonpp-log");
+
+        logging::record_view rec;
+        for (;;)
+        {
+            busy_.store(true);
+            {
+                std::lock_guard<std::mutex> lock(sinks_lock_);
+                while (queue_.try_pop(rec))
+                {
+                    dispatch(rec);
+                }
+            }
+            rec = logging::record_view();
+            busy_.store(false);
+
+            if (stopped_.load())
+            {
+                if (queue_.empty())
+                {
+                    return;
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_lock_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (queue_.empty() && !stopped_.load())
+            {
+                sleep_.wait_for(lock, IDLE_TIMEOUT, [this] {
+                    return !sleeping_.load(std::memory_order_relaxed);
+                });
+            }
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void dispatch(const logging::record_view& rec)
+    {
+        for (auto& sink : sinks_)
+        {
+            try
+            {
+                if (sink->will_consume(rec.attribute_values()))
+                {
+                    sink->consume(rec);
+                }
+            }
+            catch (...)
+            {
+                // a failing sink must not take the others down
+            }
+        }
+    }
+
+private:
+    static constexpr std::chrono::milliseconds IDLE_TIMEOUT{10};
+
+    const AsyncLoggingOptions options_;
+    thread::BoundedQueue<logging::record_view> queue_;
+    const size_t high_watermark_;
+
+    std::mutex sinks_lock_;
+    std::vector<boost::shared_ptr<sinks::sink>> sinks_;
+
+    std::atomic_uint64_t dropped_[fatal + 1] = {};
+    std::atomic_uint64_t blocked_{0};
+
+    std::mutex sleep_lock_;
+    std::condition_variable sleep_;
+    std::atomic_bool sleeping_{false};
+    std::atomic_bool busy_{false};
+    std::atomic_bool stopped_{false};
+    std::thread thread_;
+};
+
+struct Registry
+{
+    std::mutex lock;
+    std::vector<boost::shared_ptr<sinks::sink>> sinks;
+    boost::shared_ptr<AsyncDispatcher> dispatcher;
+};
+
+Registry& registry()
+{
+    // never destroyed, flush_logs() runs at exit after the static
+    // destructors
+    static auto* registry = new Registry;
+    return *registry;
+}
+
+} // namespace
+
+namespace detail
+{
+
+void add_sink(boost::shared_ptr<sinks::sink> sink)
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.lock);
+    reg.sinks.push_back(sink);
+
+    if (reg.dispatcher)
+    {
+        reg.dispatcher->add(std::move(sink));
+    }
+    else
+    {
+        logging::core::get()->add_sink(std::move(sink));
+    }
+}
+
+} // namespace detail
+
+void remove_sink(const boost::shared_ptr<sinks::sink>& sink)
+{
+    auto& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.lock);
+        reg.sinks.erase(std::remove(reg.sinks.begin(), reg.sinks.end(), sink),
+                        reg.sinks.end());
+
+        if (reg.dispatcher)
+        {
+            // the records already queued still reach it
+            reg.dispatcher->flush();
+            reg.dispatcher->remove(sink);
+        }
+        logging::core::get()->remove_sink(sink);
+    }
+    sink->flush();
+}
+
+void remove_all_sinks()
+{
+    auto& reg = registry();
+    std::vector<boost::shared_ptr<sinks::sink>> removed;
+    {
+        std::lock_guard<std::mutex> lock(reg.lock);
+        auto core = logging::core::get();
+        core->flush();
+        core->remove_all_sinks();
+
+        removed.swap(reg.sinks);
+        if (reg.dispatcher)
+        {
+            reg.dispatcher->remove_all();
+            core->add_sink(reg.dispatcher);
+        }
+    }
+
+    // the last references, the background threads of the sinks stop here
+    removed.clear();
+}
+
+void enable_async_logging(const AsyncLoggingOptions& options)
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.lock);
+    if (reg.dispatcher)
+    {
+        return;
+    }
+
+    // its thread must not outlive the sinks
+    static std::once_flag at_exit;
+    std::call_once(at_exit, [] { ::atexit(&disable_async_logging); });
+
+    auto core = logging::core::get();
+    reg.dispatcher = boost::make_shared<AsyncDispatcher>(options);
+    for (const auto& sink : reg.sinks)
+    {
+        reg.dispatcher->add(sink);
+    }
+
+    core->add_sink(reg.dispatcher);
+    for (const auto& sink : reg.sinks)
+    {
+        core->remove_sink(sink);
+    }
+}
+
+void disable_async_logging()
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.lock);
+    if (!reg.dispatcher)
+    {
+        return;
+    }
+
+    auto core = logging::core::get();
+    for (const auto& sink : reg.sinks)
+    {
+        core->add_sink(sink);
+    }
+    core->remove_sink(reg.dispatcher);
+
+    reg.dispatcher->flush();
+    reg.dispatcher->stop();
+    reg.dispatcher.reset();
+}
+
+AsyncLoggingStats async_logging_stats()
+{
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.lock);
+    if (!reg.dispatcher)
+    {
+        return {};
+    }
+
+    return reg.dispatcher->stats();
+}
+
+} // namespace core
+} // namespace commonpp
@@ -0,0 +1,622 @@
+/*
+ * File: src/commonpp/core/DeferredLogging.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/DeferredLogging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/log/attributes/constant.hpp>
+#include <boost/log/attributes/mutable_constant.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+#include <boost/log/sources/severity_channel_logger.hpp>
+
+#include "commonpp/thread/Thread.hpp"
+
+namespace logging = boost::log;
+namespace keywords = logging::keywords;
+namespace attrs = logging::attributes;
+namespace src = logging::sources;
+
+namespace commonpp
+{
+namespace core
+{
+namespace detail
+{
+
+static constexpr uint32_t PADDING = UINT32_MAX;
+
+static uint64_t align_record(uint64_t size) noexcept
+{
+    return (size + 7) & ~uint64_t(7);
+}
+
+// Single producer (the logging thread), single consumer (the decoder) ring
+// of records. head and tail only grow, the records are never split: when
+// one does not fit before the end of the buffer a padding record is
+// written and the record starts over at the beginning.
+struct DeferredRing
+{
+    explicit DeferredRing(size_t capacity)
+    : data(new char[capacity])
+    , mask(capacity - 1)
+    {
+    }
+
+    // returns true when the ring is more than half full
+    bool write(const char* record, uint32_t size) noexcept
+    {
+        auto capacity = mask + 1;
+        auto aligned = align_record(size);
+        auto h = head.load(std::memory_order_relaxed);
+        auto pos = h & mask;
+        uint64_t pad = pos + aligned > capacity ? capacity - pos : 0;
+
+        if (aligned > capacity / 2)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        if (h + pad + aligned - cached_tail > capacity)
+        {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h + pad + aligned - cached_tail > capacity)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        if (pad)
+        {
+            uint32_t padding[2] = {static_cast<uint32_t>(pad), PADDING};
+            std::memcpy(data.get() + pos, padding, sizeof(padding));
+            pos = 0;
+        }
+
+        std::memcpy(data.get() + pos, record, size);
+        h += pad + aligned;
+        head.store(h, std::memory_order_release);
+
+        if (h - cached_tail > capacity / 2)
+        {
+            cached_tail = tail.load(std::memory_order_acquire);
+            return h - cached_tail > capacity / 2;
+        }
+
+        return false;
+    }
+
+    std::unique_ptr<char[]> data;
+    const uint64_t mask;
+
+    alignas(64) std::atomic<uint64_t> head{0};
+    uint64_t cached_tail = 0;
+    std::atomic<uint64_t> dropped{0};
+
+    alignas(64) std::atomic<uint64_t> tail{0};
+    // the thread is gone, the ring is released once empty
+    std::atomic_bool orphaned{false};
+};
+
+namespace
+{
+
+void decode_arguments(std::ostream& os, const char* p, const char* end)
+{
+    while (p < end)
+    {
+        auto type = static_cast<DeferredArg>(*p++);
+
+        switch (type)
+        {
+        case DeferredArg::Bool:
+        {
+            bool value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            os << value;
+            break;
+        }
+        case DeferredArg::Char:
+            os << *p++;
+            break;
+        case DeferredArg::Int:
+        {
+            int64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            os << value;
+            break;
+        }
+        case DeferredArg::UInt:
+        {
+            uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            os << value;
+            break;
+        }
+        case DeferredArg::Double:
+        {
+            double value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            os << value;
+            break;
+        }
+        case DeferredArg::String:
+        {
+            uint32_t size;
+            std::memcpy(&size, p, sizeof(size));
+            p += sizeof(size);
+            os << std::string_view(p, size);
+            p += size;
+            break;
+        }
+        case DeferredArg::Copy:
+        {
+            DecodeCopy decode;
+            std::memcpy(&decode, p, sizeof(decode));
+            p += sizeof(decode);
+            p += decode(os, p);
+            break;
+        }
+        case DeferredArg::IosManip:
+        {
+            IosManip manip;
+            std::memcpy(&manip, p, sizeof(manip));
+            p += sizeof(manip);
+            os << manip;
+            break;
+        }
+        case DeferredArg::OstreamManip:
+        {
+            OstreamManip manip;
+            std::memcpy(&manip, p, sizeof(manip));
+            p += sizeof(manip);
+            os << manip;
+            break;
+        }
+        default:
+            std::abort(); // corrupted ring
+        }
+    }
+}
+
+class Decoder
+{
+public:
+    std::shared_ptr<DeferredRing> add_ring()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto ring = std::make_shared<DeferredRing>(ring_size_);
+        rings_.push_back(ring);
+        generation_.fetch_add(1, std::memory_order_release);
+
+        if (!thread_.joinable() && !stopped_)
+        {
+            // the core must outlive the decoder, stop() is called before
+            // it is destroyed
+            logging::core::get();
+            thread_ = std::thread(&Decoder::run, this);
+            std::atexit(&stop_deferred_logging);
+        }
+
+        return ring;
+    }
+
+    void set_ring_size(size_t bytes)
+    {
+        size_t size = 4096;
+        while (size < bytes)
+        {
+            size <<= 1;
+        }
+
+        std::lock_guard<std::mutex> lock(lock_);
+        ring_size_ = size;
+    }
+
+    void wake_up()
+    {
+        if (sleeping_.load(std::memory_order_relaxed))
+        {
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                wake_requested_ = true;
+            }
+            cv_.notify_one();
+        }
+    }
+
+    void flush()
+    {
+        std::vector<std::pair<std::shared_ptr<DeferredRing>, uint64_t>> heads;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (!thread_.joinable())
+            {
+                return;
+            }
+
+            for (auto& ring : rings_)
+            {
+                heads.emplace_back(ring, ring->head.load(std::memory_order_acquire));
+            }
+            wake_requested_ = true;
+        }
+        cv_.notify_one();
+
+        for (auto& ring : heads)
+        {
+            while (ring.first->tail.load(std::memory_order_acquire) < ring.second)
+            {
+                wake_up();
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        logging::core::get()->flush();
+    }
+
+    void stop()
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        stopped_ = true;
+        if (!thread_.joinable())
+        {
+            return;
+        }
+
+        wake_requested_ = true;
+        lock.unlock();
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    DeferredLoggingStats stats()
+    {
+        DeferredLoggingStats stats;
+        std::lock_guard<std::mutex> lock(lock_);
+        stats.dropped = released_dropped_;
+        for (auto& ring : rings_)
+        {
+            stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        stats.decoded = decoded_.load(std::memory_order_relaxed);
+        stats.threads = rings_.size();
+        return stats;
+    }
+
+private:
+    void run()
+    {
+        thread::set_current_thread_name("commonpp-dlog");
+
+        // off the logging threads, their records read steady_clock until
+        // the calibration is done
+        TscClock::init();
+
+        // the attributes captured by the logging thread
+        src::severity_channel_logger<LoggingLevel> logger(
+            keywords::channel = std::string());
+        attrs::mutable_constant<boost::posix_time::ptime> timestamp(
+            boost::posix_time::ptime{});
+        attrs::mutable_constant<InternedThreadName> thread_name(InternedThreadName{});
+        logger.add_attribute("CommonppRecord", attrs::constant<bool>(true));
+        logger.add_attribute("TimeStamp", timestamp);
+        logger.add_attribute("ThreadName", thread_name);
+
+        const std::string* channel = nullptr;
+        thread::ThreadNameId name = InternedThreadName{}.id;
+        logging::record_ostream strm;
+        std::vector<std::shared_ptr<DeferredRing>> rings;
+        uint64_t generation = 0;
+
+        for (;;)
+        {
+            auto current_generation = generation_.load(std::memory_order_acquire);
+            if (current_generation != generation)
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                rings = rings_;
+                generation = current_generation;
+            }
+
+            auto now_ns = TscClock::now().time_since_epoch().count();
+            auto now = boost::posix_time::microsec_clock::local_time();
+
+            size_t decoded = 0;
+            bool orphans = false;
+            for (auto& ring : rings)
+            {
+                // read before draining: a thread exiting has written its
+                // last records
+                orphans |= ring->orphaned.load(std::memory_order_acquire);
+
+                auto tail = ring->tail.load(std::memory_order_relaxed);
+                auto head = ring->head.load(std::memory_order_acquire);
+                if (tail == head)
+                {
+                    continue;
+                }
+
+                while (tail != head)
+                {
+                    auto data = ring->data.get() + (tail & ring->mask);
+                    uint32_t first[2];
+                    std::memcpy(first, data, sizeof(first));
+                    if (first[1] == PADDING)
+                    {
+                        tail += first[0];
+                        continue;
+                    }
+
+                    DeferredHeader header;
+                    std::memcpy(&header, data, sizeof(header));
+                    tail += align_record(header.size);
+                    ++decoded;
+
+                    if (header.channel != channel)
+                    {
+                        channel = header.channel;
+                        logger.channel(*channel);
+                    }
+
+                    if (header.thread_name != name)
+                    {
+                        name = header.thread_name;
+                        thread_name.set(InternedThreadName{name});
+                    }
+
+                    auto age = std::max<TscClock::rep>(now_ns - header.timestamp, 0);
+                    timestamp.set(now - boost::posix_time::microseconds(age / 1000));
+
+                    auto rec = logger.open_record(
+                        keywords::severity = static_cast<LoggingLevel>(header.severity));
+                    if (rec)
+                    {
+                        strm.attach_record(rec);
+                        decode_arguments(strm.stream(), data + sizeof(header),
+                                         data + header.size);
+                        strm.flush();
+                        strm.detach_from_record();
+                        logger.push_record(boost::move(rec));
+                    }
+                }
+
+                ring->tail.store(tail, std::memory_order_release);
+            }
+
+            decoded_.fetch_add(decoded, std::memory_order_relaxed);
+
+            if (orphans)
+            {
+                release_orphans();
+            }
+
+            if (decoded)
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(lock_);
+            if (stopped_)
+            {
+                return;
+            }
+
+            if (!wake_requested_)
+            {
+                sleeping_.store(true, std::memory_order_relaxed);
+                // the logging threads only wake us up when their ring is
+                // half full, this bounds the latency otherwise
+                cv_.wait_for(lock, std::chrono::milliseconds(10),
+                             [this] { return wake_requested_; });
+                sleeping_.store(false, std::memory_order_relaxed);
+            }
+            wake_requested_ = false;
+        }
+    }
+
+    void release_orphans()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = std::remove_if(
+            rings_.begin(), rings_.end(),
+            [this](const std::shared_ptr<DeferredRing>& ring)
+            {
+                if (!ring->orphaned.load(std::memory_order_acquire) ||
+                    ring->tail.load(std::memory_order_relaxed) !=
+                        ring->head.load(std::memory_order_acquire))
+                {
+                    return false;
+                }
+
+                released_dropped_ += ring->dropped.load(std::memory_order_relaxed);
+                return true;
+            });
+
+        if (it != rings_.end())
+        {
+            rings_.erase(it, rings_.end());
+            generation_.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+private:
+    std::mutex lock_;
+    std::condition_variable cv_;
+    bool wake_requested_ = false;
+    bool stopped_ = false;
+    std::atomic_bool sleeping_{false};
+
+    size_t ring_size_ = 1 << 20;
+    std::vector<std::shared_ptr<DeferredRing>> rings_;
+    std::atomic<uint64_t> generation_{0};
+    uint64_t released_dropped_ = 0;
+    std::atomic<uint64_t> decoded_{0};
+
+    std::thread thread_;
+};
+
+// never destroyed: the logging threads may exit after the static
+// destructors ran
+Decoder& decoder()
+{
+    static Decoder* decoder = new Decoder;
+    return *decoder;
+}
+
+struct ThreadStream
+{
+    explicit ThreadStream(std::shared_ptr<DeferredRing> r)
+    : ring(std::move(r))
+    , stream(ring.get())
+    {
+    }
+
+    ~ThreadStream()
+    {
+        current_deferred_stream = nullptr;
+        ring->orphaned.store(true, std::memory_order_release);
+    }
+
+    std::shared_ptr<DeferredRing> ring;
+    DeferredStream stream;
+};
+
+static constexpr size_t STAGING_SIZE = 512;
+
+} // namespace
+
+thread_local DeferredStream* current_deferred_stream = nullptr;
+
+DeferredStream& create_deferred_stream()
+{
+    static thread_local std::unique_ptr<ThreadStream> thread_stream;
+
+    thread_stream = std::make_unique<ThreadStream>(decoder().add_ring());
+    current_deferred_stream = &thread_stream->stream;
+    return thread_stream->stream;
+}
+
+DeferredStream::DeferredStream(DeferredRing* ring)
+: ring_(ring)
+, buffer_(new char[STAGING_SIZE])
+, cur_(buffer_ + sizeof(DeferredHeader))
+, end_(buffer_ + STAGING_SIZE)
+{
+}
+
+DeferredStream::~DeferredStream()
+{
+    delete[] buffer_;
+}
+
+DeferredStream& DeferredStream::nested()
+{
+    if (!nested_)
+    {
+        nested_ = std::make_unique<DeferredStream>(ring_);
+    }
+    return *nested_;
+}
+
+void DeferredStream::grow(size_t size)
+{
+    auto used = static_cast<size_t>(cur_ - buffer_);
+    auto capacity = std::max(static_cast<size_t>(end_ - buffer_) * 2, used + size);
+
+    auto buffer = new char[capacity];
+    std::memcpy(buffer, buffer_, used);
+    delete[] buffer_;
+
+    buffer_ = buffer;
+    cur_ = buffer_ + used;
+    end_ = buffer_ + capacity;
+}
+
+void DeferredStream::commit() noexcept
+{
+    auto size = static_cast<uint32_t>(cur_ - buffer_);
+    auto header = reinterpret_cast<DeferredHeader*>(buffer_);
+    header->size = size;
+    // per record, the thread may have been renamed since its ring exists
+    header->thread_name = thread::get_current_thread_name_id();
+
+    open_ = false;
+    if (ring_->write(buffer_, size))
+    {
+        decoder().wake_up();
+    }
+}
+
+void stop_deferred_logging()
+{
+    decoder().stop();
+}
+
+} // namespace detail
+
+namespace
+{
+struct Channels
+{
+    std::mutex lock;
+    std::set<std::string> names;
+};
+
+// the loggers are created during the static initialization
+Channels& channels()
+{
+    static Channels* channels = new Channels;
+    return *channels;
+}
+} // namespace
+
+DeferredLogger::DeferredLogger(const std::string& channel)
+: min_level_(&detail::channel_min_level(channel))
+{
+    auto& interned = channels();
+    std::lock_guard<std::mutex> lock(interned.lock);
+    channel_ = &*interned.names.insert(channel).first;
+}
+
+void set_deferred_ring_size(size_t bytes)
+{
+    detail::decoder().set_ring_size(bytes);
+}
+
+void flush_deferred_logging()
+{
+    detail::decoder().flush();
+}
+
+DeferredLoggingStats deferred_logging_stats()
+{
+    return detail::decoder().stats();
+}
+
+} // namespace core
+} // namespace commonpp
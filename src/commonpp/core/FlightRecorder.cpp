@@ -0,0 +1,737 @@
+/*
+ * File: src/commonpp/core/FlightRecorder.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/LoggingInterface.hpp"
+
+#include <ios>
+#include <stdexcept>
+
+namespace commonpp
+{
+namespace core
+{
+namespace detail
+{
+// the next record starts with the default format flags
+static void reset_capture(CaptureStream& capture) noexcept
+{
+    static const std::ios default_format(nullptr);
+    capture.stream.stream().copyfmt(default_format);
+    capture.stream.stream().clear();
+    capture.open = false;
+}
+} // namespace detail
+} // namespace core
+} // namespace commonpp
+
+#if !defined(_WIN32)
+
+# include <algorithm>
+# include <atomic>
+# include <cerrno>
+# include <chrono>
+# include <climits>
+# include <cmath>
+# include <csignal>
+# include <cstring>
+# include <memory>
+# include <mutex>
+# include <string_view>
+# include <system_error>
+
+# include <fcntl.h>
+# include <unistd.h>
+
+# include <boost/date_time/posix_time/posix_time.hpp>
+# include <boost/log/core.hpp>
+# include <boost/log/core/record_view.hpp>
+# include <boost/log/expressions/message.hpp>
+# include <boost/log/sinks/sink.hpp>
+# include <boost/smart_ptr/make_shared.hpp>
+
+# include "commonpp/thread/Thread.hpp"
+# include "detail/sinks.hpp"
+
+namespace logging = boost::log;
+namespace sinks = logging::sinks;
+namespace expr = logging::expressions;
+
+namespace commonpp
+{
+namespace core
+{
+
+namespace
+{
+
+const size_t MIN_RING_SIZE = 4096;
+const size_t MAX_CHANNEL_SIZE = 255;
+
+struct EntryHeader
+{
+    // the whole entry, padded to the header alignment
+    uint32_t size;
+    uint32_t message_size;
+    // local time, in microseconds since 1970
+    int64_t timestamp;
+    uint8_t severity;
+    uint8_t channel_size;
+};
+
+size_t align(size_t size)
+{
+    return (size + alignof(EntryHeader) - 1) & ~(alignof(EntryHeader) - 1);
+}
+
+// Only async-signal-safe calls from here, the dump runs in signal handlers.
+class Writer
+{
+public:
+    explicit Writer(int fd)
+    : fd_(fd)
+    {
+    }
+
+    ~Writer()
+    {
+        flush();
+    }
+
+    void write(const char* data, size_t size)
+    {
+        while (size)
+        {
+            auto chunk = std::min(size, sizeof(buffer_) - size_);
+            std::memcpy(buffer_ + size_, data, chunk);
+            size_ += chunk;
+            data += chunk;
+            size -= chunk;
+            if (size_ == sizeof(buffer_))
+            {
+                flush();
+            }
+        }
+    }
+
+    void write(std::string_view str)
+    {
+        write(str.data(), str.size());
+    }
+
+    void write(char c)
+    {
+        write(&c, 1);
+    }
+
+    void write_number(uint64_t value, int width = 0)
+    {
+        char digits[24];
+        int size = 0;
+        do
+        {
+            digits[sizeof(digits) - ++size] = '0' + value % 10;
+            value /= 10;
+        } while (value || size < width);
+        write(digits + sizeof(digits) - size, size);
+    }
+
+    // YYYY-MM-DD HH:MM:SS.ffffff, as the text formatter does
+    void write_timestamp(int64_t timestamp)
+    {
+        const int64_t us_per_day = 86400LL * 1000000;
+        auto days = timestamp / us_per_day;
+        auto time = timestamp % us_per_day;
+        if (time < 0)
+        {
+            time += us_per_day;
+            --days;
+        }
+
+        // H. Hinnant's civil_from_days
+        days += 719468;
+        auto era = (days >= 0 ? days : days - 146096) / 146097;
+        auto doe = days - era * 146097;
+        auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        auto mp = (5 * doy + 2) / 153;
+        auto day = doy - (153 * mp + 2) / 5 + 1;
+        auto month = mp < 10 ? mp + 3 : mp - 9;
+        auto year = yoe + era * 400 + (month <= 2);
+
+        write_number(year, 4);
+        write('-');
+        write_number(month, 2);
+        write('-');
+        write_number(day, 2);
+        write(' ');
+        write_number(time / 3600000000LL, 2);
+        write(':');
+        write_number(time / 60000000 % 60, 2);
+        write(':');
+        write_number(time / 1000000 % 60, 2);
+        write('.');
+        write_number(time % 1000000, 6);
+    }
+
+    void flush()
+    {
+        const char* data = buffer_;
+        while (size_)
+        {
+            auto written = ::write(fd_, data, size_);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                break;
+            }
+            data += written;
+            size_ -= written;
+        }
+        size_ = 0;
+    }
+
+private:
+    int fd_;
+    size_t size_ = 0;
+    char buffer_[4096];
+};
+
+// The records of one thread, oldest first. Written by its thread only, the
+// lock is for the dumps.
+class Ring
+{
+public:
+    explicit Ring(size_t size)
+    : mask_(size - 1)
+    , buffer_(new char[size])
+    {
+    }
+
+    void set_thread_name(thread::ThreadNameId id)
+    {
+        thread_name_.store(id, std::memory_order_relaxed);
+    }
+
+    void push(int64_t timestamp,
+              LoggingLevel severity,
+              std::string_view channel,
+              std::string_view message)
+    {
+        channel = channel.substr(0, MAX_CHANNEL_SIZE);
+        // a record never takes more than half of the ring
+        message = message.substr(0, capacity() / 2 - sizeof(EntryHeader) -
+                                        channel.size());
+
+        EntryHeader header;
+        header.size = align(sizeof(header) + channel.size() + message.size());
+        header.message_size = message.size();
+        header.timestamp = timestamp;
+        header.severity = severity;
+        header.channel_size = channel.size();
+
+        lock();
+        auto head = head_.load(std::memory_order_relaxed);
+        auto tail = tail_.load(std::memory_order_relaxed);
+        while (head + header.size - tail > capacity())
+        {
+            EntryHeader oldest;
+            read(tail, &oldest, sizeof(oldest));
+            tail += oldest.size;
+        }
+        tail_.store(tail, std::memory_order_relaxed);
+
+        write(head, &header, sizeof(header));
+        write(head + sizeof(header), channel.data(), channel.size());
+        write(head + sizeof(header) + channel.size(), message.data(), message.size());
+        head_.store(head + header.size, std::memory_order_relaxed);
+        unlock();
+    }
+
+    // In a signal handler the interrupted thread may hold the lock: it is
+    // given up after a while and the ring is read as it is, the entries are
+    // checked before being written.
+    size_t dump(Writer& writer, bool wait)
+    {
+        bool locked = wait ? (lock(), true) : try_lock();
+
+        size_t records = 0;
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto head = head_.load(std::memory_order_relaxed);
+        // the interned names are read without lock
+        const auto& thread_name =
+            thread::get_thread_name(thread_name_.load(std::memory_order_relaxed));
+
+        while (tail < head && head - tail <= capacity())
+        {
+            EntryHeader header;
+            read(tail, &header, sizeof(header));
+            if (header.size < sizeof(header) || header.size > head - tail ||
+                sizeof(header) + header.channel_size + header.message_size >
+                    header.size)
+            {
+                break;
+            }
+
+            writer.write_timestamp(header.timestamp);
+            writer.write(" [");
+            writer.write(to_string(to_severity(header.severity)));
+            writer.write("][");
+            if (header.channel_size)
+            {
+                write_to(writer, tail + sizeof(header), header.channel_size);
+            }
+            else
+            {
+                writer.write("N/A");
+            }
+            writer.write("][");
+            writer.write(thread_name);
+            writer.write("]: ");
+            write_to(writer, tail + sizeof(header) + header.channel_size,
+                     header.message_size);
+            writer.write('\n');
+
+            tail += header.size;
+            ++records;
+        }
+
+        if (locked)
+        {
+            unlock();
+        }
+        return records;
+    }
+
+    void reset()
+    {
+        lock();
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        unlock();
+    }
+
+    std::atomic_bool in_use{true};
+    Ring* next = nullptr;
+
+private:
+    size_t capacity() const
+    {
+        return mask_ + 1;
+    }
+
+    void lock()
+    {
+        while (lock_.test_and_set(std::memory_order_acquire))
+        {
+        }
+    }
+
+    bool try_lock()
+    {
+        for (int i = 0; i < 100000; ++i)
+        {
+            if (!lock_.test_and_set(std::memory_order_acquire))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void unlock()
+    {
+        lock_.clear(std::memory_order_release);
+    }
+
+    void write(uint64_t position, const void* data, size_t size)
+    {
+        auto offset = position & mask_;
+        auto first = std::min(size, capacity() - offset);
+        std::memcpy(buffer_.get() + offset, data, first);
+        std::memcpy(buffer_.get(), static_cast<const char*>(data) + first,
+                    size - first);
+    }
+
+    void read(uint64_t position, void* data, size_t size) const
+    {
+        auto offset = position & mask_;
+        auto first = std::min(size, capacity() - offset);
+        std::memcpy(data, buffer_.get() + offset, first);
+        std::memcpy(static_cast<char*>(data) + first, buffer_.get(), size - first);
+    }
+
+    void write_to(Writer& writer, uint64_t position, size_t size) const
+    {
+        auto offset = position & mask_;
+        auto first = std::min(size, capacity() - offset);
+        writer.write(buffer_.get() + offset, first);
+        writer.write(buffer_.get(), size - first);
+    }
+
+    const size_t mask_;
+    std::unique_ptr<char[]> buffer_;
+    std::atomic<uint64_t> head_{0};
+    std::atomic<uint64_t> tail_{0};
+    std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+    std::atomic<thread::ThreadNameId> thread_name_{0};
+};
+
+// The rings are never freed: the ring of a finished thread is kept, with
+// its records, until another thread takes it.
+std::atomic<Ring*> rings{nullptr};
+size_t ring_size = 0;
+
+Ring* acquire_ring()
+{
+    for (auto ring = rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        bool in_use = false;
+        if (ring->in_use.compare_exchange_strong(in_use, true))
+        {
+            ring->reset();
+            return ring;
+        }
+    }
+
+    auto ring = new Ring(ring_size);
+    ring->next = rings.load(std::memory_order_relaxed);
+    while (!rings.compare_exchange_weak(ring->next, ring, std::memory_order_release))
+    {
+    }
+    return ring;
+}
+
+struct ThreadRing
+{
+    ~ThreadRing()
+    {
+        if (ring)
+        {
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+
+    Ring* get()
+    {
+        if (BOOST_UNLIKELY(!ring))
+        {
+            ring = acquire_ring();
+            ring->set_thread_name(thread::get_current_thread_name_id());
+        }
+        return ring;
+    }
+
+    Ring* ring = nullptr;
+};
+
+thread_local ThreadRing thread_ring;
+
+// The captured records are timestamped like the TimeStamp attribute, in
+// local time: the offset is taken when the recorder is enabled, a later
+// daylight saving change is not followed.
+std::atomic<int64_t> utc_offset{0};
+
+int64_t local_timestamp()
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count() +
+           utc_offset.load(std::memory_order_relaxed);
+}
+
+int64_t local_utc_offset()
+{
+    namespace pt = boost::posix_time;
+    auto offset = pt::microsec_clock::local_time() - pt::microsec_clock::universal_time();
+    const int64_t minute = 60 * 1000000LL;
+    return std::llround(static_cast<double>(offset.total_microseconds()) / minute) *
+           minute;
+}
+
+size_t dump_rings(int fd, std::string_view reason, bool wait)
+{
+    Writer writer(fd);
+    writer.write("--- flight recorder dump: ");
+    writer.write(reason);
+    writer.write(" ---\n");
+
+    size_t records = 0;
+    for (auto ring = rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        records += ring->dump(writer, wait);
+    }
+    return records;
+}
+
+// Fed by the logging threads themselves, it is never behind the
+// asynchronous dispatcher.
+class FlightRecorderSink : public sinks::sink
+{
+public:
+    explicit FlightRecorderSink(LoggingLevel level)
+    : sinks::sink(false)
+    , level_(level)
+    {
+    }
+
+    bool will_consume(const logging::attribute_value_set& values) override
+    {
+        auto commonpp_record = values[CommonppRecord];
+        if (!commonpp_record || !*commonpp_record)
+        {
+            return false;
+        }
+
+        auto severity = values[Severity];
+        return !severity || *severity >= level_;
+    }
+
+    void consume(const logging::record_view& rec) override
+    {
+        static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+        const auto& values = rec.attribute_values();
+        auto ring = thread_ring.get();
+
+        auto thread_name = values[ThreadName];
+        if (thread_name)
+        {
+            ring->set_thread_name(thread_name->id);
+        }
+
+        int64_t timestamp = 0;
+        auto time = values["TimeStamp"].extract<boost::posix_time::ptime>();
+        if (time && !time->is_special())
+        {
+            timestamp = (*time - epoch).total_microseconds();
+        }
+
+        auto severity = values[Severity];
+        auto channel = values[Channel];
+        auto message = values[expr::smessage];
+        ring->push(timestamp, severity ? *severity : info,
+                   channel ? std::string_view(*channel) : std::string_view(),
+                   message ? std::string_view(*message) : std::string_view());
+    }
+
+    bool try_consume(const logging::record_view& rec) override
+    {
+        consume(rec);
+        return true;
+    }
+
+    void flush() override
+    {
+    }
+
+private:
+    const LoggingLevel level_;
+};
+
+std::mutex recorder_lock;
+boost::shared_ptr<FlightRecorderSink> recorder;
+
+// read by the signal handlers
+char dump_path[PATH_MAX];
+int dump_signal = 0;
+struct sigaction previous_actions[NSIG];
+
+const int CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+void on_signal(int signal)
+{
+    auto saved_errno = errno;
+    int fd = ::open(dump_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd != -1)
+    {
+        const char* reason = signal == dump_signal ? "signal" : "crash";
+        dump_rings(fd, reason, false);
+        ::close(fd);
+    }
+    errno = saved_errno;
+
+    if (signal != dump_signal)
+    {
+        // the previous handler, or the default action, runs once we return
+        ::sigaction(signal, &previous_actions[signal], nullptr);
+        ::raise(signal);
+    }
+}
+
+void install_handler(int signal)
+{
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &on_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART | SA_ONSTACK;
+    if (::sigaction(signal, &action, &previous_actions[signal]) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(),
+                                "cannot install the flight recorder handler");
+    }
+}
+
+} // namespace
+
+void enable_flight_recorder(const FlightRecorderOptions& options)
+{
+    std::lock_guard<std::mutex> lock(recorder_lock);
+    if (recorder)
+    {
+        return;
+    }
+
+    if (options.path.size() >= sizeof(dump_path))
+    {
+        throw std::invalid_argument("flight recorder path is too long");
+    }
+    if (options.signal < 0 || options.signal >= NSIG)
+    {
+        throw std::invalid_argument("invalid flight recorder signal");
+    }
+
+    ring_size = MIN_RING_SIZE;
+    while (ring_size < options.ring_size)
+    {
+        ring_size *= 2;
+    }
+    std::memcpy(dump_path, options.path.c_str(), options.path.size() + 1);
+
+    if (options.dump_on_crash)
+    {
+        for (auto signal : CRASH_SIGNALS)
+        {
+            install_handler(signal);
+        }
+    }
+    if (options.signal)
+    {
+        dump_signal = options.signal;
+        install_handler(options.signal);
+    }
+
+    utc_offset.store(local_utc_offset(), std::memory_order_relaxed);
+
+    recorder = boost::make_shared<FlightRecorderSink>(options.level);
+    logging::core::get()->add_sink(recorder);
+    detail::flight_recorder_level.store(options.level, std::memory_order_release);
+}
+
+namespace detail
+{
+void close_capture(CaptureStream& capture,
+                   LoggingLevel level,
+                   std::string_view channel,
+                   bool discard) noexcept
+{
+    capture.stream.flush();
+    // synchronizes with enable_flight_recorder()
+    if (!discard && flight_recorder_level.load(std::memory_order_acquire) <= fatal)
+    {
+        try
+        {
+            auto ring = thread_ring.get();
+            ring->set_thread_name(thread::get_current_thread_name_id());
+            ring->push(local_timestamp(), level, channel, capture.message);
+        }
+        catch (...)
+        {
+            // no ring for this thread
+        }
+    }
+
+    reset_capture(capture);
+}
+} // namespace detail
+
+size_t dump_flight_recorder(const std::string& path)
+{
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(recorder_lock);
+        file = path.empty() ? dump_path : path;
+    }
+
+    int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        throw std::system_error(errno, std::generic_category(), "cannot open " + file);
+    }
+
+    auto records = dump_rings(fd, "requested", true);
+    ::close(fd);
+    return records;
+}
+
+} // namespace core
+} // namespace commonpp
+
+#else
+
+namespace commonpp
+{
+namespace core
+{
+
+void enable_flight_recorder(const FlightRecorderOptions&)
+{
+    throw std::runtime_error("the flight recorder is not supported");
+}
+
+size_t dump_flight_recorder(const std::string&)
+{
+    throw std::runtime_error("the flight recorder is not supported");
+}
+
+namespace detail
+{
+void close_capture(CaptureStream& capture, LoggingLevel, std::string_view, bool) noexcept
+{
+    reset_capture(capture);
+}
+} // namespace detail
+
+} // namespace core
+} // namespace commonpp
+
+#endif
+
+namespace commonpp
+{
+namespace core
+{
+namespace detail
+{
+std::atomic<int> flight_recorder_level{fatal + 1};
+
+CaptureStream& open_capture()
+{
+    static thread_local CaptureStream root;
+
+    auto capture = &root;
+    while (capture->open)
+    {
+        if (!capture->nested)
+        {
+            capture->nested = std::make_unique<CaptureStream>();
+        }
+        capture = capture->nested.get();
+    }
+
+    capture->open = true;
+    capture->message.clear();
+    return *capture;
+}
+} // namespace detail
+} // namespace core
+} // namespace commonpp
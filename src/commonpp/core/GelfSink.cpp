@@ -0,0 +1,511 @@
+/*
+ * File: src/commonpp/core/GelfSink.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/LoggingInterface.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/host_name.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/core/record_view.hpp>
+#include <boost/log/expressions/message.hpp>
+#include <boost/log/sinks/sink.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+
+#if defined(__linux__)
+# include <sys/socket.h>
+#endif
+
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+#include "commonpp/core/string/json_escape.hpp"
+#include "commonpp/thread/BoundedQueue.hpp"
+#include "commonpp/thread/Thread.hpp"
+
+namespace logging = boost::log;
+namespace sinks = logging::sinks;
+namespace expr = logging::expressions;
+using boost::asio::ip::udp;
+
+namespace commonpp
+{
+namespace core
+{
+
+namespace
+{
+
+static constexpr size_t MAX_CHUNKS = 128;
+static constexpr size_t CHUNK_HEADER_SIZE = 12;
+// messages serialized before being sent at once
+static constexpr size_t BATCH_SIZE = 64;
+
+struct Counters
+{
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> send_errors{0};
+};
+
+Counters& counters()
+{
+    static Counters counters;
+    return counters;
+}
+
+void append_field(std::string& out, const std::string& key, const std::string& value)
+{
+    out += ",\"";
+    out += string::escape_json_string(key);
+    out += "\":\"";
+    out += string::escape_json_string(value);
+    out += '"';
+}
+
+// The sink registered to the logging core: the records are queued as is,
+// the background thread serializes, compresses, chunks and sends them.
+class GelfSink : public sinks::sink
+{
+public:
+    GelfSink(const std::string& server,
+             const std::string& port,
+             const std::vector<std::pair<std::string, std::string>>& static_fields,
+             const GelfOptions& options)
+    : sinks::sink(true)
+    , options_(options)
+    , queue_(options.queue_size)
+    , socket_(service_)
+    , message_id_(std::random_device()())
+    {
+        if (options_.max_chunk_size <= CHUNK_HEADER_SIZE)
+        {
+            throw std::invalid_argument("GELF chunks are too small");
+        }
+
+        udp::resolver resolver(service_);
+        boost::asio::connect(socket_, resolver.resolve(server, port));
+
+        prefix_ = "{\"version\":\"1.1\",\"host\":\"";
+        prefix_ += string::escape_json_string(
+            options_.host.empty() ? boost::asio::ip::host_name() : options_.host);
+        prefix_ += '"';
+
+        for (const auto& field : static_fields)
+        {
+            append_field(static_fields_,
+                         field.first.empty() || field.first[0] != '_'
+                             ? "_" + field.first
+                             : field.first,
+                         field.second);
+        }
+        static_fields_ += '}';
+
+        thread_ = std::thread(&GelfSink::run, this);
+    }
+
+    ~GelfSink() override
+    {
+        if (thread_.joinable())
+        {
+            stopped_.store(true);
+            wake_up();
+            thread_.join();
+        }
+    }
+
+    bool will_consume(const logging::attribute_value_set& values) override
+    {
+        auto commonpp_record = values[CommonppRecord];
+        return commonpp_record && *commonpp_record;
+    }
+
+    void consume(const logging::record_view& rec) override
+    {
+        if (BOOST_LIKELY(queue_.try_push(rec)))
+        {
+            wake_up();
+            return;
+        }
+
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        counters().dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool try_consume(const logging::record_view& rec) override
+    {
+        consume(rec);
+        return true;
+    }
+
+    void flush() override
+    {
+        while (!queue_.empty() || busy_.load())
+        {
+            wake_up();
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    void wake_up()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed))
+        {
+            sleeping_.store(false, std::memory_order_relaxed);
+            sleeping_.notify_one();
+        }
+    }
+
+    void run()
+    {
+        thread::set_current_thread_name("commonpp-gelf");
+
+        logging::record_view rec;
+        for (;;)
+        {
+            busy_.store(true);
+            local_offset_ = utc_offset();
+            report_dropped();
+            while (queue_.try_pop(rec))
+            {
+                serialize(rec);
+                if (payloads_.size() == BATCH_SIZE)
+                {
+                    send();
+                }
+            }
+            rec = logging::record_view();
+            send();
+            busy_.store(false);
+
+            if (stopped_.load())
+            {
+                if (queue_.empty())
+                {
+                    return;
+                }
+                continue;
+            }
+
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!queue_.empty() || stopped_.load())
+            {
+                sleeping_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            sleeping_.wait(true);
+        }
+    }
+
+    // the TimeStamp attribute is in local time
+    static boost::posix_time::time_duration utc_offset()
+    {
+        auto offset = boost::posix_time::second_clock::local_time() -
+                      boost::posix_time::second_clock::universal_time();
+        return boost::posix_time::minutes((offset.total_seconds() + 30) / 60);
+    }
+
+    // The sink cannot log its own errors, the records dropped since the last
+    // batch are reported by a message of their own.
+    void report_dropped()
+    {
+        auto dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (!dropped)
+        {
+            return;
+        }
+
+        auto& payload = payloads_.emplace_back(prefix_);
+        append_field(payload, "short_message",
+                     "commonpp: " + std::to_string(dropped) +
+                         " records dropped, the GELF queue is full");
+        append_timestamp_and_level(payload,
+                                   boost::posix_time::microsec_clock::universal_time(),
+                                   warning);
+        payload += static_fields_;
+
+        if (options_.compress)
+        {
+            compress(payload);
+        }
+    }
+
+    static void append_timestamp_and_level(std::string& payload,
+                                           boost::posix_time::ptime utc,
+                                           LoggingLevel level)
+    {
+        static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+        auto since_epoch = utc - epoch;
+        char number[64];
+        std::snprintf(number, sizeof(number), ",\"timestamp\":%lld.%06lld,\"level\":%zu",
+                      static_cast<long long>(since_epoch.total_seconds()),
+                      static_cast<long long>(since_epoch.total_microseconds() % 1000000),
+                      to_syslog_level(level));
+        payload += number;
+    }
+
+    void serialize(const logging::record_view& rec)
+    {
+        auto& payload = payloads_.emplace_back(prefix_);
+
+        auto message = rec[expr::smessage];
+        append_field(payload, "short_message", message ? message.get() : std::string());
+
+        auto timestamp = rec.attribute_values()["TimeStamp"]
+                             .extract<boost::posix_time::ptime>();
+        append_timestamp_and_level(
+            payload,
+            timestamp ? timestamp.get() - local_offset_
+                      : boost::posix_time::microsec_clock::universal_time(),
+            rec[Severity] ? rec[Severity].get() : info);
+
+        auto channel = rec[Channel];
+        if (channel)
+        {
+            append_field(payload, "_channel", channel.get());
+        }
+
+        auto thread_name = rec[ThreadName];
+        if (thread_name)
+        {
+            append_field(payload, "_thread", thread_name->str());
+        }
+
+        payload += static_fields_;
+
+        if (options_.compress)
+        {
+            compress(payload);
+        }
+    }
+
+    void compress(std::string& payload)
+    {
+#if HAVE_ZLIB
+        uLongf size = compressBound(payload.size());
+        compressed_.resize(size);
+        if (compress2(reinterpret_cast<Bytef*>(&compressed_[0]), &size,
+                      reinterpret_cast<const Bytef*>(payload.data()),
+                      payload.size(), Z_BEST_SPEED) == Z_OK)
+        {
+            compressed_.resize(size);
+            payload.swap(compressed_);
+        }
+#endif
+    }
+
+    void send()
+    {
+        if (payloads_.empty())
+        {
+            return;
+        }
+
+        // first the chunk headers, then the datagrams pointing to them
+        const size_t chunk_size = options_.max_chunk_size - CHUNK_HEADER_SIZE;
+        headers_.clear();
+        for (auto& payload : payloads_)
+        {
+            if (payload.size() <= options_.max_chunk_size)
+            {
+                continue;
+            }
+
+            auto nb_chunks = (payload.size() + chunk_size - 1) / chunk_size;
+            if (nb_chunks > MAX_CHUNKS)
+            {
+                payload.clear(); // Graylog would discard it
+                continue;
+            }
+
+            auto id = ++message_id_;
+            for (size_t i = 0; i < nb_chunks; ++i)
+            {
+                std::array<char, CHUNK_HEADER_SIZE> header = {0x1e, 0x0f};
+                std::memcpy(&header[2], &id, sizeof(id));
+                header[10] = static_cast<char>(i);
+                header[11] = static_cast<char>(nb_chunks);
+                headers_.push_back(header);
+            }
+        }
+
+        datagrams_.clear();
+        size_t header = 0;
+        for (const auto& payload : payloads_)
+        {
+            if (payload.empty())
+            {
+                continue;
+            }
+
+            if (payload.size() <= options_.max_chunk_size)
+            {
+                datagrams_.push_back({{nullptr, 0}, {payload.data(), payload.size()}});
+                continue;
+            }
+
+            for (size_t offset = 0; offset < payload.size(); offset += chunk_size)
+            {
+                datagrams_.push_back(
+                    {{headers_[header++].data(), CHUNK_HEADER_SIZE},
+                     {payload.data() + offset,
+                      std::min(chunk_size, payload.size() - offset)}});
+            }
+        }
+
+        send_datagrams();
+        payloads_.clear();
+    }
+
+#if defined(__linux__)
+    void send_datagrams()
+    {
+        iovecs_.resize(datagrams_.size() * 2);
+        messages_.resize(datagrams_.size());
+        for (size_t i = 0; i < datagrams_.size(); ++i)
+        {
+            auto& datagram = datagrams_[i];
+            auto iov = &iovecs_[i * 2];
+            iov[0] = {const_cast<char*>(datagram.header.data), datagram.header.size};
+            iov[1] = {const_cast<char*>(datagram.payload.data), datagram.payload.size};
+
+            auto& hdr = messages_[i].msg_hdr;
+            std::memset(&messages_[i], 0, sizeof(messages_[i]));
+            hdr.msg_iov = datagram.header.size ? iov : iov + 1;
+            hdr.msg_iovlen = datagram.header.size ? 2 : 1;
+        }
+
+        // sendmmsg() stops at the first datagram it cannot send, and only
+        // fails when it is the first one: the next call starts with it and
+        // the error is always the one of messages_[sent].
+        const int fd = socket_.native_handle();
+        size_t sent = 0;
+        while (sent < messages_.size())
+        {
+            auto rc = ::sendmmsg(fd, &messages_[sent], messages_.size() - sent, 0);
+            if (rc > 0)
+            {
+                sent += rc;
+            }
+            else if (rc < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else
+            {
+                // most likely nobody listening (ECONNREFUSED), it is dropped
+                counters().send_errors.fetch_add(1, std::memory_order_relaxed);
+                ++sent;
+            }
+        }
+    }
+#else
+    void send_datagrams()
+    {
+        for (const auto& datagram : datagrams_)
+        {
+            std::array<boost::asio::const_buffer, 2> buffers = {
+                boost::asio::buffer(datagram.header.data, datagram.header.size),
+                boost::asio::buffer(datagram.payload.data, datagram.payload.size)};
+            boost::system::error_code ec;
+            socket_.send(buffers, 0, ec);
+            if (ec)
+            {
+                counters().send_errors.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+#endif
+
+private:
+    struct Slice
+    {
+        const char* data;
+        size_t size;
+    };
+
+    struct Datagram
+    {
+        Slice header;
+        Slice payload;
+    };
+
+    const GelfOptions options_;
+    thread::BoundedQueue<logging::record_view> queue_;
+
+    boost::asio::io_service service_;
+    udp::socket socket_;
+
+    // {"version":"1.1","host":"..."
+    std::string prefix_;
+    // ,"_field":"value",...}
+    std::string static_fields_;
+
+    // sender thread only
+    uint64_t message_id_;
+    boost::posix_time::time_duration local_offset_;
+    std::vector<std::string> payloads_;
+    std::string compressed_;
+    std::vector<std::array<char, CHUNK_HEADER_SIZE>> headers_;
+    std::vector<Datagram> datagrams_;
+#if defined(__linux__)
+    std::vector<iovec> iovecs_;
+    std::vector<mmsghdr> messages_;
+#endif
+
+    // since the last report
+    std::atomic<uint64_t> dropped_{0};
+
+    std::atomic_bool sleeping_{false};
+    std::atomic_bool busy_{false};
+    std::atomic_bool stopped_{false};
+    std::thread thread_;
+};
+
+} // namespace
+
+void add_gelf_sink(std::string server,
+                   std::string port,
+                   std::vector<std::pair<std::string, std::string>> static_fields,
+                   const GelfOptions& options)
+{
+    auto sink = boost::make_shared<GelfSink>(server, port, static_fields, options);
+    // already asynchronous, it does not go through the dispatcher
+    logging::core::get()->add_sink(sink);
+}
+
+GelfStats gelf_stats()
+{
+    auto& c = counters();
+    GelfStats stats;
+    stats.dropped = c.dropped.load();
+    stats.send_errors = c.send_errors.load();
+    return stats;
+}
+
+} // namespace core
+} // namespace commonpp
@@ -10,9 +10,14 @@
  */
 #include "commonpp/core/LoggingInterface.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <boost/container/flat_map.hpp>
 #include <boost/filesystem.hpp>
@@ -22,9 +27,11 @@
 #include <boost/log/expressions/attr.hpp>
 #include <boost/log/expressions/formatters/date_time.hpp>
 #include <boost/log/expressions/formatters/named_scope.hpp>
+#include <boost/log/expressions/formatters/wrap_formatter.hpp>
 #include <boost/log/sinks/sync_frontend.hpp>
 #include <boost/log/sinks/syslog_backend.hpp>
 #include <boost/log/sinks/text_multifile_backend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
 #include <boost/log/sources/basic_logger.hpp>
 #include <boost/log/sources/record_ostream.hpp>
 #include <boost/log/sources/severity_channel_logger.hpp>
@@ -36,10 +43,15 @@
 #include <boost/log/utility/setup/file.hpp>
 #include <boost/log/utility/value_ref.hpp>
 
+#include <boost/core/null_deleter.hpp>
 #include <boost/phoenix/bind.hpp>
 
+#include "commonpp/core/DeferredLogging.hpp"
+#include "commonpp/core/StructuredLogging.hpp"
 #include "commonpp/core/Utils.hpp"
+#include "commonpp/core/string/date.hpp"
 #include "commonpp/thread/Thread.hpp"
+#include "detail/sinks.hpp"
 
 namespace logging = boost::log;
 namespace sinks = logging::sinks;
@@ -71,9 +83,212 @@ std::ostream& operator<<(std::ostream& os, LoggingLevel level)
 namespace core
 {
 
+namespace
+{
+struct MinLevels
+{
+    std::mutex lock;
+    LoggingLevel global = trace;
+    std::map<std::string, LoggingLevel> by_channel;
+    std::atomic<int> global_cell{trace};
+    std::map<std::string, std::unique_ptr<std::atomic<int>>> channel_cells;
+
+    // must be called with the lock held
+    int effective_level(const std::string& channel) const
+    {
+        auto it = by_channel.find(channel);
+        return it == by_channel.end() ? global : std::max(global, it->second);
+    }
+
+    std::atomic<int>& cell(const std::string& channel)
+    {
+        auto& cell = channel_cells[channel];
+        if (!cell)
+        {
+            cell = std::make_unique<std::atomic<int>>(effective_level(channel));
+        }
+        return *cell;
+    }
+
+    void refresh_cells()
+    {
+        global_cell.store(global, std::memory_order_relaxed);
+        for (auto& cell : channel_cells)
+        {
+            cell.second->store(effective_level(cell.first), std::memory_order_relaxed);
+        }
+    }
+};
+
+// the loggers are created during the static initialization
+MinLevels& min_levels()
+{
+    static MinLevels levels;
+    return levels;
+}
+} // namespace
+
+namespace detail
+{
+const std::atomic<int>& channel_min_level(const std::string& channel)
+{
+    auto& levels = min_levels();
+    std::lock_guard<std::mutex> lock(levels.lock);
+    return levels.cell(channel);
+}
+
+const std::atomic<int>& global_min_level()
+{
+    return min_levels().global_cell;
+}
+} // namespace detail
+
+const std::string& InternedThreadName::str() const noexcept
+{
+    return thread::get_thread_name(id);
+}
+
+std::ostream& operator<<(std::ostream& os, InternedThreadName name)
+{
+    return os << name.str();
+}
+
+static InternedThreadName current_thread_name()
+{
+    return {thread::get_current_thread_name_id()};
+}
+
+namespace
+{
+// The ids of the destroyed loggers are reused, the sources of a thread are
+// bounded by the number of loggers alive at once. A source left by a
+// destroyed logger is replaced when its generation does not match.
+struct ThreadLocalLoggerIds
+{
+    std::mutex lock;
+    std::vector<size_t> released;
+    size_t next = 0;
+    uint64_t generation = 0;
+};
+
+ThreadLocalLoggerIds& thread_local_logger_ids()
+{
+    // never destroyed, a static logger may outlive it
+    static auto* ids = new ThreadLocalLoggerIds;
+    return *ids;
+}
+
+std::pair<size_t, uint64_t> acquire_thread_local_logger_id()
+{
+    auto& ids = thread_local_logger_ids();
+    std::lock_guard<std::mutex> lock(ids.lock);
+    auto generation = ++ids.generation;
+    if (ids.released.empty())
+    {
+        return {ids.next++, generation};
+    }
+
+    auto id = ids.released.back();
+    ids.released.pop_back();
+    return {id, generation};
+}
+
+struct ThreadSource
+{
+    uint64_t generation = 0;
+    std::unique_ptr<ThreadLocalLogger::source_type> source;
+};
+
+// the sources of the calling thread, by ThreadLocalLogger id
+thread_local std::vector<ThreadSource> thread_sources;
+} // namespace
+
+ThreadLocalLogger::ThreadLocalLogger(std::string channel)
+: ThreadLocalLogger(std::move(channel), acquire_thread_local_logger_id())
+{
+}
+
+ThreadLocalLogger::ThreadLocalLogger(std::string channel,
+                                     std::pair<size_t, uint64_t> id)
+: channel_(std::move(channel))
+, id_(id.first)
+, generation_(id.second)
+, min_level_(&detail::channel_min_level(channel_))
+{
+}
+
+ThreadLocalLogger::~ThreadLocalLogger()
+{
+    auto& ids = thread_local_logger_ids();
+    std::lock_guard<std::mutex> lock(ids.lock);
+    ids.released.push_back(id_);
+}
+
+void ThreadLocalLogger::add_attribute(const logging::attribute_name& name,
+                                      const logging::attribute& attribute)
+{
+    std::lock_guard<std::mutex> lock(attributes_lock_);
+    attributes_.insert(name, attribute);
+}
+
+ThreadLocalLogger::source_type& ThreadLocalLogger::source()
+{
+    auto& sources = thread_sources;
+    if (BOOST_LIKELY(id_ < sources.size() && sources[id_].generation == generation_))
+    {
+        return *sources[id_].source;
+    }
+    return create_source();
+}
+
+ThreadLocalLogger::source_type& ThreadLocalLogger::create_source()
+{
+    auto source = std::make_unique<source_type>(keywords::channel = channel_);
+    {
+        std::lock_guard<std::mutex> lock(attributes_lock_);
+        for (const auto& attribute : attributes_)
+        {
+            source->add_attribute(attribute.first, attribute.second);
+        }
+    }
+
+    auto& sources = thread_sources;
+    if (sources.size() <= id_)
+    {
+        sources.resize(id_ + 1);
+    }
+    sources[id_] = ThreadSource{generation_, std::move(source)};
+    return *sources[id_].source;
+}
+
+namespace detail
+{
+RecordStream& open_record_stream(logging::record& rec)
+{
+    static thread_local RecordStream root;
+
+    auto stream = &root;
+    while (stream->open)
+    {
+        if (!stream->nested)
+        {
+            stream->nested = std::make_unique<RecordStream>();
+        }
+        stream = stream->nested.get();
+    }
+
+    stream->open = true;
+    stream->stream.attach_record(rec);
+    return *stream;
+}
+} // namespace detail
+
 DECLARE_BASIC_LOGGER(global_logger);
 
 using FileSink = sinks::synchronous_sink<sinks::text_file_backend>;
+using ConsoleSink = sinks::synchronous_sink<sinks::text_ostream_backend>;
+
+BOOST_LOG_ATTRIBUTE_KEYWORD(TimeStamp, "TimeStamp", boost::posix_time::ptime);
 
 using SeverityByChannel =
     expr::channel_severity_filter_actor<std::string, LoggingLevel>;
@@ -114,9 +329,25 @@ static bool filter(logging::attribute_value_set const& values,
     return true; // by default, let's not loose any logs
 }
 
+static std::atomic<string::TimestampFormat> timestamp_format{
+    string::TimestampFormat::Default};
+
+static void format_timestamp(const logging::record_view& rec,
+                             logging::formatting_ostream& strm)
+{
+    auto timestamp = rec.attribute_values()[TimeStamp];
+    if (timestamp)
+    {
+        char buffer[string::MAX_TIMESTAMP_SIZE];
+        auto size = string::format_timestamp(
+            *timestamp, timestamp_format.load(std::memory_order_relaxed), buffer);
+        strm.write(buffer, size);
+    }
+}
+
 // clang-format off
 static const auto formatter = expr::stream
-                 << expr::format_date_time<boost::posix_time::ptime>("TimeStamp", "%Y-%m-%d %H:%M:%S.%f")
+                 << expr::wrap_formatter(&format_timestamp)
                  << " [" << Severity << "]["
                  << expr::if_(expr::has_attr<std::string>("Channel"))
                             [
@@ -126,7 +357,7 @@ static const auto formatter = expr::stream
                             [
                                 expr::stream << "N/A"
                             ]
-                << "][" << expr::attr<std::string>("ThreadName") << "]"
+                << "][" << ThreadName << "]"
                 << expr::if_(expr::has_attr<attrs::named_scope::value_type>("Scope"))
                             [
                                 expr::stream
@@ -137,10 +368,14 @@ static const auto formatter = expr::stream
                             [
                                 expr::stream << "[ExecTime: " << expr::attr<boost::posix_time::time_duration>("Duration") << "]"
                             ]
-                << ": " << expr::message;
+                << ": " << expr::message
+                << expr::if_(expr::has_attr<LogFields>(detail::fields_attribute_name()))
+                            [
+                                expr::stream << expr::attr<LogFields>(detail::fields_attribute_name())
+                            ];
 // clang-format on
 
-static decltype(boost::log::add_console_log()) console_logger = nullptr;
+static boost::shared_ptr<ConsoleSink> console_logger = nullptr;
 
 #if HAVE_SYSLOG
 using SyslogSink =
@@ -150,9 +385,9 @@ static SyslogSink syslog_logger = nullptr;
 
 static void flush_logs()
 {
-    auto core = logging::core::get();
-    core->flush();
-    core->remove_all_sinks();
+    detail::stop_deferred_logging();
+    disable_async_logging();
+    remove_all_sinks();
 }
 
 void init_logging()
@@ -166,7 +401,7 @@ void init_logging()
 
     core->add_global_attribute("Scope", attrs::named_scope());
     core->add_global_attribute(
-        "ThreadName", attrs::make_function(&thread::get_current_thread_name));
+        "ThreadName", attrs::make_function(&current_thread_name));
     set_logging_level(trace);
 
     ::atexit(&flush_logs);
@@ -177,18 +412,57 @@ void set_logging_level(LoggingLevel level)
     namespace phoenix = boost::phoenix;
     boost::log::core::get()->set_filter(
         phoenix::bind(&filter, phoenix::placeholders::_1, level));
+
+    auto& levels = min_levels();
+    std::lock_guard<std::mutex> lock(levels.lock);
+    levels.global = level;
+    levels.refresh_cells();
 }
 
 void enable_console_logging()
 {
     if (!console_logger)
     {
-        console_logger =
-            boost::log::add_console_log(std::cout, keywords::format = formatter);
-        console_logger->set_filter(CommonppRecord.or_default(false) == true);
+        console_logger = boost::make_shared<ConsoleSink>();
+        console_logger->locked_backend()->add_stream(
+            boost::shared_ptr<std::ostream>(&std::cout, boost::null_deleter()));
+        console_logger->set_formatter(formatter);
+        console_logger->set_filter(detail::log_filter());
+        detail::add_sink(console_logger);
     }
 }
 
+void set_log_timestamp_format(string::TimestampFormat format)
+{
+    timestamp_format.store(format, std::memory_order_relaxed);
+}
+
+namespace detail
+{
+string::TimestampFormat log_timestamp_format()
+{
+    return timestamp_format.load(std::memory_order_relaxed);
+}
+
+static bool is_commonpp_record(const logging::attribute_value_set& values)
+{
+    auto commonpp_record = values[CommonppRecord];
+    return commonpp_record && *commonpp_record;
+}
+
+const logging::filter& log_filter()
+{
+    static const logging::filter filter = &is_commonpp_record;
+    return filter;
+}
+
+const logging::formatter& log_formatter()
+{
+    static const logging::formatter text_formatter = formatter;
+    return text_formatter;
+}
+} // namespace detail
+
 void auto_flush_console(bool b)
 {
     if (!console_logger)
@@ -202,6 +476,12 @@ void auto_flush_console(bool b)
 void set_logging_level_for_channel(const std::string& channel, LoggingLevel level)
 {
     severity_by_channel[channel] = level;
+
+    auto& levels = min_levels();
+    std::lock_guard<std::mutex> lock(levels.lock);
+    levels.by_channel[channel] = level;
+    levels.cell(channel).store(levels.effective_level(channel),
+                               std::memory_order_relaxed);
 }
 
 void enable_builtin_syslog()
@@ -211,7 +491,6 @@ void enable_builtin_syslog()
     {
         using Sink = sinks::synchronous_sink<sinks::syslog_backend>;
 
-        auto core = logging::core::get();
         boost::shared_ptr<sinks::syslog_backend> backend(
             new sinks::syslog_backend(keywords::facility = sinks::syslog::local0,
                                       keywords::use_impl = sinks::syslog::native));
@@ -221,9 +500,9 @@ void enable_builtin_syslog()
 
         syslog_logger = boost::make_shared<Sink>(backend);
         syslog_logger->set_formatter(formatter);
-        syslog_logger->set_filter(CommonppRecord.or_default(false) == true);
+        syslog_logger->set_filter(detail::log_filter());
 
-        core->add_sink(syslog_logger);
+        detail::add_sink(syslog_logger);
     }
 #else
     ENABLE_CURRENT_FCT_LOGGING();
@@ -236,18 +515,17 @@ void add_file_sink(const std::string& path)
     boost::shared_ptr<sinks::text_file_backend> backend =
         boost::make_shared<sinks::text_file_backend>(keywords::file_name = path);
 
-    auto core = logging::core::get();
     auto sink = boost::make_shared<FileSink>(backend);
 
-    sink->set_filter(CommonppRecord.or_default(false) == true);
-    core->add_sink(sink);
-
+    sink->set_filter(detail::log_filter());
     sink->set_formatter(formatter);
+    detail::add_sink(sink);
 }
 
-void add_file_sink_rotate(const std::string& path,
-                          size_t max_size,
-                          boost::posix_time::hours period)
+static void add_rotating_sink(const std::string& path,
+                              size_t max_size,
+                              boost::posix_time::hours period,
+                              boost::shared_ptr<sinks::file::collector> collector)
 {
     boost::shared_ptr<sinks::text_file_backend> backend;
 
@@ -266,12 +544,32 @@ void add_file_sink_rotate(const std::string& path,
                 sinks::file::rotation_at_time_interval(period));
     }
 
-    auto core = logging::core::get();
+    if (collector)
+    {
+        backend->set_file_collector(std::move(collector));
+    }
+
     auto sink = boost::make_shared<FileSink>(backend);
     sink->set_formatter(formatter);
 
-    sink->set_filter(CommonppRecord.or_default(false) == true);
-    core->add_sink(sink);
+    sink->set_filter(detail::log_filter());
+    detail::add_sink(sink);
+}
+
+void add_file_sink_rotate(const std::string& path,
+                          size_t max_size,
+                          boost::posix_time::hours period)
+{
+    add_rotating_sink(path, max_size, period, nullptr);
+}
+
+void add_file_sink_rotate(const std::string& path,
+                          size_t max_size,
+                          boost::posix_time::hours period,
+                          const RotatedFilesOptions& options)
+{
+    add_rotating_sink(path, max_size, period,
+                      detail::make_rotated_files_collector(path, options));
 }
 
 } // namespace core
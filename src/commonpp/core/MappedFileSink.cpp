@@ -0,0 +1,533 @@
+/*
+ * File: src/commonpp/core/MappedFileSink.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/LoggingInterface.hpp"
+
+#include <stdexcept>
+
+#if !defined(_WIN32)
+
+# include <algorithm>
+# include <atomic>
+# include <cerrno>
+# include <condition_variable>
+# include <cstdio>
+# include <cstring>
+# include <exception>
+# include <fstream>
+# include <memory>
+# include <mutex>
+# include <system_error>
+# include <thread>
+# include <vector>
+
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+# include <boost/filesystem.hpp>
+# include <boost/log/expressions.hpp>
+# include <boost/log/sinks/basic_sink_backend.hpp>
+# include <boost/log/sinks/sync_frontend.hpp>
+# include <boost/smart_ptr/make_shared.hpp>
+
+# include "commonpp/thread/Thread.hpp"
+# include "detail/sinks.hpp"
+
+namespace logging = boost::log;
+namespace sinks = logging::sinks;
+namespace fs = boost::filesystem;
+
+namespace commonpp
+{
+namespace core
+{
+
+namespace
+{
+
+const size_t INDEX_DIGITS = 6;
+const size_t page_size = ::sysconf(_SC_PAGESIZE);
+
+[[noreturn]] void throw_errno(const std::string& what, const std::string& path)
+{
+    throw std::system_error(errno, std::generic_category(), what + " " + path);
+}
+
+std::string segment_path(const std::string& prefix, unsigned index)
+{
+    char suffix[INDEX_DIGITS + 8];
+    std::snprintf(suffix, sizeof(suffix), ".%06u.log", index);
+    return prefix + suffix;
+}
+
+// the index of <prefix>.NNNNNN.log, 0 if the file is not a segment
+unsigned segment_index(const std::string& filename, const std::string& prefix)
+{
+    if (filename.size() != prefix.size() + INDEX_DIGITS + 5 ||
+        filename.compare(0, prefix.size(), prefix) != 0 ||
+        filename[prefix.size()] != '.' ||
+        filename.compare(filename.size() - 4, 4, ".log") != 0)
+    {
+        return 0;
+    }
+
+    unsigned index = 0;
+    for (size_t i = prefix.size() + 1; i < prefix.size() + 1 + INDEX_DIGITS; ++i)
+    {
+        if (filename[i] < '0' || filename[i] > '9')
+        {
+            return 0;
+        }
+        index = index * 10 + (filename[i] - '0');
+    }
+    return index;
+}
+
+// The last bytes of a segment while it is open: the length of its content,
+// updated after every record, then a marker. A closed segment is truncated to
+// its content, which ends with a '\n' unlike the marker.
+struct Trailer
+{
+    uint64_t length;
+    char marker[8];
+};
+
+const char TRAILER_MARKER[8] = {'\0', 'c', 'p', 'p', 'l', 'o', 'g', '\1'};
+
+// A segment left open by a crash is cut to its committed length, the closed
+// ones are left alone. Only the trailer is read.
+void recover_segment(const fs::path& path)
+{
+    auto size = fs::file_size(path);
+    if (size < sizeof(Trailer))
+    {
+        return;
+    }
+
+    Trailer trailer;
+    std::ifstream file(path.string(), std::ios::binary);
+    file.seekg(size - sizeof(Trailer));
+    if (!file.read(reinterpret_cast<char*>(&trailer), sizeof(trailer)) ||
+        std::memcmp(trailer.marker, TRAILER_MARKER, sizeof(TRAILER_MARKER)) != 0)
+    {
+        return;
+    }
+    file.close();
+
+    fs::resize_file(path, std::min<uint64_t>(trailer.length, size - sizeof(Trailer)));
+}
+
+struct Segment
+{
+    Segment(const std::string& path, size_t size)
+    : path(path)
+    , size(size)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            throw_errno("cannot create", path);
+        }
+
+        int error = 0;
+# if defined(__linux__)
+        error = ::posix_fallocate(fd, 0, size);
+        if (error == EOPNOTSUPP || error == EINVAL)
+# endif
+        {
+            error = ::ftruncate(fd, size) == 0 ? 0 : errno;
+        }
+
+        int flags = MAP_SHARED;
+# if defined(MAP_POPULATE)
+        flags |= MAP_POPULATE;
+# endif
+        void* mapping = MAP_FAILED;
+        if (error == 0)
+        {
+            mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+        }
+        if (mapping == MAP_FAILED)
+        {
+            errno = error ? error : errno;
+            ::close(fd);
+            ::unlink(path.c_str());
+            throw_errno("cannot map", path);
+        }
+        data = static_cast<char*>(mapping);
+
+        Trailer trailer{0, {}};
+        std::memcpy(trailer.marker, TRAILER_MARKER, sizeof(TRAILER_MARKER));
+        std::memcpy(data + capacity(), &trailer, sizeof(trailer));
+    }
+
+    ~Segment()
+    {
+        if (data)
+        {
+            ::munmap(data, size);
+        }
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+    }
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    // the room left for the records
+    size_t capacity() const
+    {
+        return size - sizeof(Trailer);
+    }
+
+    // the content up to `end` is complete
+    void commit(size_t end)
+    {
+        uint64_t length = end;
+        std::memcpy(data + capacity(), &length, sizeof(length));
+        used.store(end, std::memory_order_release);
+    }
+
+    // Syncs the pages written since the last call, the content up to `end`
+    // is on disk once it returns.
+    void sync(size_t end, int flags)
+    {
+        auto begin = synced.load(std::memory_order_relaxed);
+        if (end > begin)
+        {
+            auto page = begin & ~(page_size - 1);
+            ::msync(data + page, end - page, flags);
+
+            // the length after the content it covers
+            auto trailer = capacity() & ~(page_size - 1);
+            ::msync(data + trailer, size - trailer, flags);
+            if (flags == MS_SYNC)
+            {
+                synced.store(end, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // the file is left with its content only
+    void close()
+    {
+        auto end = used.load(std::memory_order_acquire);
+        sync(end, MS_SYNC);
+        ::munmap(data, size);
+        data = nullptr;
+        if (::ftruncate(fd, end) != 0)
+        {
+            // keep the trailer, the segment is cut at the next start
+        }
+        ::close(fd);
+        fd = -1;
+    }
+
+    const std::string path;
+    const size_t size;
+    int fd = -1;
+    char* data = nullptr;
+
+    // written by the logging thread only
+    std::atomic<size_t> used{0};
+    std::atomic<size_t> synced{0};
+};
+
+// The logging thread only copies the formatted record in the mapping of the
+// current segment. The background thread creates the next segment ahead of
+// time, syncs the written pages and closes the full segments.
+class MappedFileBackend
+    : public sinks::basic_formatted_sink_backend<char, sinks::synchronized_feeding>
+{
+public:
+    MappedFileBackend(const std::string& prefix, const MappedFileOptions& options)
+    : prefix_(prefix)
+    , options_(options)
+    {
+        if (options_.segment_size < sizeof(Trailer) + 2)
+        {
+            throw std::invalid_argument("mapped segments are too small");
+        }
+
+        next_index_ = recover() + 1;
+        current_ = create_segment();
+        thread_ = std::thread(&MappedFileBackend::run, this);
+    }
+
+    ~MappedFileBackend()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        wake_up_.notify_all();
+        thread_.join();
+
+        current_->close();
+        if (next_)
+        {
+            auto path = next_->path;
+            next_.reset();
+            ::unlink(path.c_str());
+        }
+    }
+
+    void consume(const logging::record_view&, const string_type& message)
+    {
+        if (!append(message.data(), message.size()))
+        {
+            ++dropped_;
+        }
+    }
+
+    void flush()
+    {
+        current_->sync(current_->used.load(std::memory_order_relaxed), MS_SYNC);
+    }
+
+private:
+    // cuts the segments of a previous run, returns the highest index
+    unsigned recover()
+    {
+        fs::path prefix(prefix_);
+        auto directory = prefix.parent_path();
+        if (directory.empty())
+        {
+            directory = ".";
+        }
+
+        unsigned last_index = 0;
+        auto filename = prefix.filename().string();
+        for (fs::directory_iterator it(directory), end; it != end; ++it)
+        {
+            auto index = segment_index(it->path().filename().string(), filename);
+            if (index && fs::is_regular_file(it->status()))
+            {
+                recover_segment(it->path());
+                last_index = std::max(last_index, index);
+            }
+        }
+
+        return last_index;
+    }
+
+    std::unique_ptr<Segment> create_segment()
+    {
+        auto segment = std::make_unique<Segment>(segment_path(prefix_, next_index_),
+                                                 options_.segment_size);
+        ++next_index_;
+        return segment;
+    }
+
+    // Returns false when the record is dropped: the current segment is full
+    // and the next one could not be created.
+    bool append(const char* data, size_t size)
+    {
+        // a record larger than a segment is cut
+        size = std::min(size, current_->capacity() - 1);
+        auto used = current_->used.load(std::memory_order_relaxed);
+        if (used + size + 1 > current_->capacity())
+        {
+            if (!rotate())
+            {
+                return false;
+            }
+            report_dropped();
+            return append(data, size);
+        }
+
+        std::memcpy(current_->data + used, data, size);
+        current_->data[used + size] = '\n';
+        current_->commit(used + size + 1);
+        return true;
+    }
+
+    // The sink cannot log its own errors, the loss is reported at the
+    // beginning of the next segment.
+    void report_dropped()
+    {
+        if (!dropped_)
+        {
+            return;
+        }
+
+        auto note = "commonpp: " + std::to_string(dropped_) +
+                    " records dropped, cannot create a segment: " + last_error_;
+        dropped_ = 0;
+        append(note.data(), note.size());
+    }
+
+    bool rotate()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return next_ || error_; });
+
+        if (!next_)
+        {
+            // the background thread tries again for the next record
+            auto error = std::move(error_);
+            error_ = nullptr;
+            lock.unlock();
+            wake_up_.notify_one();
+
+            try
+            {
+                std::rethrow_exception(error);
+            }
+            catch (const std::exception& e)
+            {
+                last_error_ = e.what();
+            }
+            catch (...)
+            {
+                last_error_ = "unknown error";
+            }
+            return false;
+        }
+
+        retired_.push_back(std::move(current_));
+        current_ = std::move(next_);
+        lock.unlock();
+        wake_up_.notify_one();
+        return true;
+    }
+
+    bool has_work() const
+    {
+        return stopped_ || (!next_ && !error_) || !retired_.empty();
+    }
+
+    void run()
+    {
+        thread::set_current_thread_name("commonpp-mmaplog");
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;)
+        {
+            if (options_.sync_period.count() > 0)
+            {
+                wake_up_.wait_for(lock, options_.sync_period,
+                                  [this] { return has_work(); });
+            }
+            else
+            {
+                wake_up_.wait(lock, [this] { return has_work(); });
+            }
+
+            if (stopped_)
+            {
+                break;
+            }
+
+            if (!next_ && !error_)
+            {
+                lock.unlock();
+                std::unique_ptr<Segment> segment;
+                std::exception_ptr error;
+                try
+                {
+                    segment = create_segment();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                lock.lock();
+                next_ = std::move(segment);
+                error_ = error;
+                ready_.notify_all();
+            }
+
+            auto retired = std::move(retired_);
+            retired_.clear();
+            auto* current = current_.get();
+            lock.unlock();
+
+            for (auto& segment : retired)
+            {
+                segment->close();
+            }
+            retired.clear();
+
+            // the current segment is only closed by this thread or by the
+            // destructor, after this thread has stopped.
+            if (options_.sync_period.count() > 0)
+            {
+                current->sync(current->used.load(std::memory_order_acquire),
+                              MS_SYNC);
+            }
+
+            lock.lock();
+        }
+
+        for (auto& segment : retired_)
+        {
+            segment->close();
+        }
+        retired_.clear();
+    }
+
+private:
+    const std::string prefix_;
+    const MappedFileOptions options_;
+    unsigned next_index_;
+
+    // logging thread, swapped under mutex_
+    std::unique_ptr<Segment> current_;
+    uint64_t dropped_ = 0;
+    std::string last_error_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_up_;
+    std::condition_variable ready_;
+    std::unique_ptr<Segment> next_;
+    std::exception_ptr error_;
+    std::vector<std::unique_ptr<Segment>> retired_;
+    bool stopped_ = false;
+
+    std::thread thread_;
+};
+
+} // namespace
+
+void add_mapped_file_sink(const std::string& prefix, const MappedFileOptions& options)
+{
+    using MappedFileSink = sinks::synchronous_sink<MappedFileBackend>;
+
+    auto sink = boost::make_shared<MappedFileSink>(
+        boost::make_shared<MappedFileBackend>(prefix, options));
+    sink->set_filter(detail::log_filter());
+    sink->set_formatter(detail::log_formatter());
+    detail::add_sink(sink);
+}
+
+} // namespace core
+} // namespace commonpp
+
+#else
+
+namespace commonpp
+{
+namespace core
+{
+
+void add_mapped_file_sink(const std::string&, const MappedFileOptions&)
+{
+    throw std::runtime_error("mapped file sinks are not supported");
+}
+
+} // namespace core
+} // namespace commonpp
+
+#endif
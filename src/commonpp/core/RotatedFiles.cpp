@@ -0,0 +1,510 @@
+/*
+ * File: src/commonpp/core/RotatedFiles.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/LoggingInterface.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <regex>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/version.hpp>
+
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+#include "commonpp/thread/Thread.hpp"
+#include "detail/sinks.hpp"
+
+namespace logging = boost::log;
+namespace sinks = logging::sinks;
+namespace fs = boost::filesystem;
+
+namespace commonpp
+{
+namespace core
+{
+
+namespace
+{
+
+const char GZIP_EXTENSION[] = ".gz";
+const char TEMPORARY_EXTENSION[] = ".tmp";
+
+struct Counters
+{
+    std::atomic<uint64_t> pending{0};
+    std::atomic<uint64_t> compressed{0};
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> bytes_written{0};
+    std::atomic<uint64_t> removed{0};
+    std::atomic<uint64_t> errors{0};
+};
+
+Counters& counters()
+{
+    static Counters counters;
+    return counters;
+}
+
+bool ends_with(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// The file names produced by a text_file_backend pattern: the date/time
+// placeholders and %N (with an optional width) become digit runs.
+std::regex pattern_to_regex(const std::string& pattern)
+{
+    std::string regex;
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        auto c = pattern[i];
+        if (c == '%' && i + 1 < pattern.size())
+        {
+            ++i;
+            while (i + 1 < pattern.size() && std::isdigit(pattern[i]))
+            {
+                ++i;
+            }
+
+            switch (pattern[i])
+            {
+            case '%':
+                regex += '%';
+                break;
+            case 'Y':
+            case 'm':
+            case 'd':
+            case 'H':
+            case 'M':
+            case 'S':
+            case 'N':
+            case 'f':
+                regex += "[0-9]+";
+                break;
+            default:
+                regex += ".*";
+                break;
+            }
+            continue;
+        }
+
+        if (std::strchr(".^$|()[]{}*+?\\", c))
+        {
+            regex += '\\';
+        }
+        regex += c;
+    }
+
+    return std::regex(regex + "(\\.gz)?");
+}
+
+struct ClosedFile
+{
+    fs::path path;
+    std::time_t time;
+};
+
+// Plugged in the text_file_backend, which hands it every file it closes.
+class RotatedFilesCollector : public sinks::file::collector
+{
+public:
+    RotatedFilesCollector(const std::string& pattern, const RotatedFilesOptions& options)
+    : options_(options)
+    {
+        fs::path path(pattern);
+        directory_ = path.parent_path().empty() ? fs::path(".") : path.parent_path();
+        matcher_ = pattern_to_regex(path.filename().string());
+
+#if !HAVE_ZLIB
+        options_.compress = false;
+#endif
+
+        // no file is opened yet: all the files matching are closed
+        scan();
+        thread_ = std::thread(&RotatedFilesCollector::run, this);
+    }
+
+    ~RotatedFilesCollector() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            stopped_ = true;
+        }
+        wake_up_.notify_one();
+        thread_.join();
+
+        // compressed at the next start
+        counters().pending.fetch_sub(to_compress_.size());
+    }
+
+    void store_file(const fs::path& path) override
+    {
+        auto time = closed_time(path);
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            add_closed(path, time);
+        }
+        wake_up_.notify_one();
+    }
+
+    // the interface of the collectors changed with Boost 1.78
+#if BOOST_VERSION >= 107800
+    bool is_in_storage(const fs::path&) const override
+    {
+        return false;
+    }
+
+    sinks::file::scan_result scan_for_files(sinks::file::scan_method,
+                                            const fs::path&) override
+    {
+        return {};
+    }
+#else
+    uintmax_t scan_for_files(sinks::file::scan_method,
+                             const fs::path& = fs::path(),
+                             unsigned int* = nullptr) override
+    {
+        return 0;
+    }
+#endif
+
+private:
+    static std::time_t closed_time(const fs::path& path)
+    {
+        boost::system::error_code error;
+        auto time = fs::last_write_time(path, error);
+        return error ? std::time(nullptr) : time;
+    }
+
+    // with the lock held
+    void add_closed(const fs::path& path, std::time_t time)
+    {
+        files_.push_back({path, time});
+        check_retention_ = true;
+
+        if (options_.compress && path.extension() != GZIP_EXTENSION)
+        {
+            to_compress_.push_back(path);
+            counters().pending.fetch_add(1);
+        }
+    }
+
+    void scan()
+    {
+        boost::system::error_code error;
+        std::vector<ClosedFile> found;
+        for (fs::directory_iterator it(directory_, error), end; !error && it != end;
+             it.increment(error))
+        {
+            auto name = it->path().filename().string();
+            if (ends_with(name, TEMPORARY_EXTENSION))
+            {
+                // an interrupted compression
+                auto original = name.substr(0, name.size() - sizeof(TEMPORARY_EXTENSION) + 1);
+                if (std::regex_match(original, matcher_))
+                {
+                    fs::remove(it->path(), error);
+                }
+                continue;
+            }
+
+            if (std::regex_match(name, matcher_))
+            {
+                found.push_back({it->path(), closed_time(it->path())});
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(lock_);
+        for (const auto& file : found)
+        {
+            add_closed(file.path, file.time);
+        }
+    }
+
+    void run()
+    {
+        thread::set_current_thread_name("commonpp-logzip");
+
+        thread::SchedulingPolicy policy;
+        policy.policy = thread::SchedulingPolicy::Idle;
+        policy.io_class = thread::SchedulingPolicy::IOIdle;
+        thread::set_current_thread_scheduling(policy);
+
+        std::unique_lock<std::mutex> lock(lock_);
+        for (;;)
+        {
+            apply_retention(lock);
+
+            // the age limit is checked every minute when idle
+            wake_up_.wait_for(lock, std::chrono::minutes(1), [this] {
+                return stopped_ || check_retention_ || !to_compress_.empty();
+            });
+            if (stopped_)
+            {
+                return;
+            }
+
+            while (!to_compress_.empty() && !stopped_)
+            {
+                auto path = to_compress_.front();
+                to_compress_.pop_front();
+
+                lock.unlock();
+                auto compressed = compress(path);
+                counters().pending.fetch_sub(1);
+                lock.lock();
+
+                if (!compressed.empty())
+                {
+                    for (auto& file : files_)
+                    {
+                        if (file.path == path)
+                        {
+                            file.path = compressed;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Returns the compressed file, or an empty path on failure or when
+    // stopped. The original is removed once the compressed file is complete.
+    fs::path compress(const fs::path& path)
+    {
+#if HAVE_ZLIB
+        auto target = path.string() + GZIP_EXTENSION;
+        auto temporary = target + TEMPORARY_EXTENSION;
+
+        std::ifstream in(path.string(), std::ios::binary);
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!in || !out)
+        {
+            return failed(path, "cannot open");
+        }
+
+        z_stream stream{};
+        // 16 + MAX_WBITS: gzip header and trailer
+        if (deflateInit2(&stream, options_.compression_level, Z_DEFLATED,
+                         16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            return failed(path, "cannot initialize zlib for");
+        }
+
+        std::vector<char> input(256 * 1024);
+        std::vector<char> output(256 * 1024);
+        int flush = Z_NO_FLUSH;
+        bool ok = true;
+        while (ok && flush != Z_FINISH)
+        {
+            if (stopped())
+            {
+                ok = false;
+                break;
+            }
+
+            in.read(input.data(), input.size());
+            auto read = in.gcount();
+            flush = in.eof() ? Z_FINISH : Z_NO_FLUSH;
+            if (in.bad())
+            {
+                ok = false;
+                break;
+            }
+            counters().bytes_read.fetch_add(read, std::memory_order_relaxed);
+
+            stream.next_in = reinterpret_cast<Bytef*>(input.data());
+            stream.avail_in = read;
+            do
+            {
+                stream.next_out = reinterpret_cast<Bytef*>(output.data());
+                stream.avail_out = output.size();
+                deflate(&stream, flush);
+                auto written = output.size() - stream.avail_out;
+                out.write(output.data(), written);
+                counters().bytes_written.fetch_add(written, std::memory_order_relaxed);
+            } while (stream.avail_out == 0);
+
+            ok = static_cast<bool>(out);
+        }
+        deflateEnd(&stream);
+        in.close();
+        out.close();
+
+        boost::system::error_code error;
+        if (!ok || !out)
+        {
+            fs::remove(temporary, error);
+            return stopped() ? fs::path() : failed(path, "cannot compress");
+        }
+
+        // keep the time of the original for the age limit
+        auto time = fs::last_write_time(path, error);
+        fs::rename(temporary, target, error);
+        if (error)
+        {
+            fs::remove(temporary, error);
+            return failed(path, "cannot rename the compressed");
+        }
+        fs::last_write_time(target, time, error);
+        fs::remove(path, error);
+
+        counters().compressed.fetch_add(1);
+        return target;
+#else
+        return path;
+#endif
+    }
+
+    fs::path failed(const fs::path& path, const char* what)
+    {
+        counters().errors.fetch_add(1);
+        GLOG(error) << what << " the rotated log file " << path.string();
+        return fs::path();
+    }
+
+    bool stopped()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        return stopped_;
+    }
+
+    // Called with the lock held, released while the files are inspected
+    // and removed so that store_file() is never delayed by the filesystem.
+    void apply_retention(std::unique_lock<std::mutex>& lock)
+    {
+        check_retention_ = false;
+        if (!options_.max_total_size && !options_.max_age.count())
+        {
+            return;
+        }
+
+        auto files = files_;
+        std::vector<fs::path> queued(to_compress_.begin(), to_compress_.end());
+        lock.unlock();
+        auto removed = remove_expired(files, queued);
+        lock.lock();
+
+        // the files closed meanwhile are kept
+        files_.erase(std::remove_if(files_.begin(), files_.end(),
+                                    [&removed](const ClosedFile& file) {
+                                        return std::find(removed.begin(), removed.end(),
+                                                         file.path) != removed.end();
+                                    }),
+                     files_.end());
+    }
+
+    // Returns the files removed, the oldest first; the files being
+    // compressed are left alone.
+    std::vector<fs::path> remove_expired(std::vector<ClosedFile>& files,
+                                         const std::vector<fs::path>& queued) const
+    {
+        std::sort(files.begin(), files.end(),
+                  [](const ClosedFile& lhs, const ClosedFile& rhs) {
+                      return lhs.time < rhs.time;
+                  });
+
+        boost::system::error_code error;
+        uintmax_t total_size = 0;
+        std::vector<uintmax_t> sizes;
+        for (const auto& file : files)
+        {
+            auto size = fs::file_size(file.path, error);
+            sizes.push_back(error ? 0 : size);
+            total_size += sizes.back();
+        }
+
+        auto oldest = std::time(nullptr) -
+                      std::chrono::duration_cast<std::chrono::seconds>(options_.max_age)
+                          .count();
+
+        std::vector<fs::path> removed;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            auto too_big = options_.max_total_size && total_size > options_.max_total_size;
+            auto too_old = options_.max_age.count() && files[i].time < oldest;
+            if ((!too_big && !too_old) ||
+                std::find(queued.begin(), queued.end(), files[i].path) != queued.end())
+            {
+                break;
+            }
+
+            fs::remove(files[i].path, error);
+            if (error)
+            {
+                counters().errors.fetch_add(1);
+            }
+            else
+            {
+                counters().removed.fetch_add(1);
+            }
+            total_size -= sizes[i];
+            removed.push_back(files[i].path);
+        }
+        return removed;
+    }
+
+private:
+    RotatedFilesOptions options_;
+    fs::path directory_;
+    std::regex matcher_;
+
+    std::mutex lock_;
+    std::condition_variable wake_up_;
+    std::deque<fs::path> to_compress_;
+    std::vector<ClosedFile> files_;
+    bool check_retention_ = false;
+    bool stopped_ = false;
+
+    std::thread thread_;
+};
+
+} // namespace
+
+namespace detail
+{
+boost::shared_ptr<sinks::file::collector>
+make_rotated_files_collector(const std::string& pattern,
+                             const RotatedFilesOptions& options)
+{
+    return boost::make_shared<RotatedFilesCollector>(pattern, options);
+}
+} // namespace detail
+
+RotatedFilesStats rotated_files_stats()
+{
+    auto& c = counters();
+    RotatedFilesStats stats;
+    stats.pending = c.pending.load();
+    stats.compressed = c.compressed.load();
+    stats.bytes_read = c.bytes_read.load();
+    stats.bytes_written = c.bytes_written.load();
+    stats.removed = c.removed.load();
+    stats.errors = c.errors.load();
+    return stats;
+}
+
+} // namespace core
+} // namespace commonpp
@@ -0,0 +1,277 @@
+/*
+ * File: src/commonpp/core/StructuredLogging.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/StructuredLogging.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iterator>
+#include <ostream>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/log/utility/formatting_ostream.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+
+#include "commonpp/core/string/date.hpp"
+#include "commonpp/core/string/json_escape.hpp"
+#include "detail/sinks.hpp"
+
+namespace logging = boost::log;
+namespace sinks = logging::sinks;
+namespace keywords = logging::keywords;
+namespace expr = logging::expressions;
+
+namespace commonpp
+{
+namespace core
+{
+
+namespace
+{
+
+struct TextValue
+{
+    std::ostream& os;
+
+    void operator()(bool value) const
+    {
+        os << (value ? "true" : "false");
+    }
+
+    template <typename Number>
+    void operator()(Number value) const
+    {
+        os << value;
+    }
+
+    void operator()(const std::string& value) const
+    {
+        os << value;
+    }
+};
+
+void write_string(logging::formatting_ostream& strm, const std::string& str)
+{
+    auto escaped = string::escape_json_string(str);
+    strm << '"';
+    strm.write(escaped.data(), escaped.size());
+    strm << '"';
+}
+
+struct JsonValue
+{
+    logging::formatting_ostream& strm;
+
+    void operator()(bool value) const
+    {
+        strm << (value ? "true" : "false");
+    }
+
+    template <typename Number>
+    void operator()(Number value) const
+    {
+        if constexpr (std::is_floating_point_v<Number>)
+        {
+            if (!std::isfinite(value))
+            {
+                strm << "null";
+                return;
+            }
+        }
+
+        char buffer[32];
+        auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+        strm.write(buffer, end - buffer);
+    }
+
+    void operator()(const std::string& value) const
+    {
+        write_string(strm, value);
+    }
+};
+
+class JsonObject
+{
+public:
+    explicit JsonObject(logging::formatting_ostream& strm)
+    : strm_(strm)
+    {
+        strm_ << '{';
+    }
+
+    ~JsonObject()
+    {
+        strm_ << '}';
+    }
+
+    logging::formatting_ostream& key(const std::string& name)
+    {
+        if (!first_)
+        {
+            strm_ << ',';
+        }
+        first_ = false;
+
+        write_string(strm_, name);
+        return strm_ << ':';
+    }
+
+private:
+    logging::formatting_ostream& strm_;
+    bool first_ = true;
+};
+
+// the members written by format_json() before the fields
+bool is_fixed_member(const std::string& name)
+{
+    static const char* const members[] = {"timestamp", "severity", "channel",
+                                          "thread", "message"};
+    return std::find(std::begin(members), std::end(members), name) !=
+           std::end(members);
+}
+
+// whether both are written under the same member, "_message" and "message"
+// are
+bool same_member(const LogField& a, const LogField& b)
+{
+    auto a_fixed = is_fixed_member(a.name);
+    if (a_fixed == is_fixed_member(b.name))
+    {
+        return a.name == b.name;
+    }
+
+    const auto& fixed = a_fixed ? a.name : b.name;
+    const auto& other = a_fixed ? b.name : a.name;
+    return other.size() == fixed.size() + 1 && other[0] == '_' &&
+           other.compare(1, fixed.size(), fixed) == 0;
+}
+
+void format_json(const logging::record_view& rec, logging::formatting_ostream& strm)
+{
+    const auto& values = rec.attribute_values();
+    JsonObject object(strm);
+
+    auto timestamp = values["TimeStamp"].extract<boost::posix_time::ptime>();
+    if (timestamp)
+    {
+        auto format = detail::log_timestamp_format();
+        char buffer[string::MAX_TIMESTAMP_SIZE];
+        auto size = string::format_timestamp(*timestamp, format, buffer);
+
+        auto& out = object.key("timestamp");
+        if (format == string::TimestampFormat::EpochMicros)
+        {
+            out.write(buffer, size);
+        }
+        else
+        {
+            out << '"';
+            out.write(buffer, size);
+            out << '"';
+        }
+    }
+
+    auto severity = values[Severity];
+    if (severity)
+    {
+        object.key("severity") << '"' << to_string(*severity) << '"';
+    }
+
+    auto channel = values[Channel];
+    if (channel)
+    {
+        write_string(object.key("channel"), *channel);
+    }
+
+    auto thread_name = values[ThreadName];
+    if (thread_name)
+    {
+        write_string(object.key("thread"), thread_name->str());
+    }
+
+    auto message = values[expr::smessage];
+    write_string(object.key("message"), message ? *message : std::string());
+
+    auto fields = values[detail::fields_attribute_name()].extract<LogFields>();
+    if (fields)
+    {
+        for (auto it = fields->begin(); it != fields->end(); ++it)
+        {
+            const auto& field = *it;
+            // the last value of a member given twice wins
+            if (std::any_of(std::next(it), fields->end(), [&field](const LogField& next)
+                            { return same_member(field, next); }))
+            {
+                continue;
+            }
+
+            auto& out = is_fixed_member(field.name) ? object.key('_' + field.name)
+                                                    : object.key(field.name);
+            std::visit(JsonValue{out}, field.value);
+        }
+    }
+}
+
+template <typename Sink>
+void add_json(boost::shared_ptr<Sink> sink)
+{
+    sink->set_filter(detail::log_filter());
+    sink->set_formatter(&format_json);
+    detail::add_sink(sink);
+}
+
+} // namespace
+
+std::ostream& operator<<(std::ostream& os, const LogField& field)
+{
+    os << field.name << '=';
+    std::visit(TextValue{os}, field.value);
+    return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const LogFields& fields)
+{
+    for (const auto& field : fields)
+    {
+        os << ' ' << field;
+    }
+    return os;
+}
+
+namespace detail
+{
+const boost::log::attribute_name& fields_attribute_name()
+{
+    static const boost::log::attribute_name name("Fields");
+    return name;
+}
+} // namespace detail
+
+void add_json_sink(boost::shared_ptr<std::ostream> stream)
+{
+    auto sink = boost::make_shared<sinks::synchronous_sink<sinks::text_ostream_backend>>();
+    sink->locked_backend()->add_stream(std::move(stream));
+    add_json(sink);
+}
+
+void add_json_file_sink(const std::string& path)
+{
+    auto backend =
+        boost::make_shared<sinks::text_file_backend>(keywords::file_name = path);
+    add_json(boost::make_shared<sinks::synchronous_sink<sinks::text_file_backend>>(backend));
+}
+
+} // namespace core
+} // namespace commonpp
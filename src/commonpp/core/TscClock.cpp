@@ -0,0 +1,211 @@
+/*
+ * File: src/commonpp/core/TscClock.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/core/TscClock.hpp"
+
+// clang-format off
+#if COMMONPP_HAVE_TSC
+# include <cpuid.h>
+#endif
+
+#ifdef __linux__
+# include <pthread.h>
+# include <sched.h>
+#endif
+// clang-format on
+
+#include <cstdlib>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "commonpp/core/LoggingInterface.hpp"
+
+namespace commonpp
+{
+
+TscClock::State TscClock::state_;
+
+bool TscClock::uses_tsc() noexcept
+{
+    return state_.use_tsc.load(std::memory_order_acquire);
+}
+
+double TscClock::ticks_per_second() noexcept
+{
+    return uses_tsc() ? state_.ticks_per_second : 0;
+}
+
+#if COMMONPP_HAVE_TSC
+static int64_t steady_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+struct ClockPair
+{
+    uint64_t ticks;
+    int64_t ns;
+};
+
+// Read the TSC on both sides of the steady clock, keep the tightest bracket
+// to limit the noise of an interruption.
+static ClockPair sample_clocks()
+{
+    ClockPair best{0, 0};
+    uint64_t best_width = std::numeric_limits<uint64_t>::max();
+
+    for (int i = 0; i < 16; ++i)
+    {
+        unsigned aux;
+        auto before = __rdtscp(&aux);
+        auto ns = steady_ns();
+        auto after = __rdtscp(&aux);
+
+        if (after - before < best_width)
+        {
+            best_width = after - before;
+            best = ClockPair{before + (after - before) / 2, ns};
+        }
+    }
+
+    return best;
+}
+
+static bool has_invariant_tsc()
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+    {
+        return false;
+    }
+
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return edx & (1u << 8);
+}
+
+// Maximum difference tolerated between the TSC converted to ns and the
+// steady clock on any core.
+static constexpr int64_t MAX_SKEW_NS = 50000;
+
+static int64_t tsc_to_ns(const ClockPair& base, uint64_t mult, uint64_t ticks)
+{
+    auto delta = static_cast<int64_t>(ticks - base.ticks);
+    return base.ns + static_cast<int64_t>(static_cast<__int128>(delta) * mult >> 32);
+}
+
+static bool check_cores(const ClockPair& base, uint64_t mult)
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed))
+    {
+        return true;
+    }
+
+    bool synchronized = true;
+    for (int cpu = 0; cpu < CPU_SETSIZE && synchronized; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+        {
+            continue;
+        }
+
+        std::thread checker(
+            [&, cpu]
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+                {
+                    return;
+                }
+
+                auto sample = sample_clocks();
+                auto skew = tsc_to_ns(base, mult, sample.ticks) - sample.ns;
+                if (std::abs(skew) > MAX_SKEW_NS)
+                {
+                    GLOG(warning) << "The TSC of cpu " << cpu << " is " << skew
+                                  << "ns off, falling back to steady_clock";
+                    synchronized = false;
+                }
+            });
+        checker.join();
+    }
+
+    return synchronized;
+#else
+    return true;
+#endif
+}
+
+static void calibrate(std::atomic_bool& use_tsc, uint64_t& base_ticks,
+                      int64_t& base_ns, uint64_t& mult, double& ticks_per_second)
+{
+    if (!has_invariant_tsc())
+    {
+        GLOG(info) << "The TSC is not invariant, TscClock uses steady_clock";
+        return;
+    }
+
+    auto start = sample_clocks();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto end = sample_clocks();
+
+    if (end.ticks <= start.ticks || end.ns <= start.ns)
+    {
+        return;
+    }
+
+    auto ticks = static_cast<double>(end.ticks - start.ticks);
+    auto ns = static_cast<double>(end.ns - start.ns);
+    auto computed_mult = static_cast<uint64_t>(ns / ticks * 4294967296.0);
+
+    if (!check_cores(end, computed_mult))
+    {
+        return;
+    }
+
+    base_ticks = end.ticks;
+    base_ns = end.ns;
+    mult = computed_mult;
+    ticks_per_second = ticks / ns * 1e9;
+    use_tsc.store(true, std::memory_order_release);
+}
+#endif
+
+void TscClock::init()
+{
+    static std::once_flag flag;
+    std::call_once(flag,
+                   []
+                   {
+#if COMMONPP_HAVE_TSC
+                       try
+                       {
+                           calibrate(state_.use_tsc, state_.base_ticks,
+                                     state_.base_ns, state_.mult,
+                                     state_.ticks_per_second);
+                       }
+                       catch (const std::exception& e)
+                       {
+                           GLOG(warning) << "Cannot calibrate the TSC (" << e.what()
+                                         << "), TscClock uses steady_clock";
+                       }
+#endif
+                   });
+}
+
+} // namespace commonpp
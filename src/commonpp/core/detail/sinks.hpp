@@ -0,0 +1,51 @@
+/*
+ * File: src/commonpp/core/detail/sinks.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <boost/log/attributes/attribute_value_set.hpp>
+#include <boost/log/expressions/filter.hpp>
+#include <boost/log/expressions/formatter.hpp>
+#include <boost/log/sinks/sink.hpp>
+#include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+
+#include "commonpp/core/LoggingInterface.hpp"
+#include "commonpp/core/string/date.hpp"
+
+namespace commonpp
+{
+namespace core
+{
+namespace detail
+{
+
+// Every commonpp sink is added through here: it is registered to the
+// logging core, or to the asynchronous dispatcher when enabled. See
+// remove_sink() and remove_all_sinks().
+void add_sink(boost::shared_ptr<boost::log::sinks::sink> sink);
+
+// the format set by set_log_timestamp_format()
+string::TimestampFormat log_timestamp_format();
+
+// the commonpp records, the filter of the commonpp sinks
+const boost::log::filter& log_filter();
+
+// compresses and removes the files closed by a rotating file sink
+boost::shared_ptr<boost::log::sinks::file::collector>
+make_rotated_files_collector(const std::string& pattern,
+                             const RotatedFilesOptions& options);
+
+// the text format of the console and file sinks
+const boost::log::formatter& log_formatter();
+
+} // namespace detail
+} // namespace core
+} // namespace commonpp
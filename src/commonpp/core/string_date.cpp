@@ -10,9 +10,17 @@
  */
 #include "commonpp/core/string/date.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <sstream>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 namespace commonpp
 {
 namespace string
@@ -56,5 +64,105 @@ std::string get_date(std::chrono::system_clock::time_point time_point)
     return std::string(buff, size) + "." + std::to_string(milliseconds.count());
 }
 
+namespace
+{
+struct TimestampCache
+{
+    int64_t second = INT64_MIN;
+    TimestampFormat format = TimestampFormat::Default;
+    // local time - UTC at that second
+    int64_t utc_offset = 0;
+    char prefix[MAX_TIMESTAMP_SIZE];
+    size_t size = 0;
+};
+
+thread_local TimestampCache timestamp_cache;
+
+int64_t utc_offset(int64_t local_second)
+{
+    auto local = static_cast<time_t>(local_second);
+    std::tm tm;
+#ifdef WIN32
+    _gmtime64_s(&tm, &local);
+#else
+    ::gmtime_r(&local, &tm);
+#endif
+    tm.tm_isdst = -1;
+    return local_second - static_cast<int64_t>(std::mktime(&tm));
+}
+
+void fill_prefix(TimestampCache& cache,
+                 const boost::posix_time::ptime& timestamp,
+                 TimestampFormat format)
+{
+    auto date = timestamp.date();
+    auto time = timestamp.time_of_day();
+    auto size = std::snprintf(cache.prefix, sizeof(cache.prefix),
+                              "%04d-%02d-%02d%c%02d:%02d:%02d.",
+                              static_cast<int>(date.year()),
+                              static_cast<int>(date.month()),
+                              static_cast<int>(date.day()),
+                              format == TimestampFormat::Iso8601 ? 'T' : ' ',
+                              static_cast<int>(time.hours()),
+                              static_cast<int>(time.minutes()),
+                              static_cast<int>(time.seconds()));
+    cache.size = static_cast<size_t>(size);
+}
+} // namespace
+
+size_t format_timestamp(const boost::posix_time::ptime& timestamp,
+                        TimestampFormat format,
+                        char (&out)[MAX_TIMESTAMP_SIZE])
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+
+    if (BOOST_UNLIKELY(timestamp.is_special()))
+    {
+        auto str = boost::posix_time::to_simple_string(timestamp);
+        auto size = std::min(str.size(), sizeof(out));
+        std::memcpy(out, str.data(), size);
+        return size;
+    }
+
+    auto micros = (timestamp - epoch).total_microseconds();
+    auto second = micros / 1000000;
+    auto fraction = micros % 1000000;
+    if (fraction < 0)
+    {
+        --second;
+        fraction += 1000000;
+    }
+
+    auto& cache = timestamp_cache;
+    if (second != cache.second || format != cache.format)
+    {
+        cache.second = second;
+        cache.format = format;
+        if (format == TimestampFormat::EpochMicros)
+        {
+            cache.utc_offset = utc_offset(second);
+        }
+        else
+        {
+            fill_prefix(cache, timestamp, format);
+        }
+    }
+
+    if (format == TimestampFormat::EpochMicros)
+    {
+        auto utc = micros - cache.utc_offset * 1000000;
+        return std::to_chars(out, out + sizeof(out), utc).ptr - out;
+    }
+
+    std::memcpy(out, cache.prefix, cache.size);
+    auto end = out + cache.size + 6;
+    for (auto p = end; p != out + cache.size;)
+    {
+        *--p = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+    }
+    return static_cast<size_t>(end - out);
+}
+
 } // namespace string
 } // namespace commonpp
@@ -0,0 +1,252 @@
+/*
+ * File: src/commonpp/thread/EpochDomain.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/thread/EpochDomain.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Hands what a thread retired over to the orphans when it exits. The
+// records are never freed while their domain lives.
+struct EpochDomain::ThreadExit
+{
+    ~ThreadExit()
+    {
+        for (auto& entry : entries)
+        {
+            if (auto domain = entry.first.lock())
+            {
+                (*domain)->orphan(*entry.second);
+            }
+        }
+    }
+
+    std::vector<std::pair<std::weak_ptr<EpochDomain*>, Record*>> entries;
+};
+
+EpochDomain::~EpochDomain()
+{
+    self_.reset();
+
+    records_.for_each(
+        [](const Record& record)
+        {
+            for (auto& retired : record.limbo)
+            {
+                retired.second();
+            }
+        });
+
+    for (auto& retired : orphans_)
+    {
+        retired.second();
+    }
+}
+
+EpochDomain& EpochDomain::global()
+{
+    static EpochDomain domain;
+    return domain;
+}
+
+void EpochDomain::register_thread() noexcept
+{
+    enter();
+}
+
+void EpochDomain::unregister_thread() noexcept
+{
+    leave();
+    orphan(records_.local());
+}
+
+void EpochDomain::quiescent() noexcept
+{
+    auto& record = records_.local();
+    if (record.nesting == 1)
+    {
+        pin(record);
+        if (record.limbo.size() >= COLLECT_THRESHOLD)
+        {
+            collect(record);
+        }
+    }
+}
+
+bool EpochDomain::try_advance() noexcept
+{
+    auto epoch = epoch_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool lagging = false;
+    records_.for_each(
+        [epoch, &lagging](const Record& record)
+        {
+            auto state = record.state.load(std::memory_order_relaxed);
+            if ((state & 1) && (state >> 1) != epoch)
+            {
+                lagging = true;
+            }
+        });
+
+    if (lagging)
+    {
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_release,
+                                   std::memory_order_relaxed);
+    return true;
+}
+
+void EpochDomain::retire(std::function<void()> deleter)
+{
+    auto& record = records_.local();
+    if (!record.exit_hook)
+    {
+        add_exit_hook(record);
+    }
+
+    record.limbo.emplace_back(epoch_.load(std::memory_order_seq_cst),
+                              std::move(deleter));
+
+    if (record.limbo.size() >= COLLECT_THRESHOLD)
+    {
+        collect(record);
+    }
+}
+
+void EpochDomain::add_exit_hook(Record& record)
+{
+    // constructed after the thread index used by records_, destroyed before
+    // it is released
+    static thread_local ThreadExit thread_exit;
+
+    auto& entries = thread_exit.entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const auto& entry)
+                                 { return entry.first.expired(); }),
+                  entries.end());
+    entries.emplace_back(self_, &record);
+    record.exit_hook = true;
+}
+
+void EpochDomain::orphan(Record& record) noexcept
+{
+    // the next thread with this index registers its own hook
+    record.exit_hook = false;
+    if (record.limbo.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(orphans_lock_);
+        orphans_.insert(orphans_.end(), std::make_move_iterator(record.limbo.begin()),
+                        std::make_move_iterator(record.limbo.end()));
+        has_orphans_.store(true, std::memory_order_relaxed);
+    }
+    catch (...)
+    {
+        // left in the record, destroyed with the domain
+        return;
+    }
+    record.limbo.clear();
+}
+
+size_t EpochDomain::collect_orphans(uint64_t epoch)
+{
+    if (!has_orphans_.load(std::memory_order_relaxed))
+    {
+        return 0;
+    }
+
+    std::vector<std::function<void()>> deleters;
+    {
+        std::lock_guard<std::mutex> lock(orphans_lock_);
+        auto kept = orphans_.begin();
+        for (auto& retired : orphans_)
+        {
+            if (retired.first + 2 <= epoch)
+            {
+                deleters.push_back(std::move(retired.second));
+            }
+            else
+            {
+                *kept++ = std::move(retired);
+            }
+        }
+        orphans_.erase(kept, orphans_.end());
+        has_orphans_.store(!orphans_.empty(), std::memory_order_relaxed);
+    }
+
+    for (auto& deleter : deleters)
+    {
+        deleter();
+    }
+
+    return deleters.size();
+}
+
+size_t EpochDomain::collect()
+{
+    return collect(records_.local());
+}
+
+size_t EpochDomain::collect(Record& record)
+{
+    try_advance();
+    auto epoch = epoch_.load(std::memory_order_acquire);
+
+    // the deleters may retire other objects, don't run them while walking
+    // the limbo list
+    std::vector<std::function<void()>> deleters;
+    auto it = record.limbo.begin();
+    for (; it != record.limbo.end() && it->first + 2 <= epoch; ++it)
+    {
+        deleters.push_back(std::move(it->second));
+    }
+    record.limbo.erase(record.limbo.begin(), it);
+
+    for (auto& deleter : deleters)
+    {
+        deleter();
+    }
+
+    return deleters.size() + collect_orphans(epoch);
+}
+
+void EpochDomain::synchronize()
+{
+    auto& record = records_.local();
+    while (!record.limbo.empty() || has_orphans_.load(std::memory_order_relaxed))
+    {
+        if (record.nesting == 1)
+        {
+            pin(record);
+        }
+
+        if (collect(record) == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,142 @@
+/*
+ * File: src/commonpp/thread/Fiber.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/thread/Fiber.hpp"
+
+#include "commonpp/core/LoggingInterface.hpp"
+#include "detail/logger.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+FiberStackPool::FiberStackPool(std::size_t stack_size, std::size_t max_cached)
+: allocator_(stack_size)
+, stack_size_(stack_size)
+, max_cached_(max_cached)
+{
+}
+
+FiberStackPool::~FiberStackPool()
+{
+    for (auto& sctx : free_)
+    {
+        allocator_.deallocate(sctx);
+    }
+}
+
+boost::context::stack_context FiberStackPool::allocate()
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!free_.empty())
+        {
+            auto sctx = free_.back();
+            free_.pop_back();
+            return sctx;
+        }
+    }
+
+    return allocator_.allocate();
+}
+
+void FiberStackPool::deallocate(boost::context::stack_context& sctx) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (free_.size() < max_cached_)
+        {
+            free_.push_back(sctx);
+            return;
+        }
+    }
+
+    allocator_.deallocate(sctx);
+}
+
+std::size_t FiberStackPool::stack_size() const noexcept
+{
+    return stack_size_;
+}
+
+std::size_t FiberStackPool::cached() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return free_.size();
+}
+
+const std::shared_ptr<FiberStackPool>& FiberStackPool::default_pool()
+{
+    static const auto pool = std::make_shared<FiberStackPool>();
+    return pool;
+}
+
+namespace detail
+{
+
+Fiber::Fiber(executor ex)
+: executor_(std::move(ex))
+{
+}
+
+Fiber::~Fiber()
+{
+    if (self_)
+    {
+        LOG(thread_logger, debug)
+            << "Destroying a suspended fiber, its stack will be unwound";
+        // unwind the stack while the other members are still alive
+        self_ = boost::context::fiber();
+    }
+}
+
+void Fiber::suspend(std::function<void()> after_suspend)
+{
+    after_suspend_ = std::move(after_suspend);
+    caller_ = std::move(caller_).resume();
+}
+
+void Fiber::resume()
+{
+    auto self = shared_from_this();
+    self_ = std::move(self_).resume();
+
+    if (after_suspend_)
+    {
+        auto fn = std::move(after_suspend_);
+        after_suspend_ = nullptr;
+        // From here the fiber may already be resumed by another thread, this
+        // must be the last time we touch this object.
+        fn();
+        return;
+    }
+
+    if (!self_ && exception_)
+    {
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+    }
+}
+
+} // namespace detail
+
+void Yield::yield() const
+{
+    auto& fiber = *fiber_;
+    fiber.suspend(
+        [&fiber]
+        {
+            boost::asio::post(fiber.get_executor(),
+                              [f = fiber.shared_from_this()] { f->resume(); });
+        });
+}
+
+} // namespace thread
+} // namespace commonpp
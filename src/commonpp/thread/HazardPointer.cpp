@@ -0,0 +1,208 @@
+/*
+ * File: src/commonpp/thread/HazardPointer.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/thread/HazardPointer.hpp"
+
+#include <algorithm>
+
+namespace commonpp
+{
+namespace thread
+{
+
+// Hands what a thread retired over to the orphans when it exits. The
+// records are never freed while their domain lives.
+struct HazardPointerDomain::ThreadExit
+{
+    ~ThreadExit()
+    {
+        for (auto& entry : entries)
+        {
+            if (auto domain = entry.first.lock())
+            {
+                (*domain)->orphan(*entry.second);
+            }
+        }
+    }
+
+    std::vector<std::pair<std::weak_ptr<HazardPointerDomain*>, Record*>> entries;
+};
+
+HazardPointerDomain::~HazardPointerDomain()
+{
+    self_.reset();
+
+    auto destroy = [](const std::vector<Retired>& retired)
+    {
+        for (const auto& object : retired)
+        {
+            object.deleter(object.ptr);
+        }
+    };
+    records_.for_each([&destroy](const Record& record) { destroy(record.retired); });
+    destroy(orphans_);
+
+    auto slot = slots_.load(std::memory_order_relaxed);
+    while (slot)
+    {
+        delete std::exchange(slot, slot->next);
+    }
+}
+
+HazardPointerDomain& HazardPointerDomain::global()
+{
+    static HazardPointerDomain domain;
+    return domain;
+}
+
+HazardPointerDomain::Slot* HazardPointerDomain::acquire_slot()
+{
+    for (auto slot = slots_.load(std::memory_order_acquire); slot; slot = slot->next)
+    {
+        if (!slot->used.load(std::memory_order_relaxed) &&
+            !slot->used.exchange(true, std::memory_order_acquire))
+        {
+            return slot;
+        }
+    }
+
+    auto slot = new Slot;
+    slot->used.store(true, std::memory_order_relaxed);
+    slot->next = slots_.load(std::memory_order_relaxed);
+    while (!slots_.compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                         std::memory_order_relaxed))
+    {
+    }
+    nb_slots_.fetch_add(1, std::memory_order_relaxed);
+
+    return slot;
+}
+
+void HazardPointerDomain::release_slot(Slot* slot) noexcept
+{
+    slot->used.store(false, std::memory_order_release);
+}
+
+void HazardPointerDomain::retire(void* ptr, Deleter deleter)
+{
+    auto& record = records_.local();
+    if (!record.exit_hook)
+    {
+        add_exit_hook(record);
+    }
+
+    record.retired.push_back(Retired{ptr, deleter});
+
+    if (record.retired.size() >=
+        std::max(SCAN_THRESHOLD, 2 * nb_slots_.load(std::memory_order_relaxed)))
+    {
+        reclaim();
+    }
+}
+
+void HazardPointerDomain::add_exit_hook(Record& record)
+{
+    // constructed after the thread index used by records_, destroyed before
+    // it is released
+    static thread_local ThreadExit thread_exit;
+
+    auto& entries = thread_exit.entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const auto& entry)
+                                 { return entry.first.expired(); }),
+                  entries.end());
+    entries.emplace_back(self_, &record);
+    record.exit_hook = true;
+}
+
+void HazardPointerDomain::orphan(Record& record) noexcept
+{
+    // the next thread with this index registers its own hook
+    record.exit_hook = false;
+    if (record.retired.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(orphans_lock_);
+        orphans_.insert(orphans_.end(), record.retired.begin(), record.retired.end());
+        has_orphans_.store(true, std::memory_order_relaxed);
+    }
+    catch (...)
+    {
+        // left in the record, destroyed with the domain
+        return;
+    }
+    record.retired.clear();
+}
+
+std::vector<const void*> HazardPointerDomain::hazards() const
+{
+    // pairs with the fence of HazardPointer::protect(): either the reader
+    // sees the object unlinked, or we see its hazard pointer
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    std::vector<const void*> hazards;
+    for (auto slot = slots_.load(std::memory_order_acquire); slot; slot = slot->next)
+    {
+        auto ptr = slot->pointer.load(std::memory_order_acquire);
+        if (ptr)
+        {
+            hazards.push_back(ptr);
+        }
+    }
+    std::sort(hazards.begin(), hazards.end());
+    return hazards;
+}
+
+std::vector<HazardPointerDomain::Retired>
+HazardPointerDomain::take_unprotected(const std::vector<const void*>& hazards,
+                                      std::vector<Retired>& retired)
+{
+    auto protected_end = std::partition(
+        retired.begin(), retired.end(), [&hazards](const Retired& object)
+        { return std::binary_search(hazards.begin(), hazards.end(), object.ptr); });
+    std::vector<Retired> unprotected(protected_end, retired.end());
+    retired.erase(protected_end, retired.end());
+    return unprotected;
+}
+
+size_t HazardPointerDomain::reclaim()
+{
+    auto& retired = records_.local().retired;
+    if (retired.empty() && !has_orphans_.load(std::memory_order_relaxed))
+    {
+        return 0;
+    }
+
+    // the deleters may retire other objects
+    auto protected_by = hazards();
+    auto reclaimable = take_unprotected(protected_by, retired);
+
+    if (has_orphans_.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(orphans_lock_);
+        auto orphans = take_unprotected(protected_by, orphans_);
+        reclaimable.insert(reclaimable.end(), orphans.begin(), orphans.end());
+        has_orphans_.store(!orphans_.empty(), std::memory_order_relaxed);
+    }
+
+    for (const auto& object : reclaimable)
+    {
+        object.deleter(object.ptr);
+    }
+
+    return reclaimable.size();
+}
+
+} // namespace thread
+} // namespace commonpp
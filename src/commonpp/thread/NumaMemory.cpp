@@ -0,0 +1,182 @@
+/*
+ * File: src/commonpp/thread/NumaMemory.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/thread/NumaMemory.hpp"
+
+#include "commonpp/core/config.hpp"
+
+// clang-format off
+#if HAVE_HWLOC == 1
+# include <hwloc.h>
+# include <cerrno>
+#endif
+
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+// clang-format on
+
+#include <stdexcept>
+
+#include "commonpp/core/LoggingInterface.hpp"
+#include "commonpp/thread/Topology.hpp"
+#include "detail/logger.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+static std::size_t page_size()
+{
+#ifndef _WIN32
+    static const std::size_t size = ::sysconf(_SC_PAGESIZE);
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+#if HAVE_HWLOC == 1
+static hwloc_topology_t get_topology()
+{
+    return static_cast<hwloc_topology_t>(Topology::instance().native_handle());
+}
+
+static void* alloc_membind(std::size_t size,
+                           hwloc_const_nodeset_t nodeset,
+                           hwloc_membind_policy_t policy)
+{
+    auto topology = get_topology();
+#if HWLOC_API_VERSION >= 0x00020000
+    auto ptr = hwloc_alloc_membind(topology, size, nodeset, policy,
+                                   HWLOC_MEMBIND_BYNODESET);
+#else
+    auto ptr = hwloc_alloc_membind_nodeset(topology, size, nodeset, policy, 0);
+#endif
+
+    if (!ptr && (errno == ENOSYS || errno == EXDEV))
+    {
+        LOG(thread_logger, debug)
+            << "Memory binding is not supported, allocating unbound memory";
+        ptr = hwloc_alloc(topology, size);
+    }
+
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void* allocate_on_node(std::size_t size, unsigned node)
+{
+    auto obj = hwloc_get_obj_by_type(get_topology(), HWLOC_OBJ_NUMANODE, node);
+    if (!obj)
+    {
+        throw std::out_of_range("No such NUMA node: " + std::to_string(node));
+    }
+
+    return alloc_membind(size, obj->nodeset, HWLOC_MEMBIND_BIND);
+}
+
+void* allocate_interleaved(std::size_t size)
+{
+    return alloc_membind(size, hwloc_topology_get_topology_nodeset(get_topology()),
+                         HWLOC_MEMBIND_INTERLEAVE);
+}
+
+void* allocate_local(std::size_t size)
+{
+    auto ptr = alloc_membind(size, hwloc_topology_get_topology_nodeset(get_topology()),
+                             HWLOC_MEMBIND_FIRSTTOUCH);
+
+    auto bytes = static_cast<volatile char*>(ptr);
+    const auto page = page_size();
+    for (std::size_t i = 0; i < size; i += page)
+    {
+        bytes[i] = 0;
+    }
+
+    return ptr;
+}
+
+void deallocate_numa(void* ptr, std::size_t size) noexcept
+{
+    if (ptr)
+    {
+        hwloc_free(get_topology(), ptr, size);
+    }
+}
+#else
+void* allocate_on_node(std::size_t size, unsigned node)
+{
+    if (node >= Topology::instance().numa_nodes().size())
+    {
+        throw std::out_of_range("No such NUMA node: " + std::to_string(node));
+    }
+
+    return ::operator new(size, std::align_val_t(page_size()));
+}
+
+void* allocate_interleaved(std::size_t size)
+{
+    return ::operator new(size, std::align_val_t(page_size()));
+}
+
+void* allocate_local(std::size_t size)
+{
+    return ::operator new(size, std::align_val_t(page_size()));
+}
+
+void deallocate_numa(void* ptr, std::size_t) noexcept
+{
+    ::operator delete(ptr, std::align_val_t(page_size()));
+}
+#endif
+
+void* allocate_numa(std::size_t size, NumaPolicy policy, unsigned node)
+{
+    switch (policy)
+    {
+    case NumaPolicy::OnNode:
+        return allocate_on_node(size, node);
+    case NumaPolicy::Interleaved:
+        return allocate_interleaved(size);
+    case NumaPolicy::Local:
+    default:
+        return allocate_local(size);
+    }
+}
+
+void* NumaMemoryResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    if (alignment > page_size())
+    {
+        throw std::bad_alloc();
+    }
+
+    return allocate_numa(bytes, policy_, node_);
+}
+
+void NumaMemoryResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t)
+{
+    deallocate_numa(ptr, bytes);
+}
+
+bool NumaMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    auto resource = dynamic_cast<const NumaMemoryResource*>(&other);
+    return resource && resource->policy_ == policy_ && resource->node_ == node_;
+}
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,128 @@
+/*
+ * File: src/commonpp/thread/Qsbr.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/thread/Qsbr.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace commonpp
+{
+namespace thread
+{
+
+Qsbr::~Qsbr()
+{
+    for (auto& retired : retired_)
+    {
+        retired.second();
+    }
+}
+
+Qsbr& Qsbr::global()
+{
+    static Qsbr domain;
+    return domain;
+}
+
+void Qsbr::register_thread() noexcept
+{
+    slots_.local().store(epoch_.load(std::memory_order_acquire),
+                         std::memory_order_release);
+    // pairs with the fence of oldest_seen(): the slot is visible before the
+    // thread reads any shared pointer, or the reclaimer unlinked it before
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void Qsbr::unregister_thread() noexcept
+{
+    slots_.local().store(OFFLINE, std::memory_order_release);
+}
+
+bool Qsbr::is_registered() noexcept
+{
+    return slots_.local().load(std::memory_order_relaxed) != OFFLINE;
+}
+
+uint64_t Qsbr::oldest_seen() const noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return slots_.combine(std::numeric_limits<uint64_t>::max(),
+                          [](uint64_t oldest, const std::atomic<uint64_t>& slot)
+                          {
+                              auto seen = slot.load(std::memory_order_acquire);
+                              return seen == OFFLINE ? oldest : std::min(oldest, seen);
+                          });
+}
+
+void Qsbr::retire(std::function<void()> deleter)
+{
+    // the objects are unreachable before the epoch changes, a thread seeing
+    // the new epoch cannot reference them anymore
+    auto target = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        retired_.emplace_back(target, std::move(deleter));
+    }
+
+    reclaim();
+}
+
+size_t Qsbr::reclaim()
+{
+    std::vector<std::function<void()>> deleters;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (retired_.empty())
+        {
+            return 0;
+        }
+
+        auto oldest = oldest_seen();
+        while (!retired_.empty() && retired_.front().first <= oldest)
+        {
+            deleters.push_back(std::move(retired_.front().second));
+            retired_.pop_front();
+        }
+    }
+
+    for (auto& deleter : deleters)
+    {
+        deleter();
+    }
+
+    return deleters.size();
+}
+
+void Qsbr::synchronize()
+{
+    auto target = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    quiescent();
+
+    while (oldest_seen() < target)
+    {
+        std::this_thread::yield();
+    }
+
+    reclaim();
+}
+
+size_t Qsbr::pending() const
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return retired_.size();
+}
+
+} // namespace thread
+} // namespace commonpp
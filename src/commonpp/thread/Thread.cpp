@@ -9,23 +9,39 @@
  *
  */
 #include "commonpp/thread/Thread.hpp"
+#include "commonpp/thread/Topology.hpp"
 
 #include "commonpp/core/config.hpp"
 
 // clang-format off
 
-#if HAVE_HWLOC == 1
-# include "detail/Cores.hpp"
-#endif
-
 #if HAVE_SYS_PRCTL_H
 # include <sys/prctl.h>
 # include <cerrno>
 # include <cstring>
 #endif
 
-#include <sstream>
+#ifdef __linux__
+# include <sys/resource.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#ifndef _WIN32
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #ifndef HAVE_THREAD_LOCAL_SPECIFIER
 # include <boost/thread/tss.hpp>
@@ -40,20 +56,201 @@ namespace commonpp
 namespace thread
 {
 
-#if HAVE_THREAD_LOCAL_SPECIFIER
-static thread_local std::string current_name;
+namespace detail
+{
+
+thread_local size_t current_thread_index = NO_THREAD_INDEX;
+
+struct ThreadIndexes
+{
+    std::mutex lock;
+    size_t next = 0;
+    std::vector<size_t> released;
+};
+
+static ThreadIndexes& thread_indexes()
+{
+    // never destroyed, threads may exit after the static destructors ran
+    static auto* indexes = new ThreadIndexes;
+    return *indexes;
+}
+
+struct ThreadIndexReleaser
+{
+    ~ThreadIndexReleaser()
+    {
+        if (current_thread_index == NO_THREAD_INDEX)
+        {
+            return;
+        }
+
+        auto& indexes = thread_indexes();
+        std::lock_guard<std::mutex> lock(indexes.lock);
+        indexes.released.push_back(current_thread_index);
+        current_thread_index = NO_THREAD_INDEX;
+    }
+};
+
+size_t register_current_thread_index()
+{
+    static thread_local ThreadIndexReleaser releaser;
+    (void)releaser;
+
+    auto& indexes = thread_indexes();
+    std::lock_guard<std::mutex> lock(indexes.lock);
+    if (indexes.released.empty())
+    {
+        current_thread_index = indexes.next++;
+    }
+    else
+    {
+        // reuse the smallest index to keep them dense
+        auto smallest =
+            std::min_element(indexes.released.begin(), indexes.released.end());
+        current_thread_index = *smallest;
+        indexes.released.erase(smallest);
+    }
+
+    return current_thread_index;
+}
+
+} // namespace detail
+
+namespace
+{
+const ThreadNameId NO_NAME_ID = static_cast<ThreadNameId>(-1);
+
+// Append only: the names are published by segment, the readers only load
+// the segment of the id.
+class ThreadNames
+{
+public:
+    static const size_t SEGMENT_SIZE = 1024;
+    static const size_t NB_SEGMENTS = 1024;
+
+    ThreadNames()
+    {
+        // the last id is shared once the table is full
+        overflow_ = intern("<too many thread names>");
+    }
+
+    ThreadNameId intern(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = ids_.find(name);
+        if (it != ids_.end())
+        {
+            return it->second;
+        }
+
+        auto id = static_cast<ThreadNameId>(names_.size());
+        if (id == SEGMENT_SIZE * NB_SEGMENTS)
+        {
+            return overflow_;
+        }
+
+        auto& segment = segments_[id / SEGMENT_SIZE];
+        if (!segment.load(std::memory_order_relaxed))
+        {
+            segment.store(new std::atomic<const std::string*>[SEGMENT_SIZE](),
+                          std::memory_order_release);
+        }
+
+        names_.push_back(name);
+        segment.load(std::memory_order_relaxed)[id % SEGMENT_SIZE].store(
+            &names_.back(), std::memory_order_release);
+        ids_.emplace(name, id);
+        return id;
+    }
+
+    const std::string& name(ThreadNameId id) const noexcept
+    {
+        static const std::string unknown;
+
+        if (id < SEGMENT_SIZE * NB_SEGMENTS)
+        {
+            auto segment = segments_[id / SEGMENT_SIZE].load(std::memory_order_acquire);
+            if (segment)
+            {
+                auto name = segment[id % SEGMENT_SIZE].load(std::memory_order_acquire);
+                if (name)
+                {
+                    return *name;
+                }
+            }
+        }
+        return unknown;
+    }
+
+private:
+    std::mutex lock_;
+    std::unordered_map<std::string, ThreadNameId> ids_;
+    std::deque<std::string> names_;
+    std::atomic<std::atomic<const std::string*>*> segments_[NB_SEGMENTS] = {};
+    ThreadNameId overflow_;
+};
+
+ThreadNames& thread_names()
+{
+    // never destroyed, the logging threads name themselves and format the
+    // names after the static destructors ran
+    static auto* names = new ThreadNames;
+    return *names;
+}
+
+// The threads never named are not interned, their id carries their system
+// thread id instead.
+const ThreadNameId UNNAMED_ID_BIT = static_cast<ThreadNameId>(1) << 31;
+
+bool is_unnamed(ThreadNameId id) noexcept
+{
+    return (id & UNNAMED_ID_BIT) && id != NO_NAME_ID;
+}
+
+ThreadNameId unnamed_thread_id()
+{
+#ifdef __linux__
+    auto tid = static_cast<ThreadNameId>(::syscall(SYS_gettid));
 #else
-static boost::thread_specific_ptr<std::string> current_name;
+    static std::atomic<ThreadNameId> next_tid{1};
+    auto tid = next_tid.fetch_add(1, std::memory_order_relaxed);
 #endif
+    return UNNAMED_ID_BIT | (tid & ~UNNAMED_ID_BIT);
+}
 
-void set_current_thread_name(const std::string& name)
+struct CurrentName
 {
+    std::string name;
+    ThreadNameId id = NO_NAME_ID;
+};
+} // namespace
+
 #if HAVE_THREAD_LOCAL_SPECIFIER
-    current_name = name;
+static thread_local CurrentName current_name;
+
+static CurrentName& current()
+{
+    return current_name;
+}
 #else
-    current_name.reset(new std::string(name));
+static boost::thread_specific_ptr<CurrentName> current_name;
+
+static CurrentName& current()
+{
+    if (!current_name.get())
+    {
+        current_name.reset(new CurrentName);
+    }
+    return *current_name;
+}
 #endif
 
+void set_current_thread_name(const std::string& name)
+{
+    auto& current_thread = current();
+    current_thread.name = name;
+    current_thread.id = thread_names().intern(name);
+
 #if defined(HAVE_SYS_PRCTL_H)
     auto short_thread_name = name.substr(0, 15);
     if (prctl(PR_SET_NAME, short_thread_name.c_str()))
@@ -67,86 +264,173 @@ void set_current_thread_name(const std::string& name)
 
 const std::string& get_current_thread_name()
 {
-#if HAVE_THREAD_LOCAL_SPECIFIER
-    if (!current_name.empty())
+    auto& current_thread = current();
+    if (BOOST_UNLIKELY(current_thread.id == NO_NAME_ID))
     {
-        return current_name;
+        // not interned, only the names set explicitly are
+        current_thread.id = unnamed_thread_id();
+        current_thread.name = std::to_string(current_thread.id & ~UNNAMED_ID_BIT);
     }
-#else
-    if (current_name.get())
+
+    return current_thread.name;
+}
+
+ThreadNameId get_current_thread_name_id()
+{
+    auto id = current().id;
+    if (BOOST_UNLIKELY(id == NO_NAME_ID))
     {
-        return *current_name;
+        get_current_thread_name();
+        id = current().id;
     }
-#endif
-
-    std::ostringstream out;
-    out << std::this_thread::get_id();
-    set_current_thread_name(out.str());
+    return id;
+}
 
-    return get_current_thread_name();
+const std::string& get_thread_name(ThreadNameId id) noexcept
+{
+    if (is_unnamed(id))
+    {
+        // a few digits, kept in the small string buffer
+        static thread_local std::string unnamed;
+        unnamed = std::to_string(id & ~UNNAMED_ID_BIT);
+        return unnamed;
+    }
+    return thread_names().name(id);
 }
 
-#if HAVE_HWLOC == 1
 int get_nb_physical_core()
 {
-    return detail::Cores(detail::Cores::PHYSICAL).cores();
+    return Topology::instance().cores().size();
 }
 
 int get_nb_logical_core()
 {
-    return detail::Cores(detail::Cores::ALL).cores();
+    return Topology::instance().pus().size();
 }
 
 bool set_affinity_to_physical_core(int core)
 {
-    return detail::Cores(detail::Cores::PHYSICAL)[core].bind();
+    return Topology::instance().bind_to_core(core);
 }
 
 bool set_affinity_to_logical_core(int core)
 {
-    return detail::Cores(detail::Cores::ALL)[core].bind();
+    return Topology::instance().bind_to_pu(core);
 }
 
 bool set_affinity_to_physical_core(int core, std::thread& th)
 {
-    return detail::Cores(detail::Cores::PHYSICAL)[core].bind(th);
+    return Topology::instance().bind_to_core(core, th);
 }
 
 bool set_affinity_to_logical_core(int core, std::thread& th)
 {
-    return detail::Cores(detail::Cores::ALL)[core].bind(th);
-}
-#else
-int get_nb_physical_core()
-{
-    return std::thread::hardware_concurrency();
+    return Topology::instance().bind_to_pu(core, th);
 }
 
-int get_nb_logical_core()
+static void log_scheduling_error(const char* what, int error)
 {
-    return std::thread::hardware_concurrency();
+    LOG(thread_logger, error)
+        << "Cannot set the " << what << " of thread " << get_current_thread_name()
+        << ": " << strerror(error)
+        << (error == EPERM ? " (the process lacks CAP_SYS_NICE or the "
+                             "RLIMIT_RTPRIO/RLIMIT_NICE limits are too low)"
+                           : "");
 }
 
-bool set_affinity_to_physical_core(int)
-{
-    return false;
-}
+#ifdef __linux__
+// from linux/ioprio.h, which is not always installed
+static constexpr int IOPRIO_CLASS_SHIFT = 13;
+static constexpr int IOPRIO_WHO_PROCESS = 1;
 
-bool set_affinity_to_logical_core(int)
+static int to_ioprio_class(SchedulingPolicy::IOClass io_class)
 {
-    return false;
+    switch (io_class)
+    {
+    case SchedulingPolicy::IORealtime:
+        return 1;
+    case SchedulingPolicy::IOBestEffort:
+        return 2;
+    case SchedulingPolicy::IOIdle:
+        return 3;
+    default:
+        return 0;
+    }
 }
+#endif
 
-bool set_affinity_to_physical_core(int, std::thread&)
+bool set_current_thread_scheduling(const SchedulingPolicy& policy)
 {
-    return false;
-}
+    bool result = true;
 
-bool set_affinity_to_logical_core(int, std::thread&)
-{
-    return false;
-}
+#ifndef _WIN32
+    if (policy.policy != SchedulingPolicy::Inherit)
+    {
+        int sched_policy = SCHED_OTHER;
+        sched_param param{};
+
+        switch (policy.policy)
+        {
+        case SchedulingPolicy::Fifo:
+            sched_policy = SCHED_FIFO;
+            param.sched_priority = policy.priority;
+            break;
+        case SchedulingPolicy::RoundRobin:
+            sched_policy = SCHED_RR;
+            param.sched_priority = policy.priority;
+            break;
+#ifdef __linux__
+        case SchedulingPolicy::Batch:
+            sched_policy = SCHED_BATCH;
+            break;
+        case SchedulingPolicy::Idle:
+            sched_policy = SCHED_IDLE;
+            break;
+#endif
+        default:
+            break;
+        }
+
+        if (auto error = pthread_setschedparam(pthread_self(), sched_policy, &param))
+        {
+            log_scheduling_error("scheduling policy", error);
+            result = false;
+        }
+    }
 #endif
 
+#ifdef __linux__
+    const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+
+    // the nice value is per thread on Linux
+    if (policy.set_nice && ::setpriority(PRIO_PROCESS, tid, policy.nice))
+    {
+        log_scheduling_error("nice value", errno);
+        result = false;
+    }
+
+    if (policy.io_class != SchedulingPolicy::IOInherit)
+    {
+        int ioprio = (to_ioprio_class(policy.io_class) << IOPRIO_CLASS_SHIFT) |
+                     (policy.io_class == SchedulingPolicy::IOIdle ? 0 : policy.io_priority);
+        if (::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio))
+        {
+            log_scheduling_error("IO priority", errno);
+            result = false;
+        }
+    }
+#else
+    if (policy.set_nice || policy.io_class != SchedulingPolicy::IOInherit)
+    {
+        LOG(thread_logger, warning)
+            << "Per thread nice value and IO priority are not supported on "
+               "this platform";
+        result = false;
+    }
+#endif
+
+    return result;
+}
+
 } // namespace thread
 } // namespace commonpp
@@ -0,0 +1,215 @@
+/*
+ * File: src/commonpp/thread/ThreadMonitor.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/thread/ThreadMonitor.hpp"
+
+#include "commonpp/core/config.hpp"
+
+// clang-format off
+#if HAVE_POSIX_CPU_CLOCK
+# include <pthread.h>
+# include <ctime>
+#endif
+
+#ifdef __linux__
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+// clang-format on
+
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+#include "commonpp/core/LoggingInterface.hpp"
+#include "detail/logger.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+static long current_tid()
+{
+#ifdef __linux__
+    return static_cast<long>(::syscall(SYS_gettid));
+#else
+    return static_cast<long>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+#endif
+}
+
+#ifdef __linux__
+static std::string task_file(long tid, const char* file)
+{
+    return "/proc/self/task/" + std::to_string(tid) + "/" + file;
+}
+
+// parses the "key: value" lines of /proc/<pid>/task/<tid>/{status,sched}
+template <typename Callable>
+static void read_key_values(const std::string& path, Callable&& callable)
+{
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        auto sep = line.find(':');
+        if (sep == std::string::npos)
+        {
+            continue;
+        }
+
+        auto key = line.substr(0, line.find_last_not_of(" \t", sep - 1) + 1);
+        callable(key, std::strtoull(line.c_str() + sep + 1, nullptr, 10));
+    }
+}
+
+static void read_scheduler_stats(ThreadStats& stats)
+{
+    read_key_values(task_file(stats.tid, "status"),
+                    [&stats](const std::string& key, uint64_t value)
+                    {
+                        if (key == "voluntary_ctxt_switches")
+                        {
+                            stats.voluntary_switches = value;
+                        }
+                        else if (key == "nonvoluntary_ctxt_switches")
+                        {
+                            stats.involuntary_switches = value;
+                        }
+                    });
+
+    read_key_values(task_file(stats.tid, "sched"),
+                    [&stats](const std::string& key, uint64_t value)
+                    {
+                        if (key == "se.nr_migrations")
+                        {
+                            stats.migrations = value;
+                        }
+                    });
+
+    // run time, run queue wait time (both in ns), number of time slices
+    std::ifstream schedstat(task_file(stats.tid, "schedstat"));
+    uint64_t run_time = 0;
+    uint64_t wait_time = 0;
+    if (schedstat >> run_time >> wait_time)
+    {
+        stats.run_queue_wait = std::chrono::nanoseconds(wait_time);
+    }
+}
+#endif
+
+std::ostream& operator<<(std::ostream& os, const ThreadStats& stats)
+{
+    auto flags = os.flags();
+    os << stats.name << " (" << stats.tid << "): load " << std::fixed
+       << std::setprecision(1) << stats.load * 100 << "%, run queue wait "
+       << stats.wait_ratio * 100 << "%, cpu "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(stats.cpu_time).count()
+       << "ms, context switches " << stats.voluntary_switches << "/"
+       << stats.involuntary_switches << ", migrations " << stats.migrations;
+    os.flags(flags);
+    return os;
+}
+
+ThreadMonitor& ThreadMonitor::instance()
+{
+    static ThreadMonitor monitor;
+    return monitor;
+}
+
+void ThreadMonitor::register_current_thread()
+{
+    Entry entry;
+    entry.stats.name = get_current_thread_name();
+    entry.stats.tid = current_tid();
+
+#if HAVE_POSIX_CPU_CLOCK
+    clockid_t clock_id;
+    if (pthread_getcpuclockid(pthread_self(), &clock_id) == 0)
+    {
+        entry.clock_id = clock_id;
+        entry.has_clock = true;
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(lock_);
+    threads_[entry.stats.tid] = std::move(entry);
+}
+
+void ThreadMonitor::unregister_current_thread()
+{
+    auto tid = current_tid();
+    std::lock_guard<std::mutex> lock(lock_);
+    threads_.erase(tid);
+}
+
+std::vector<ThreadStats> ThreadMonitor::sample()
+{
+    std::vector<ThreadStats> result;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    result.reserve(threads_.size());
+
+    for (auto& thread : threads_)
+    {
+        auto& entry = thread.second;
+        auto previous = entry.stats;
+        auto& stats = entry.stats;
+
+#if HAVE_POSIX_CPU_CLOCK
+        ::timespec ts;
+        if (entry.has_clock &&
+            ::clock_gettime(static_cast<clockid_t>(entry.clock_id), &ts) == 0)
+        {
+            stats.cpu_time =
+                std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+        }
+#endif
+
+#ifdef __linux__
+        read_scheduler_stats(stats);
+#endif
+
+        auto now = std::chrono::steady_clock::now();
+        if (entry.last_sample != std::chrono::steady_clock::time_point{})
+        {
+            double wall = std::chrono::duration<double>(now - entry.last_sample).count();
+            if (wall > 0)
+            {
+                stats.load =
+                    std::chrono::duration<double>(stats.cpu_time - previous.cpu_time)
+                        .count() /
+                    wall;
+                stats.wait_ratio = std::chrono::duration<double>(
+                                       stats.run_queue_wait - previous.run_queue_wait)
+                                       .count() /
+                                   wall;
+            }
+        }
+        entry.last_sample = now;
+
+        result.push_back(stats);
+    }
+
+    return result;
+}
+
+void ThreadMonitor::log_stats(const std::vector<ThreadStats>& stats)
+{
+    for (const auto& thread : stats)
+    {
+        LOG(thread_logger, info) << thread;
+    }
+}
+
+} // namespace thread
+} // namespace commonpp
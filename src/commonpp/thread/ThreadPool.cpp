@@ -10,6 +10,7 @@
  */
 #include "commonpp/thread/ThreadPool.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <boost/asio/executor_work_guard.hpp>
 #include <boost/asio/io_context.hpp>
@@ -21,12 +22,8 @@
 #include "commonpp/core/config.hpp"
 #include "detail/logger.hpp"
 
-// clang-format off
-#if HAVE_HWLOC == 1
-# include <hwloc.h>
-# include "detail/Cores.hpp"
-#endif
-// clang-format on
+#include "commonpp/thread/ThreadMonitor.hpp"
+#include "commonpp/thread/Topology.hpp"
 
 namespace commonpp
 {
@@ -35,38 +32,178 @@ namespace thread
 
 namespace detail
 {
+
+// The cpusets of the objects of the given level minus the excluded cpus, the
+// objects left without any cpu are skipped.
+static std::vector<CpuSet> usable_cpusets(Topology::Level level,
+                                          const CpuSet& excluded)
+{
+    std::vector<CpuSet> cpusets;
+    for (const auto& object : Topology::instance().objects(level))
+    {
+        auto cpuset = object.cpuset & ~excluded;
+        if (cpuset.any())
+        {
+            cpusets.push_back(cpuset);
+        }
+    }
+
+    return cpusets;
+}
+
+static CpuSet first_cpu(const CpuSet& cpuset)
+{
+    CpuSet first;
+    for (size_t i = 0; i < cpuset.size(); ++i)
+    {
+        if (cpuset.test(i))
+        {
+            first.set(i);
+            break;
+        }
+    }
+    return first;
+}
+
 template <ThreadPool::ThreadDispatchPolicy T>
 struct ThreadDispatcher
 {
-    void set_affinity(std::thread&)
+    ThreadDispatcher(size_t, const CpuSet& excluded)
+    : allowed(Topology::instance().online_cpus() & ~excluded)
+    , restricted(excluded.any())
+    {
+    }
+
+    CpuSet affinity(size_t)
     {
+        return restricted ? allowed : CpuSet();
     }
+
+    CpuSet allowed;
+    bool restricted;
 };
 
-#if HAVE_HWLOC == 1
 template <>
 struct ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToPCore>
 {
-    void set_affinity(std::thread& thread)
+    ThreadDispatcher(size_t, const CpuSet& excluded)
+    : cores(usable_cpusets(Topology::CORE, excluded))
+    {
+    }
+
+    CpuSet affinity(size_t)
     {
-        cores[current_core++ % cores.cores()].bind(thread);
+        if (cores.empty())
+        {
+            return {};
+        }
+        return first_cpu(cores[current_core++ % cores.size()]);
     }
 
-    detail::Cores cores{detail::Cores::PHYSICAL};
-    int current_core = 0;
+    std::vector<CpuSet> cores;
+    size_t current_core = 0;
 };
+
 template <>
 struct ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToAllCore>
 {
-    void set_affinity(std::thread& thread)
+    ThreadDispatcher(size_t, const CpuSet& excluded)
+    : pus(usable_cpusets(Topology::PU, excluded))
+    {
+    }
+
+    CpuSet affinity(size_t)
+    {
+        if (pus.empty())
+        {
+            return {};
+        }
+        return pus[current_pu++ % pus.size()];
+    }
+
+    std::vector<CpuSet> pus;
+    size_t current_pu = 0;
+};
+
+// All the threads of a service share the same cache domain, the services are
+// spread over the domains. Machines without such caches fall back to the
+// packages.
+template <Topology::Level level>
+struct CacheDomainDispatcher
+{
+    CacheDomainDispatcher(size_t, const CpuSet& excluded)
+    : domains(usable_cpusets(level, excluded))
+    {
+        if (domains.empty())
+        {
+            LOG(thread_logger, warning)
+                << "No cache domain found, threads are grouped by package";
+            domains = usable_cpusets(Topology::PACKAGE, excluded);
+        }
+    }
+
+    CpuSet affinity(size_t service)
+    {
+        if (domains.empty())
+        {
+            return {};
+        }
+        return domains[service % domains.size()];
+    }
+
+    std::vector<CpuSet> domains;
+};
+
+template <>
+struct ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToL3Domain>
+    : CacheDomainDispatcher<Topology::L3_CACHE>
+{
+    using CacheDomainDispatcher::CacheDomainDispatcher;
+};
+
+template <>
+struct ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToL2Domain>
+    : CacheDomainDispatcher<Topology::L2_CACHE>
+{
+    using CacheDomainDispatcher::CacheDomainDispatcher;
+};
+
+// The threads of a service are bound to the hyperthreads of one core, each
+// service getting its own core.
+template <>
+struct ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToSMTSiblings>
+{
+    ThreadDispatcher(size_t nb_services, const CpuSet& excluded)
+    : threads_by_service(nb_services, 0)
     {
-        cores[current_core++ % cores.cores()].bind(thread);
+        for (const auto& core : usable_cpusets(Topology::CORE, excluded))
+        {
+            std::vector<CpuSet> pus;
+            for (size_t i = 0; i < core.size(); ++i)
+            {
+                if (core.test(i))
+                {
+                    pus.emplace_back().set(i);
+                }
+            }
+            siblings.push_back(std::move(pus));
+        }
     }
 
-    detail::Cores cores{detail::Cores::ALL};
-    int current_core = 0;
+    CpuSet affinity(size_t service)
+    {
+        if (siblings.empty())
+        {
+            return {};
+        }
+
+        const auto& pus = siblings[service % siblings.size()];
+        return pus[threads_by_service[service]++ % pus.size()];
+    }
+
+    std::vector<std::vector<CpuSet>> siblings;
+    std::vector<size_t> threads_by_service;
 };
-#endif
 
 } // namespace detail
 
@@ -129,6 +266,10 @@ ThreadPool::ThreadPool(ThreadPool&& pool)
 , threads_(std::move(pool.threads_))
 , services_(std::move(pool.services_))
 , works_(std::move(pool.works_))
+, housekeeping_cpus_(pool.housekeeping_cpus_)
+, scheduling_policy_(pool.scheduling_policy_)
+, quiescent_domains_(std::move(pool.quiescent_domains_))
+, quiescent_period_(pool.quiescent_period_)
 {
     running_threads_.store(pool.running_threads_.load());
     pool.running_threads_ = 0;
@@ -142,7 +283,9 @@ void ThreadPool::start(ThreadInit fct, ThreadDispatchPolicy policy)
         return;
     }
 
-    std::function<void(std::thread&)> binder;
+    // The cpus of each thread are chosen before it is spawned, it binds itself
+    // before anything else so that its per thread data is allocated there.
+    std::function<CpuSet(size_t)> binder;
     { // Setup the policy which will bind the thread to specific core.
         using RandomDispatcher =
             detail::ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::Random>;
@@ -150,25 +293,50 @@ void ThreadPool::start(ThreadInit fct, ThreadDispatchPolicy policy)
             detail::ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToPCore>;
         using ToAllCoreDispatcher =
             detail::ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToAllCore>;
-
+        using ToL3DomainDispatcher =
+            detail::ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToL3Domain>;
+        using ToL2DomainDispatcher =
+            detail::ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToL2Domain>;
+        using ToSMTSiblingsDispatcher =
+            detail::ThreadDispatcher<ThreadPool::ThreadDispatchPolicy::DispatchToSMTSiblings>;
+
+        using namespace std::placeholders;
         switch (policy)
         {
         default:
             LOG(thread_logger, warning)
                 << "Unknown thread dispatch policy: " << enum_to_number(policy);
-            binder = [](std::thread&) {};
+            binder = [](size_t) { return CpuSet(); };
             break;
         case ThreadDispatchPolicy::Random:
-            binder = std::bind(&RandomDispatcher::set_affinity,
-                               RandomDispatcher{}, std::placeholders::_1);
+            binder = std::bind(&RandomDispatcher::affinity,
+                               RandomDispatcher{nb_services_, housekeeping_cpus_},
+                               _1);
             break;
         case ThreadDispatchPolicy::DispatchToPCore:
-            binder = std::bind(&ToPCoreDispatcher::set_affinity,
-                               ToPCoreDispatcher{}, std::placeholders::_1);
+            binder = std::bind(&ToPCoreDispatcher::affinity,
+                               ToPCoreDispatcher{nb_services_, housekeeping_cpus_},
+                               _1);
             break;
         case ThreadDispatchPolicy::DispatchToAllCore:
-            binder = std::bind(&ToAllCoreDispatcher::set_affinity,
-                               ToAllCoreDispatcher{}, std::placeholders::_1);
+            binder = std::bind(&ToAllCoreDispatcher::affinity,
+                               ToAllCoreDispatcher{nb_services_, housekeeping_cpus_},
+                               _1);
+            break;
+        case ThreadDispatchPolicy::DispatchToL3Domain:
+            binder = std::bind(&ToL3DomainDispatcher::affinity,
+                               ToL3DomainDispatcher{nb_services_, housekeeping_cpus_},
+                               _1);
+            break;
+        case ThreadDispatchPolicy::DispatchToL2Domain:
+            binder = std::bind(&ToL2DomainDispatcher::affinity,
+                               ToL2DomainDispatcher{nb_services_, housekeeping_cpus_},
+                               _1);
+            break;
+        case ThreadDispatchPolicy::DispatchToSMTSiblings:
+            binder = std::bind(&ToSMTSiblingsDispatcher::affinity,
+                               ToSMTSiblingsDispatcher{nb_services_, housekeeping_cpus_},
+                               _1);
             break;
         }
     }
@@ -182,10 +350,16 @@ void ThreadPool::start(ThreadInit fct, ThreadDispatchPolicy policy)
     threads_.reserve(nb_thread_);
     for (size_t i = 0; i < nb_thread_; ++i)
     {
+        auto cpuset = binder(i % nb_services_);
         threads_.emplace_back(&ThreadPool::run, this,
                               std::ref(getService(i % nb_services_)),
-                              [this, fct, i, &latch]
+                              [this, fct, i, cpuset, &latch]
                               {
+                                  if (cpuset.any())
+                                  {
+                                      Topology::instance().bind(cpuset);
+                                  }
+
                                   auto suffix = "#" + std::to_string(i) + "|S#" +
                                                 std::to_string(i % nb_services_);
                                   if (name_.empty())
@@ -198,14 +372,16 @@ void ThreadPool::start(ThreadInit fct, ThreadDispatchPolicy policy)
                                       set_current_thread_name(name_ + suffix);
                                   }
 
+                                  set_current_thread_scheduling(scheduling_policy_);
+                                  ThreadMonitor::instance().register_current_thread();
+                                  current_thread_index();
+
                                   if (fct)
                                   {
                                       fct();
                                   }
                                   latch.count_down();
                               });
-
-        binder(threads_.back());
     }
 
     latch.wait();
@@ -224,9 +400,35 @@ void ThreadPool::run(io_context& service, ThreadInit fct)
 
     LOG(thread_logger, debug) << "Start thread";
 
-    service.run();
+    if (quiescent_domains_.empty())
+    {
+        service.run();
+    }
+    else
+    {
+        for (auto domain : quiescent_domains_)
+        {
+            domain->register_thread();
+        }
+
+        while (!service.stopped())
+        {
+            service.run_one_for(quiescent_period_);
+            for (auto domain : quiescent_domains_)
+            {
+                domain->quiescent();
+            }
+        }
+
+        for (auto domain : quiescent_domains_)
+        {
+            domain->unregister_thread();
+        }
+    }
     --running_threads_;
 
+    ThreadMonitor::instance().unregister_current_thread();
+
     if (on_exit_thread_fn)
     {
         on_exit_thread_fn();
@@ -327,6 +529,24 @@ size_t ThreadPool::threads() const noexcept
     return nb_thread_;
 }
 
+void ThreadPool::set_housekeeping_cpus(const CpuSet& cpus)
+{
+    housekeeping_cpus_ = cpus;
+}
+
+void ThreadPool::set_scheduling_policy(const SchedulingPolicy& policy)
+{
+    scheduling_policy_ = policy;
+}
+
+void ThreadPool::enable_quiescent_states(QuiescentStateDomain& domain,
+                                         std::chrono::milliseconds max_period)
+{
+    quiescent_period_ =
+        quiescent_domains_.empty() ? max_period : std::min(quiescent_period_, max_period);
+    quiescent_domains_.push_back(&domain);
+}
+
 void ThreadPool::set_cleanup_fn(std::function<void()> cleanup_fn)
 {
     on_exit_thread_fn = std::move(cleanup_fn);
@@ -0,0 +1,366 @@
+/*
+ * File: src/commonpp/thread/Topology.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#include "commonpp/thread/Topology.hpp"
+
+#include "commonpp/core/config.hpp"
+
+// clang-format off
+#if HAVE_HWLOC == 1
+# include <hwloc.h>
+# include <cerrno>
+# include <cstring>
+#endif
+// clang-format on
+
+#include <algorithm>
+
+#include "commonpp/core/LoggingInterface.hpp"
+#include "detail/logger.hpp"
+
+namespace commonpp
+{
+namespace thread
+{
+
+struct Topology::Impl
+{
+    // owner[level][pu os index] is the index of the object holding the PU
+    std::vector<int> owner[NB_LEVELS];
+
+#if HAVE_HWLOC == 1
+    hwloc_topology_t topology = nullptr;
+    // prebuilt bitmaps so binding to a core or a PU does not allocate
+    std::vector<hwloc_bitmap_t> core_bind_sets;
+    std::vector<hwloc_bitmap_t> pu_bind_sets;
+
+    ~Impl()
+    {
+        for (auto set : core_bind_sets)
+        {
+            hwloc_bitmap_free(set);
+        }
+
+        for (auto set : pu_bind_sets)
+        {
+            hwloc_bitmap_free(set);
+        }
+
+        if (topology)
+        {
+            hwloc_topology_destroy(topology);
+        }
+    }
+
+    int depth(Level level) const
+    {
+        switch (level)
+        {
+        case NUMA_NODE:
+            return hwloc_get_type_depth(topology, HWLOC_OBJ_NUMANODE);
+#if HWLOC_API_VERSION >= 0x00020000
+        case PACKAGE:
+            return hwloc_get_type_depth(topology, HWLOC_OBJ_PACKAGE);
+        case L3_CACHE:
+            return hwloc_get_type_depth(topology, HWLOC_OBJ_L3CACHE);
+        case L2_CACHE:
+            return hwloc_get_type_depth(topology, HWLOC_OBJ_L2CACHE);
+#else
+        case PACKAGE:
+            return hwloc_get_type_depth(topology, HWLOC_OBJ_SOCKET);
+        case L3_CACHE:
+            return hwloc_get_cache_type_depth(topology, 3, HWLOC_OBJ_CACHE_UNIFIED);
+        case L2_CACHE:
+            return hwloc_get_cache_type_depth(topology, 2, HWLOC_OBJ_CACHE_UNIFIED);
+#endif
+        case CORE:
+            // the PUs when hwloc does not know the cores (some VMs)
+            return hwloc_get_type_or_below_depth(topology, HWLOC_OBJ_CORE);
+        case PU:
+            return hwloc_get_type_depth(topology, HWLOC_OBJ_PU);
+        default:
+            return HWLOC_TYPE_DEPTH_UNKNOWN;
+        }
+    }
+
+    static CpuSet to_cpuset(hwloc_const_bitmap_t bitmap)
+    {
+        CpuSet cpuset;
+        unsigned id;
+        hwloc_bitmap_foreach_begin(id, bitmap)
+        {
+            if (id < MAX_CPUS)
+            {
+                cpuset.set(id);
+            }
+        }
+        hwloc_bitmap_foreach_end();
+        return cpuset;
+    }
+
+    static hwloc_bitmap_t to_bitmap(const CpuSet& cpuset)
+    {
+        auto bitmap = hwloc_bitmap_alloc();
+        for (std::size_t i = 0; i < cpuset.size(); ++i)
+        {
+            if (cpuset.test(i))
+            {
+                hwloc_bitmap_set(bitmap, i);
+            }
+        }
+        return bitmap;
+    }
+
+    bool bind(hwloc_const_bitmap_t set) const
+    {
+        if (hwloc_set_cpubind(topology, set, HWLOC_CPUBIND_THREAD))
+        {
+            auto error = errno;
+            LOG(thread_logger, warning)
+                << "Error setting thread affinity: " << strerror(error);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool bind(hwloc_const_bitmap_t set, std::thread& thread) const
+    {
+        if (hwloc_set_thread_cpubind(topology, thread.native_handle(), set, 0))
+        {
+            auto error = errno;
+            LOG(thread_logger, warning)
+                << "Error setting thread affinity: " << strerror(error);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool bind_nth(const std::vector<hwloc_bitmap_t>& sets, int n, std::thread* thread) const
+    {
+        if (sets.empty() || n < 0)
+        {
+            return false;
+        }
+
+        auto set = sets[n % sets.size()];
+        return thread ? bind(set, *thread) : bind(set);
+    }
+#endif
+};
+
+const Topology& Topology::instance()
+{
+    static const Topology topology;
+    return topology;
+}
+
+Topology::Topology()
+: impl_(new Impl)
+{
+#if HAVE_HWLOC == 1
+    hwloc_topology_init(&impl_->topology);
+    hwloc_topology_load(impl_->topology);
+
+    online_ = Impl::to_cpuset(hwloc_topology_get_topology_cpuset(impl_->topology));
+
+    for (int level = 0; level < NB_LEVELS; ++level)
+    {
+        auto depth = impl_->depth(static_cast<Level>(level));
+        if (depth == HWLOC_TYPE_DEPTH_UNKNOWN || depth == HWLOC_TYPE_DEPTH_MULTIPLE)
+        {
+            continue;
+        }
+
+        auto nb_objs = hwloc_get_nbobjs_by_depth(impl_->topology, depth);
+        for (unsigned i = 0; i < nb_objs; ++i)
+        {
+            auto obj = hwloc_get_obj_by_depth(impl_->topology, depth, i);
+            objects_[level].push_back(Object{
+                static_cast<Level>(level),
+                obj->logical_index,
+                obj->os_index,
+                Impl::to_cpuset(obj->cpuset),
+            });
+
+            if (level == CORE)
+            {
+                auto set = hwloc_bitmap_dup(obj->cpuset);
+                hwloc_bitmap_singlify(set);
+                impl_->core_bind_sets.push_back(set);
+            }
+            else if (level == PU)
+            {
+                impl_->pu_bind_sets.push_back(hwloc_bitmap_dup(obj->cpuset));
+            }
+        }
+    }
+#else
+    const unsigned nb_cpus =
+        std::min<unsigned>(std::max(1u, std::thread::hardware_concurrency()), MAX_CPUS);
+    for (unsigned i = 0; i < nb_cpus; ++i)
+    {
+        online_.set(i);
+    }
+
+    for (auto level : {CORE, PU})
+    {
+        for (unsigned i = 0; i < nb_cpus; ++i)
+        {
+            CpuSet cpuset;
+            cpuset.set(i);
+            objects_[level].push_back(Object{level, i, i, cpuset});
+        }
+    }
+
+    for (auto level : {NUMA_NODE, PACKAGE})
+    {
+        objects_[level].push_back(Object{level, 0, 0, online_});
+    }
+#endif
+
+    for (int level = 0; level < NB_LEVELS; ++level)
+    {
+        auto& owner = impl_->owner[level];
+        owner.assign(MAX_CPUS, -1);
+        const auto& objects = objects_[level];
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            for (std::size_t pu = 0; pu < MAX_CPUS; ++pu)
+            {
+                if (objects[i].cpuset.test(pu))
+                {
+                    owner[pu] = static_cast<int>(i);
+                }
+            }
+        }
+    }
+}
+
+Topology::~Topology() = default;
+
+const std::vector<Topology::Object>& Topology::objects(Level level) const noexcept
+{
+    return objects_[level];
+}
+
+const Topology::Object* Topology::object_of(Level level,
+                                            unsigned pu_os_index) const noexcept
+{
+    if (level >= NB_LEVELS || pu_os_index >= MAX_CPUS)
+    {
+        return nullptr;
+    }
+
+    auto idx = impl_->owner[level][pu_os_index];
+    if (idx < 0)
+    {
+        return nullptr;
+    }
+
+    return &objects_[level][idx];
+}
+
+CpuSet Topology::smt_siblings(unsigned pu_os_index) const noexcept
+{
+    auto core = object_of(CORE, pu_os_index);
+    if (!core)
+    {
+        return {};
+    }
+
+    return core->cpuset;
+}
+
+const CpuSet& Topology::online_cpus() const noexcept
+{
+    return online_;
+}
+
+void* Topology::native_handle() const noexcept
+{
+#if HAVE_HWLOC == 1
+    return impl_->topology;
+#else
+    return nullptr;
+#endif
+}
+
+#if HAVE_HWLOC == 1
+bool Topology::bind(const CpuSet& cpuset) const
+{
+    auto set = Impl::to_bitmap(cpuset);
+    auto result = impl_->bind(set);
+    hwloc_bitmap_free(set);
+    return result;
+}
+
+bool Topology::bind(const CpuSet& cpuset, std::thread& thread) const
+{
+    auto set = Impl::to_bitmap(cpuset);
+    auto result = impl_->bind(set, thread);
+    hwloc_bitmap_free(set);
+    return result;
+}
+
+bool Topology::bind_to_core(int core) const
+{
+    return impl_->bind_nth(impl_->core_bind_sets, core, nullptr);
+}
+
+bool Topology::bind_to_core(int core, std::thread& thread) const
+{
+    return impl_->bind_nth(impl_->core_bind_sets, core, &thread);
+}
+
+bool Topology::bind_to_pu(int pu) const
+{
+    return impl_->bind_nth(impl_->pu_bind_sets, pu, nullptr);
+}
+
+bool Topology::bind_to_pu(int pu, std::thread& thread) const
+{
+    return impl_->bind_nth(impl_->pu_bind_sets, pu, &thread);
+}
+#else
+bool Topology::bind(const CpuSet&) const
+{
+    return false;
+}
+
+bool Topology::bind(const CpuSet&, std::thread&) const
+{
+    return false;
+}
+
+bool Topology::bind_to_core(int) const
+{
+    return false;
+}
+
+bool Topology::bind_to_core(int, std::thread&) const
+{
+    return false;
+}
+
+bool Topology::bind_to_pu(int) const
+{
+    return false;
+}
+
+bool Topology::bind_to_pu(int, std::thread&) const
+{
+    return false;
+}
+#endif
+
+} // namespace thread
+} // namespace commonpp
@@ -0,0 +1,108 @@
+/*
+ * File: tests/core/async_logging.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// whatever the configured floor is
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+using namespace commonpp;
+
+CREATE_LOGGER(test_logger, "test");
+
+static size_t count_lines(const std::stringstream& out)
+{
+    std::istringstream in(out.str());
+    std::string line;
+    size_t lines = 0;
+    while (std::getline(in, line))
+    {
+        ++lines;
+    }
+    return lines;
+}
+
+BOOST_AUTO_TEST_CASE(async_console_sink)
+{
+    static constexpr size_t NB_THREADS = 4;
+    static constexpr size_t NB_RECORDS = 5000;
+
+    std::stringstream out;
+    auto cout_buffer = std::cout.rdbuf(out.rdbuf());
+
+    core::init_logging();
+    core::enable_console_logging();
+
+    core::AsyncLoggingOptions options;
+    options.queue_size = 64;
+    options.overflow = core::OverflowPolicy::DropNewest;
+    core::enable_async_logging(options);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < NB_THREADS; ++i)
+    {
+        threads.emplace_back(
+            []
+            {
+                for (size_t j = 0; j < NB_RECORDS; ++j)
+                {
+                    LOG(test_logger, debug) << "record " << j;
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    boost::log::core::get()->flush();
+
+    auto stats = core::async_logging_stats();
+    BOOST_CHECK_EQUAL(stats.capacity, 64u);
+    BOOST_CHECK_EQUAL(stats.dropped, stats.dropped_by_level[debug]);
+    BOOST_CHECK_EQUAL(count_lines(out) + stats.dropped, NB_THREADS * NB_RECORDS);
+
+    // synchronous again, nothing is lost
+    core::disable_async_logging();
+    LOG(test_logger, info) << "synchronous";
+    boost::log::core::get()->flush();
+    BOOST_CHECK_EQUAL(count_lines(out) + stats.dropped, NB_THREADS * NB_RECORDS + 1);
+
+    core::enable_async_logging();
+    for (size_t j = 0; j < NB_RECORDS; ++j)
+    {
+        LOG(test_logger, info) << "blocking " << j;
+    }
+    boost::log::core::get()->flush();
+    BOOST_CHECK_EQUAL(core::async_logging_stats().dropped, 0u);
+    BOOST_CHECK_EQUAL(count_lines(out) + stats.dropped,
+                      (NB_THREADS + 1) * NB_RECORDS + 1);
+
+    // the removed sinks are not added back
+    core::remove_all_sinks();
+    auto before = count_lines(out);
+    core::enable_async_logging();
+    LOG(test_logger, info) << "no sink";
+    boost::log::core::get()->flush();
+    BOOST_CHECK_EQUAL(count_lines(out), before);
+
+    core::disable_async_logging();
+    std::cout.rdbuf(cout_buffer);
+}
@@ -0,0 +1,77 @@
+/*
+ * File: tests/core/capture.hpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+namespace capture
+{
+
+// the console sink is only added once, by the global fixture
+inline std::stringstream out;
+
+// BOOST_GLOBAL_FIXTURE: the records written to the console go to out
+struct Console
+{
+    Console()
+    : cout_buffer(std::cout.rdbuf(out.rdbuf()))
+    {
+        commonpp::core::init_logging();
+        commonpp::core::enable_console_logging();
+    }
+
+    ~Console()
+    {
+        commonpp::core::remove_all_sinks();
+        std::cout.rdbuf(cout_buffer);
+    }
+
+    std::streambuf* cout_buffer;
+};
+
+// The records written since the last call, of a channel when one is given.
+// Boost.Test writes to std::cout as well.
+inline std::vector<std::string> lines(const std::string& channel = {})
+{
+    boost::log::core::get()->flush();
+    std::istringstream in(out.str());
+    std::vector<std::string> lines;
+    std::string line;
+    auto tag = "][" + channel + "][";
+    while (std::getline(in, line))
+    {
+        if (line.find("]: ") != std::string::npos &&
+            (channel.empty() || line.find(tag) != std::string::npos))
+        {
+            lines.push_back(line);
+        }
+    }
+    out.str("");
+    return lines;
+}
+
+// the messages of the records, see lines()
+inline std::vector<std::string> messages(const std::string& channel = {})
+{
+    auto messages = lines(channel);
+    for (auto& message : messages)
+    {
+        message.erase(0, message.find("]: ") + 3);
+    }
+    return messages;
+}
+
+} // namespace capture
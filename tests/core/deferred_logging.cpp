@@ -0,0 +1,209 @@
+/*
+ * File: tests/core/deferred_logging.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// whatever the configured floor is
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <commonpp/core/DeferredLogging.hpp>
+#include <commonpp/thread/Thread.hpp>
+
+#include "capture.hpp"
+
+using namespace commonpp;
+
+CREATE_DEFERRED_LOGGER(deferred_logger, "deferred");
+
+namespace
+{
+struct Point
+{
+    int x;
+    int y;
+};
+
+std::ostream& operator<<(std::ostream& os, const Point& p)
+{
+    return os << "(" << p.x << ", " << p.y << ")";
+}
+
+// logs while the record it is streamed in is being built
+struct Noisy
+{
+};
+
+std::ostream& operator<<(std::ostream& os, const Noisy&)
+{
+    LOG(deferred_logger, warning) << "nested " << 1;
+    return os << "noisy";
+}
+
+// the records still in the rings are written before the sinks go
+struct DeferredCapture : capture::Console
+{
+    ~DeferredCapture()
+    {
+        core::flush_deferred_logging();
+    }
+};
+
+bool ends_with(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+} // namespace
+
+BOOST_GLOBAL_FIXTURE(DeferredCapture);
+
+BOOST_AUTO_TEST_CASE(deferred_arguments)
+{
+    thread::set_current_thread_name("producer");
+
+    std::string name = "temporary";
+    const char* c_str = "c string";
+    LOG(deferred_logger, info)
+        << "int " << -42 << " uint " << 42u << " double " << 1.5 << " bool "
+        << true << " char " << 'c' << " hex " << std::hex << 255 << std::dec
+        << " " << name << " " << c_str << " " << std::setw(4)
+        << std::setfill('0') << 7 << " " << Point{1, 2} << " " << warning;
+    name = "overwritten";
+
+    LOG(deferred_logger, debug) << "flags are reset " << 255;
+
+    core::flush_deferred_logging();
+
+    auto lines = capture::lines("deferred");
+    BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+    BOOST_CHECK(ends_with(lines[0],
+                          "int -42 uint 42 double 1.5 bool true char c hex ff "
+                          "temporary c string 0007 (1, 2) warning"));
+    BOOST_CHECK(lines[0].find("[info][deferred][producer]") != std::string::npos);
+    BOOST_CHECK(ends_with(lines[1], "flags are reset 255"));
+
+    auto stats = core::deferred_logging_stats();
+    BOOST_CHECK_EQUAL(stats.decoded, 2u);
+    BOOST_CHECK_EQUAL(stats.dropped, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(deferred_levels)
+{
+    core::set_logging_level_for_channel("deferred", warning);
+    LOG(deferred_logger, info) << "filtered";
+    LOG(deferred_logger, error) << "kept";
+    core::set_logging_level_for_channel("deferred", trace);
+
+    core::flush_deferred_logging();
+    auto lines = capture::lines("deferred");
+    BOOST_REQUIRE_EQUAL(lines.size(), 1u);
+    BOOST_CHECK(ends_with(lines[0], "kept"));
+}
+
+BOOST_AUTO_TEST_CASE(deferred_threads)
+{
+    static constexpr size_t NB_THREADS = 4;
+    static constexpr size_t NB_RECORDS = 20000;
+
+    auto before = core::deferred_logging_stats();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < NB_THREADS; ++i)
+    {
+        threads.emplace_back(
+            [i]
+            {
+                for (size_t j = 0; j < NB_RECORDS; ++j)
+                {
+                    LOG(deferred_logger, info) << "thread " << i << " record " << j;
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    core::flush_deferred_logging();
+
+    auto stats = core::deferred_logging_stats();
+    auto decoded = stats.decoded - before.decoded;
+    BOOST_CHECK_EQUAL(decoded + stats.dropped - before.dropped,
+                      NB_THREADS * NB_RECORDS);
+    BOOST_CHECK_EQUAL(capture::lines("deferred").size(), decoded);
+}
+
+BOOST_AUTO_TEST_CASE(deferred_sampling)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        LOG_EVERY_N(deferred_logger, info, 2) << "record " << i;
+    }
+
+    core::flush_deferred_logging();
+    auto lines = capture::lines("deferred");
+    BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+    BOOST_CHECK(ends_with(lines[1], "[suppressed 1 messages] record 2"));
+}
+
+BOOST_AUTO_TEST_CASE(deferred_nested_record)
+{
+    LOG(deferred_logger, error) << "outer " << 1 << " " << Noisy{} << " " << 2;
+
+    core::flush_deferred_logging();
+    auto lines = capture::lines("deferred");
+    BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+    BOOST_CHECK(lines[0].find("[warning][deferred]") != std::string::npos);
+    BOOST_CHECK(ends_with(lines[0], "nested 1"));
+    BOOST_CHECK(lines[1].find("[error][deferred]") != std::string::npos);
+    BOOST_CHECK(ends_with(lines[1], "outer 1 noisy 2"));
+}
+
+BOOST_AUTO_TEST_CASE(deferred_char_pointers)
+{
+    std::string str = "bytes";
+    auto bytes = reinterpret_cast<const unsigned char*>(str.c_str());
+    auto signed_bytes = reinterpret_cast<const signed char*>(str.c_str());
+    const unsigned char* null = nullptr;
+    LOG(deferred_logger, info) << bytes << " " << signed_bytes << " " << null;
+    str = "freed";
+    str.shrink_to_fit();
+
+    core::flush_deferred_logging();
+    auto lines = capture::lines("deferred");
+    BOOST_REQUIRE_EQUAL(lines.size(), 1u);
+    BOOST_CHECK(ends_with(lines[0], "bytes bytes (null)"));
+}
+
+BOOST_AUTO_TEST_CASE(deferred_renamed_thread)
+{
+    std::thread(
+        []
+        {
+            thread::set_current_thread_name("before");
+            LOG(deferred_logger, info) << "first";
+            thread::set_current_thread_name("after");
+            LOG(deferred_logger, info) << "second";
+        })
+        .join();
+
+    core::flush_deferred_logging();
+    auto lines = capture::lines("deferred");
+    BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+    BOOST_CHECK(lines[0].find("[deferred][before]") != std::string::npos);
+    BOOST_CHECK(lines[1].find("[deferred][after]") != std::string::npos);
+}
@@ -0,0 +1,169 @@
+/*
+ * File: tests/core/flight_recorder.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// whatever the configured floor is
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <csignal>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+
+#include <commonpp/core/StructuredLogging.hpp>
+#include <commonpp/thread/Thread.hpp>
+
+using namespace commonpp;
+namespace fs = boost::filesystem;
+
+CREATE_LOGGER(recorded_logger, "recorded");
+
+namespace
+{
+bool contains(const std::string& str, const std::string& what)
+{
+    return str.find(what) != std::string::npos;
+}
+
+// the recorder is enabled once per process
+struct Recorder
+{
+    Recorder()
+    : path(fs::temp_directory_path() / fs::unique_path())
+    {
+        core::init_logging();
+        core::set_logging_level(info);
+        json = boost::make_shared<std::stringstream>();
+        core::add_json_sink(json);
+
+        core::FlightRecorderOptions options;
+        options.ring_size = 4096;
+        options.path = path.string();
+        options.signal = SIGUSR2;
+        core::enable_flight_recorder(options);
+    }
+
+    ~Recorder()
+    {
+        fs::remove(path);
+    }
+
+    std::string read_dump()
+    {
+        std::ifstream file(path.string());
+        std::string content((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+        fs::remove(path);
+        return content;
+    }
+
+    fs::path path;
+    boost::shared_ptr<std::stringstream> json;
+};
+
+Recorder& recorder()
+{
+    static Recorder recorder;
+    return recorder;
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(captures_all_levels)
+{
+    auto& rec = recorder();
+    thread::set_current_thread_name("recorder-main");
+
+    LOG(recorded_logger, trace) << "trace context";
+    LOG(recorded_logger, info) << "logged";
+    std::thread([] {
+        thread::set_current_thread_name("recorder-other");
+        LOG(recorded_logger, debug) << "other thread";
+    }).join();
+    boost::log::core::get()->flush();
+
+    // the other sinks still follow the logging level
+    auto json = rec.json->str();
+    BOOST_CHECK(contains(json, "\"message\":\"logged\""));
+    BOOST_CHECK(!contains(json, "trace context"));
+    BOOST_CHECK(!contains(json, "other thread"));
+
+    BOOST_CHECK_EQUAL(core::dump_flight_recorder(), 3u);
+    auto dump = rec.read_dump();
+    BOOST_CHECK(contains(dump, "--- flight recorder dump: requested ---\n"));
+    BOOST_CHECK(contains(dump, " [trace][recorded][recorder-main]: trace context\n"));
+    BOOST_CHECK(contains(dump, " [debug][recorded][recorder-other]: other thread\n"));
+    BOOST_CHECK_LT(dump.find("trace context"), dump.find("]: logged"));
+}
+
+BOOST_AUTO_TEST_CASE(captured_without_record)
+{
+    auto& rec = recorder();
+
+    // any sink, without the commonpp filter
+    auto sink = boost::make_shared<
+        boost::log::sinks::synchronous_sink<boost::log::sinks::text_ostream_backend>>();
+    auto stream = boost::make_shared<std::stringstream>();
+    sink->locked_backend()->add_stream(stream);
+    sink->set_formatter(boost::log::expressions::stream
+                        << boost::log::expressions::smessage);
+    boost::log::core::get()->add_sink(sink);
+
+    LOG(recorded_logger, debug) << "captured " << std::hex << 255;
+    LOG(recorded_logger, debug) << "flags reset " << 255;
+    GLOG(trace) << "global";
+    boost::log::core::get()->remove_sink(sink);
+
+    BOOST_CHECK(stream->str().empty());
+
+    core::dump_flight_recorder();
+    auto dump = rec.read_dump();
+    BOOST_CHECK(contains(dump, " [debug][recorded][recorder-main]: captured ff\n"));
+    BOOST_CHECK(contains(dump, "]: flags reset 255\n"));
+    BOOST_CHECK(contains(dump, " [trace][N/A][recorder-main]: global\n"));
+}
+
+BOOST_AUTO_TEST_CASE(ring_keeps_the_last_records)
+{
+    auto& rec = recorder();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        LOG(recorded_logger, trace) << "record " << i;
+    }
+
+    core::dump_flight_recorder();
+    auto dump = rec.read_dump();
+    BOOST_CHECK(contains(dump, "]: record 999\n"));
+    BOOST_CHECK(!contains(dump, "]: record 0\n"));
+    BOOST_CHECK_LT(dump.find("]: record 998\n"), dump.find("]: record 999\n"));
+}
+
+BOOST_AUTO_TEST_CASE(dump_on_signal)
+{
+    auto& rec = recorder();
+
+    LOG(recorded_logger, debug) << "before the signal";
+    std::raise(SIGUSR2);
+
+    auto dump = rec.read_dump();
+    BOOST_CHECK(contains(dump, "--- flight recorder dump: signal ---\n"));
+    BOOST_CHECK(contains(dump, "[debug][recorded]"));
+    BOOST_CHECK(contains(dump, "]: before the signal\n"));
+}
@@ -0,0 +1,177 @@
+/*
+ * File: tests/core/gelf_sink.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// whatever the configured floor is
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <string>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+using namespace commonpp;
+using boost::asio::ip::udp;
+
+CREATE_LOGGER(gelf_logger, "gelf");
+
+namespace
+{
+struct Listener
+{
+    Listener()
+    : socket(service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+    {
+        core::init_logging();
+    }
+
+    ~Listener()
+    {
+        core::remove_all_sinks();
+    }
+
+    std::string port() const
+    {
+        return std::to_string(socket.local_endpoint().port());
+    }
+
+    std::string receive()
+    {
+        std::string datagram(65536, '\0');
+        datagram.resize(socket.receive(boost::asio::buffer(&datagram[0], datagram.size())));
+        return datagram;
+    }
+
+    boost::asio::io_service service;
+    udp::socket socket;
+};
+
+bool contains(const std::string& str, const std::string& what)
+{
+    return str.find(what) != std::string::npos;
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(gelf_message)
+{
+    Listener listener;
+    core::GelfOptions options;
+    options.host = "test-host";
+    core::add_gelf_sink("127.0.0.1", listener.port(),
+                        {{"app", "commonpp"}, {"_env", "test"}}, options);
+
+    LOG(gelf_logger, warning) << "hello \"gelf\"\n";
+    boost::log::core::get()->flush();
+
+    auto message = listener.receive();
+    BOOST_CHECK_EQUAL(message.front(), '{');
+    BOOST_CHECK_EQUAL(message.back(), '}');
+    BOOST_CHECK(contains(message, "\"version\":\"1.1\",\"host\":\"test-host\""));
+    BOOST_CHECK(contains(message, "\"short_message\":\"hello \\\"gelf\\\"\\n\""));
+    BOOST_CHECK(contains(message, "\"level\":4"));
+    BOOST_CHECK(contains(message, "\"timestamp\":"));
+    BOOST_CHECK(contains(message, "\"_channel\":\"gelf\""));
+    BOOST_CHECK(contains(message, "\"_app\":\"commonpp\",\"_env\":\"test\"}"));
+}
+
+BOOST_AUTO_TEST_CASE(gelf_chunks)
+{
+    Listener listener;
+    core::GelfOptions options;
+    options.max_chunk_size = 512;
+    core::add_gelf_sink("127.0.0.1", listener.port(), {}, options);
+
+    const std::string long_message(3000, 'x');
+    LOG(gelf_logger, info) << long_message;
+    boost::log::core::get()->flush();
+
+    std::map<int, std::string> chunks;
+    size_t nb_chunks = 0;
+    std::string id;
+    do
+    {
+        auto chunk = listener.receive();
+        BOOST_REQUIRE_GT(chunk.size(), 12u);
+        BOOST_REQUIRE_LE(chunk.size(), 512u);
+        BOOST_CHECK_EQUAL(chunk[0], 0x1e);
+        BOOST_CHECK_EQUAL(chunk[1], 0x0f);
+        if (id.empty())
+        {
+            id = chunk.substr(2, 8);
+        }
+        BOOST_CHECK(chunk.substr(2, 8) == id);
+        nb_chunks = static_cast<unsigned char>(chunk[11]);
+        chunks[chunk[10]] = chunk.substr(12);
+    } while (chunks.size() < nb_chunks);
+
+    std::string message;
+    for (const auto& chunk : chunks)
+    {
+        message += chunk.second;
+    }
+    BOOST_CHECK(contains(message, "\"short_message\":\"" + long_message + "\""));
+    BOOST_CHECK_EQUAL(message.back(), '}');
+}
+
+BOOST_AUTO_TEST_CASE(gelf_send_errors)
+{
+    std::string port;
+    {
+        // nobody listens on it anymore
+        Listener listener;
+        port = listener.port();
+    }
+    Listener listener;
+    core::add_gelf_sink("127.0.0.1", port);
+
+    // the refusal of the first datagram fails the next ones
+    auto before = core::gelf_stats().send_errors;
+    for (int i = 0; i < 100 && core::gelf_stats().send_errors == before; ++i)
+    {
+        LOG(gelf_logger, info) << "refused " << i;
+        boost::log::core::get()->flush();
+    }
+    BOOST_CHECK_GT(core::gelf_stats().send_errors, before);
+}
+
+#if HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(gelf_compression)
+{
+    Listener listener;
+    core::GelfOptions options;
+    options.compress = true;
+    core::add_gelf_sink("127.0.0.1", listener.port(), {}, options);
+
+    LOG(gelf_logger, error) << "compressed";
+    boost::log::core::get()->flush();
+
+    auto compressed = listener.receive();
+    BOOST_CHECK_EQUAL(static_cast<unsigned char>(compressed[0]), 0x78);
+
+    std::string message(4096, '\0');
+    uLongf size = message.size();
+    BOOST_REQUIRE_EQUAL(uncompress(reinterpret_cast<Bytef*>(&message[0]), &size,
+                                   reinterpret_cast<const Bytef*>(compressed.data()),
+                                   compressed.size()),
+                        Z_OK);
+    message.resize(size);
+    BOOST_CHECK(contains(message, "\"short_message\":\"compressed\""));
+    BOOST_CHECK(contains(message, "\"level\":3"));
+}
+#endif
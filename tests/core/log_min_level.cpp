@@ -0,0 +1,80 @@
+/*
+ * File: tests/core/log_min_level.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::info
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/log/core.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+using namespace commonpp;
+
+CREATE_LOGGER(test_logger, "test");
+
+static int evaluated = 0;
+
+static int side_effect()
+{
+    return ++evaluated;
+}
+
+BOOST_AUTO_TEST_CASE(statements_below_the_floor_are_not_evaluated)
+{
+    // accepts every record, without a sink no record would be opened anyway
+    auto sink = boost::make_shared<
+        boost::log::sinks::synchronous_sink<boost::log::sinks::text_ostream_backend>>();
+    boost::log::core::get()->add_sink(sink);
+
+    LOG(test_logger, trace) << side_effect();
+    LOG(test_logger, debug) << side_effect();
+    GLOG(debug) << side_effect();
+    TRACE_LOG(test_logger, trace) << side_effect();
+    LOG_SEV(test_logger, debug) << side_effect();
+    BOOST_CHECK_EQUAL(evaluated, 0);
+
+    LOG(test_logger, info) << side_effect();
+    GLOG(error) << side_effect();
+    BOOST_CHECK_EQUAL(evaluated, 2);
+
+    // still usable as a single statement
+    if (evaluated == 2)
+        LOG(test_logger, warning) << side_effect();
+    else
+        BOOST_FAIL("unreachable");
+    BOOST_CHECK_EQUAL(evaluated, 3);
+
+    boost::log::core::get()->remove_sink(sink);
+}
+
+static size_t scope_depth()
+{
+    return boost::log::attributes::named_scope::get_scopes().size();
+}
+
+BOOST_AUTO_TEST_CASE(no_scope_below_the_floor)
+{
+    auto depth = scope_depth();
+    TRACE_LOG(test_logger, trace) << side_effect();
+    TRACE(debug) << side_effect();
+    DTRACE_LOG(test_logger, trace) << side_effect();
+    BOOST_CHECK_EQUAL(scope_depth(), depth);
+
+    {
+        TRACE_LOG(test_logger, info) << "scoped";
+        BOOST_CHECK_EQUAL(scope_depth(), depth + 1);
+    }
+    BOOST_CHECK_EQUAL(scope_depth(), depth);
+}
@@ -0,0 +1,144 @@
+/*
+ * File: tests/core/log_sampling.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// whatever the configured floor is
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+#include "capture.hpp"
+
+using namespace commonpp;
+
+CREATE_LOGGER(sampled_logger, "sampled");
+
+namespace
+{
+using Capture = capture::Console;
+
+int evaluated = 0;
+
+int evaluate(int i)
+{
+    ++evaluated;
+    return i;
+}
+} // namespace
+
+BOOST_GLOBAL_FIXTURE(Capture);
+
+BOOST_AUTO_TEST_CASE(every_n)
+{
+    evaluated = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        LOG_EVERY_N(sampled_logger, info, 3) << "record " << evaluate(i);
+    }
+
+    auto lines = capture::messages();
+    BOOST_REQUIRE_EQUAL(lines.size(), 4u);
+    BOOST_CHECK_EQUAL(lines[0], "record 0");
+    BOOST_CHECK_EQUAL(lines[1], "[suppressed 2 messages] record 3");
+    BOOST_CHECK_EQUAL(lines[3], "[suppressed 2 messages] record 9");
+    BOOST_CHECK_EQUAL(evaluated, 4);
+}
+
+BOOST_AUTO_TEST_CASE(first_n)
+{
+    for (int i = 0; i < 10; ++i)
+    {
+        GLOG_FIRST_N(warning, 2) << "record " << i;
+    }
+
+    auto lines = capture::messages();
+    BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+    BOOST_CHECK_EQUAL(lines[1], "record 1");
+}
+
+BOOST_AUTO_TEST_CASE(every_t)
+{
+    auto log = [](int i)
+    { LOG_EVERY_T(sampled_logger, error, std::chrono::milliseconds(100)) << "record " << i; };
+
+    for (int i = 0; i < 10; ++i)
+    {
+        log(i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    log(10);
+
+    auto lines = capture::messages();
+    BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+    BOOST_CHECK_EQUAL(lines[0], "record 0");
+    BOOST_CHECK_EQUAL(lines[1], "[suppressed 9 messages] record 10");
+}
+
+BOOST_AUTO_TEST_CASE(rate_limited)
+{
+    evaluated = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        LOG_RATE_LIMITED(sampled_logger, info, 1, 5) << "record " << evaluate(i);
+    }
+
+    BOOST_CHECK_EQUAL(capture::messages().size(), 5u);
+    BOOST_CHECK_EQUAL(evaluated, 5);
+}
+
+BOOST_AUTO_TEST_CASE(rate_limited_without_rate)
+{
+    evaluated = 0;
+    for (int i = 0; i < 10; ++i)
+    {
+        LOG_RATE_LIMITED(sampled_logger, info, 0, 5) << "record " << evaluate(i);
+        LOG_RATE_LIMITED(sampled_logger, info, -1, 5) << "record " << evaluate(i);
+    }
+
+    BOOST_CHECK(capture::messages().empty());
+    BOOST_CHECK_EQUAL(evaluated, 0);
+}
+
+BOOST_AUTO_TEST_CASE(rate_limited_extreme_values)
+{
+    for (int i = 0; i < 10; ++i)
+    {
+        LOG_RATE_LIMITED(sampled_logger, info, 1e-300, 2) << "record " << i;
+    }
+    BOOST_CHECK_EQUAL(capture::messages().size(), 2u);
+
+    // the tolerance is clamped as well
+    for (int i = 0; i < 10; ++i)
+    {
+        LOG_RATE_LIMITED(sampled_logger, info, 1e-9, UINT64_MAX) << "record " << i;
+    }
+    auto lines = capture::messages();
+    BOOST_CHECK_GE(lines.size(), 1u);
+    BOOST_CHECK_LT(lines.size(), 10u);
+}
+
+BOOST_AUTO_TEST_CASE(disabled_statements_are_not_counted)
+{
+    core::set_logging_level_for_channel("sampled", warning);
+    for (int i = 0; i < 10; ++i)
+    {
+        LOG_EVERY_N(sampled_logger, info, 2) << "record " << evaluate(i);
+    }
+    core::set_logging_level_for_channel("sampled", trace);
+
+    BOOST_CHECK(capture::messages().empty());
+}
@@ -0,0 +1,70 @@
+/*
+ * File: tests/core/logger_level.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <boost/log/core.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+using namespace commonpp;
+
+CREATE_LOGGER(alpha_logger, "alpha");
+
+static int evaluated = 0;
+
+static int side_effect()
+{
+    return ++evaluated;
+}
+
+BOOST_AUTO_TEST_CASE(cached_levels_follow_the_configuration)
+{
+    auto sink = boost::make_shared<
+        boost::log::sinks::synchronous_sink<boost::log::sinks::text_ostream_backend>>();
+    boost::log::core::get()->add_sink(sink);
+
+    BOOST_CHECK(alpha_logger.is_enabled(trace));
+
+    core::set_logging_level(info);
+    BOOST_CHECK(!alpha_logger.is_enabled(debug));
+    BOOST_CHECK(alpha_logger.is_enabled(info));
+    BOOST_CHECK(!core::global_logger.is_enabled(debug));
+
+    LOG(alpha_logger, debug) << side_effect();
+    GLOG(debug) << side_effect();
+    BOOST_CHECK_EQUAL(evaluated, 0);
+
+    core::set_logging_level_for_channel("alpha", error);
+    core::set_logging_level_for_channel("beta", trace);
+    BOOST_CHECK(!alpha_logger.is_enabled(warning));
+    BOOST_CHECK(alpha_logger.is_enabled(error));
+
+    // the global level still applies, and to loggers created later
+    core::Logger beta(COMPONENT("beta"));
+    BOOST_CHECK(!beta.is_enabled(debug));
+    BOOST_CHECK(beta.is_enabled(info));
+
+    LOG(beta, info) << side_effect();
+    LOG(alpha_logger, warning) << side_effect();
+    BOOST_CHECK_EQUAL(evaluated, 1);
+
+    core::set_logging_level(trace);
+    BOOST_CHECK(beta.is_enabled(trace));
+    BOOST_CHECK(!alpha_logger.is_enabled(warning));
+
+    boost::log::core::get()->remove_sink(sink);
+}
@@ -0,0 +1,210 @@
+/*
+ * File: tests/core/mapped_file_sink.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// whatever the configured floor is
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+using namespace commonpp;
+namespace fs = boost::filesystem;
+
+CREATE_LOGGER(mapped_logger, "mapped");
+
+namespace
+{
+struct TempDirectory
+{
+    TempDirectory()
+    : path(fs::temp_directory_path() / fs::unique_path())
+    {
+        fs::create_directories(path);
+        core::init_logging();
+    }
+
+    ~TempDirectory()
+    {
+        // stops the thread of the sink
+        core::remove_all_sinks();
+
+        boost::system::error_code error;
+        fs::remove_all(path, error);
+    }
+
+    fs::path path;
+};
+
+std::string segment(const std::string& prefix, unsigned index)
+{
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), ".%06u.log", index);
+    return prefix + suffix;
+}
+
+const std::string TRAILER_MARKER("\0cpplog\1", 8);
+
+// an open segment as the sink leaves it: its length and marker at the end
+std::string open_segment(const std::string& content, size_t length, size_t size)
+{
+    auto segment = content + std::string(size - content.size() - 16, '\0');
+    for (int i = 0; i < 8; ++i)
+    {
+        segment += static_cast<char>((length >> (8 * i)) & 0xff);
+    }
+    return segment + TRAILER_MARKER;
+}
+
+std::string read_file(const fs::path& path)
+{
+    std::ifstream file(path.string(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+// the content of a segment, up to the committed length when still open
+std::string read_segment(const fs::path& path)
+{
+    auto content = read_file(path);
+    if (content.size() < 16 || content.substr(content.size() - 8) != TRAILER_MARKER)
+    {
+        return content;
+    }
+
+    uint64_t length = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        auto byte = static_cast<unsigned char>(content[content.size() - 16 + i]);
+        length = (length << 8) | byte;
+    }
+    return content.substr(0, length);
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(mapped_segments)
+{
+    TempDirectory directory;
+    auto prefix = (directory.path / "test").string();
+
+    core::MappedFileOptions options;
+    options.segment_size = 4096;
+    options.sync_period = std::chrono::milliseconds(1);
+    core::add_mapped_file_sink(prefix, options);
+
+    const int nb_lines = 500;
+    for (int i = 0; i < nb_lines; ++i)
+    {
+        LOG(mapped_logger, info) << "line " << i;
+    }
+    boost::log::core::get()->flush();
+
+    int expected = 0;
+    size_t nb_segments = 0;
+    for (unsigned index = 1; fs::exists(segment(prefix, index)); ++index)
+    {
+        auto content = read_segment(segment(prefix, index));
+        if (content.empty())
+        {
+            // the one prepared ahead
+            continue;
+        }
+
+        ++nb_segments;
+        BOOST_CHECK_LE(content.size(), 4096u);
+        BOOST_CHECK_EQUAL(content.back(), '\n');
+
+        std::istringstream lines(content);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            BOOST_CHECK(line.find("[info][mapped]") != std::string::npos);
+            auto number = "]: line " + std::to_string(expected);
+            BOOST_CHECK_EQUAL(line.substr(line.size() - number.size()), number);
+            ++expected;
+        }
+    }
+
+    BOOST_CHECK_EQUAL(expected, nb_lines);
+    BOOST_CHECK_GT(nb_segments, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(mapped_recovery)
+{
+    TempDirectory directory;
+    auto prefix = (directory.path / "recover").string();
+
+    // left open by a crash while a record was being written
+    {
+        std::ofstream crashed(segment(prefix, 1), std::ios::binary);
+        crashed << open_segment("a\nb\npartial", 4, 1024);
+    }
+
+    // closed, with a record holding a NUL
+    const std::string closed("c\nd\0e\n", 6);
+    {
+        std::ofstream file(segment(prefix, 2), std::ios::binary);
+        file << closed;
+    }
+
+    core::MappedFileOptions options;
+    options.segment_size = 4096;
+    core::add_mapped_file_sink(prefix, options);
+
+    BOOST_CHECK_EQUAL(read_file(segment(prefix, 1)), "a\nb\n");
+    BOOST_CHECK(read_file(segment(prefix, 2)) == closed);
+    BOOST_CHECK(fs::exists(segment(prefix, 3)));
+}
+
+BOOST_AUTO_TEST_CASE(mapped_segment_creation_failure)
+{
+    TempDirectory directory;
+    auto prefix = (directory.path / "failing").string();
+
+    core::MappedFileOptions options;
+    options.segment_size = 4096;
+    core::add_mapped_file_sink(prefix, options);
+
+    // the second segment is prepared ahead, the third cannot be created
+    while (!fs::exists(segment(prefix, 2)))
+    {
+        std::this_thread::yield();
+    }
+    fs::remove_all(directory.path);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        LOG(mapped_logger, info) << "lost " << i;
+    }
+
+    fs::create_directories(directory.path);
+    for (int i = 0; i < 10; ++i)
+    {
+        LOG(mapped_logger, info) << "after " << i;
+    }
+    boost::log::core::get()->flush();
+
+    auto content = read_segment(segment(prefix, 3));
+    BOOST_CHECK_EQUAL(content.compare(0, 10, "commonpp: "), 0);
+    BOOST_CHECK(content.find(" records dropped, cannot create a segment: ") !=
+                std::string::npos);
+    BOOST_CHECK(content.find("]: after 9\n") != std::string::npos);
+}
@@ -0,0 +1,146 @@
+/*
+ * File: tests/core/rotated_files.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+using namespace commonpp;
+namespace fs = boost::filesystem;
+
+namespace
+{
+
+struct TempDirectory
+{
+    TempDirectory()
+    : path(fs::temp_directory_path() / fs::unique_path())
+    {
+        fs::create_directories(path);
+        core::init_logging();
+    }
+
+    ~TempDirectory()
+    {
+        core::remove_all_sinks();
+
+        boost::system::error_code error;
+        fs::remove_all(path, error);
+    }
+
+    fs::path path;
+};
+
+// a file left by a previous run
+void write_file(const fs::path& path, const std::string& content, std::time_t time = 0)
+{
+    std::ofstream(path.string(), std::ios::binary) << content;
+    if (time)
+    {
+        fs::last_write_time(path, time);
+    }
+}
+
+template <typename Predicate>
+bool wait_for(Predicate predicate)
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (predicate())
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+} // namespace
+
+#if HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(compress_closed_files)
+{
+    TempDirectory directory;
+    std::string content;
+    for (int i = 0; i < 10000; ++i)
+    {
+        content += "a line of the previous run " + std::to_string(i) + "\n";
+    }
+    write_file(directory.path / "app_42.log", content);
+    write_file(directory.path / "app_43.log.gz.tmp", "interrupted");
+    write_file(directory.path / "other.log", "not rotated");
+
+    auto before = core::rotated_files_stats();
+    core::add_file_sink_rotate((directory.path / "app_%N.log").string(), 1024,
+                               boost::posix_time::hours(1), core::RotatedFilesOptions());
+
+    auto compressed = directory.path / "app_42.log.gz";
+    BOOST_REQUIRE(wait_for([&] { return fs::exists(compressed); }));
+    BOOST_REQUIRE(wait_for([] { return core::rotated_files_stats().pending == 0; }));
+
+    auto stats = core::rotated_files_stats();
+    BOOST_CHECK_GE(stats.compressed, before.compressed + 1);
+    BOOST_CHECK_GE(stats.bytes_read, before.bytes_read + content.size());
+    BOOST_CHECK_EQUAL(stats.errors, before.errors);
+    BOOST_CHECK(!fs::exists(directory.path / "app_42.log"));
+    BOOST_CHECK(!fs::exists(directory.path / "app_43.log.gz.tmp"));
+    BOOST_CHECK(fs::exists(directory.path / "other.log"));
+    BOOST_CHECK_LT(fs::file_size(compressed), content.size());
+
+    auto file = gzopen(compressed.string().c_str(), "rb");
+    BOOST_REQUIRE(file);
+    std::string decompressed(content.size() + 1, '\0');
+    auto read = gzread(file, &decompressed[0], decompressed.size());
+    gzclose(file);
+    decompressed.resize(read > 0 ? read : 0);
+    BOOST_CHECK(decompressed == content);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(retention_limits)
+{
+    TempDirectory directory;
+    auto now = std::time(nullptr);
+    write_file(directory.path / "app_1.log", std::string(1000, 'a'), now - 3 * 24 * 3600);
+    write_file(directory.path / "app_2.log", std::string(1000, 'b'), now - 300);
+    write_file(directory.path / "app_3.log", std::string(1000, 'c'), now - 200);
+    write_file(directory.path / "app_4.log", std::string(1000, 'd'), now - 100);
+
+    core::RotatedFilesOptions options;
+    options.compress = false;
+    options.max_total_size = 2500;
+    options.max_age = std::chrono::hours(24);
+
+    auto before = core::rotated_files_stats();
+    core::add_file_sink_rotate((directory.path / "app_%N.log").string(), 1024,
+                               boost::posix_time::hours(1), options);
+
+    // the oldest goes for its age, the next one for the total size
+    BOOST_REQUIRE(wait_for([&] {
+        return core::rotated_files_stats().removed == before.removed + 2;
+    }));
+    BOOST_CHECK(!fs::exists(directory.path / "app_1.log"));
+    BOOST_CHECK(!fs::exists(directory.path / "app_2.log"));
+    BOOST_CHECK(fs::exists(directory.path / "app_3.log"));
+    BOOST_CHECK(fs::exists(directory.path / "app_4.log"));
+}
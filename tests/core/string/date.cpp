@@ -0,0 +1,79 @@
+/*
+ * File: tests/core/string/date.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <commonpp/core/string/date.hpp>
+
+using namespace commonpp::string;
+namespace pt = boost::posix_time;
+
+static std::string format(const pt::ptime& timestamp, TimestampFormat format)
+{
+    char buffer[MAX_TIMESTAMP_SIZE];
+    return std::string(buffer, format_timestamp(timestamp, format, buffer));
+}
+
+// what the formatter used to produce
+static std::string facet_format(const pt::ptime& timestamp, const char* format)
+{
+    std::ostringstream out;
+    out.imbue(std::locale(out.getloc(), new pt::time_facet(format)));
+    out << timestamp;
+    return out.str();
+}
+
+BOOST_AUTO_TEST_CASE(timestamp_matches_the_facet)
+{
+    pt::ptime start(boost::gregorian::date(2015, 12, 31), pt::hours(23) +
+                                                              pt::minutes(59) +
+                                                              pt::seconds(58));
+
+    // crosses seconds, a day and a year, and comes back
+    for (auto step : {0, 1, 999999, 1000000, 1500000, 2000001, 5, 3000000})
+    {
+        auto timestamp = start + pt::microseconds(step);
+        BOOST_CHECK_EQUAL(format(timestamp, TimestampFormat::Default),
+                          facet_format(timestamp, "%Y-%m-%d %H:%M:%S.%f"));
+        BOOST_CHECK_EQUAL(format(timestamp, TimestampFormat::Iso8601),
+                          facet_format(timestamp, "%Y-%m-%dT%H:%M:%S.%f"));
+    }
+
+    BOOST_CHECK_EQUAL(format(start, TimestampFormat::Default),
+                      "2015-12-31 23:59:58.000000");
+    BOOST_CHECK_EQUAL(format(start + pt::microseconds(2000042), TimestampFormat::Iso8601),
+                      "2016-01-01T00:00:00.000042");
+}
+
+BOOST_AUTO_TEST_CASE(timestamp_epoch_micros)
+{
+    pt::ptime utc(boost::gregorian::date(2015, 7, 5),
+                  pt::hours(13) + pt::minutes(44) + pt::seconds(23) +
+                      pt::microseconds(123456));
+    auto local = boost::date_time::c_local_adjustor<pt::ptime>::utc_to_local(utc);
+
+    BOOST_CHECK_EQUAL(format(local, TimestampFormat::EpochMicros),
+                      "1436103863123456");
+    BOOST_CHECK_EQUAL(format(local + pt::seconds(1), TimestampFormat::EpochMicros),
+                      "1436103864123456");
+}
+
+BOOST_AUTO_TEST_CASE(timestamp_special_values)
+{
+    BOOST_CHECK_EQUAL(format(pt::ptime(), TimestampFormat::Default),
+                      "not-a-date-time");
+}
@@ -0,0 +1,131 @@
+/*
+ * File: tests/core/structured_logging.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+// whatever the configured floor is
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <boost/smart_ptr/make_shared.hpp>
+
+#include <commonpp/core/StructuredLogging.hpp>
+#include <commonpp/thread/Thread.hpp>
+
+using namespace commonpp;
+using core::kv;
+
+CREATE_LOGGER(kv_logger, "kv");
+
+namespace
+{
+bool contains(const std::string& str, const std::string& what)
+{
+    return str.find(what) != std::string::npos;
+}
+
+int evaluated = 0;
+
+int evaluate(int i)
+{
+    ++evaluated;
+    return i;
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(json_lines)
+{
+    core::init_logging();
+    thread::set_current_thread_name("kv-thread");
+
+    auto json = boost::make_shared<std::stringstream>();
+    core::add_json_sink(json);
+
+    std::string name = "bob \"the\" builder";
+    LOG_KV(kv_logger, warning, "request served", kv("user", name),
+           kv("ms", 1.5), kv("id", 42), kv("big", std::numeric_limits<uint64_t>::max()),
+           kv("ok", true), kv("nan", std::numeric_limits<double>::quiet_NaN()));
+    GLOG_KV(info, "global", kv("n", -1));
+    LOG(kv_logger, info) << "no fields";
+    boost::log::core::get()->flush();
+
+    std::string line;
+    BOOST_REQUIRE(std::getline(*json, line));
+    BOOST_CHECK_EQUAL(line.front(), '{');
+    BOOST_CHECK_EQUAL(line.back(), '}');
+    BOOST_CHECK(contains(line, "\"timestamp\":\""));
+    BOOST_CHECK(contains(line, "\"severity\":\"warning\",\"channel\":\"kv\","
+                               "\"thread\":\"kv-thread\","
+                               "\"message\":\"request served\","
+                               "\"user\":\"bob \\\"the\\\" builder\",\"ms\":1.5,"
+                               "\"id\":42,\"big\":18446744073709551615,"
+                               "\"ok\":true,\"nan\":null}"));
+
+    BOOST_REQUIRE(std::getline(*json, line));
+    BOOST_CHECK(contains(line, "\"message\":\"global\",\"n\":-1}"));
+    BOOST_CHECK(!contains(line, "\"channel\""));
+
+    BOOST_REQUIRE(std::getline(*json, line));
+    BOOST_CHECK(contains(line, "\"message\":\"no fields\"}"));
+
+    // no field at all, and fields named after the fixed members
+    LOG_KV(kv_logger, info, "empty");
+    LOG_KV(kv_logger, info, "renamed", kv("message", "user"), kv("thread", 1));
+    boost::log::core::get()->flush();
+    BOOST_REQUIRE(std::getline(*json, line));
+    BOOST_CHECK(contains(line, "\"message\":\"empty\"}"));
+    BOOST_REQUIRE(std::getline(*json, line));
+    BOOST_CHECK(contains(line, "\"thread\":\"kv-thread\",\"message\":\"renamed\","
+                               "\"_message\":\"user\",\"_thread\":1}"));
+
+    // the last value of a member wins
+    LOG_KV(kv_logger, info, "twice", kv("a", 1), kv("b", 2), kv("a", 3),
+           kv("_message", 4), kv("message", 5));
+    boost::log::core::get()->flush();
+    BOOST_REQUIRE(std::getline(*json, line));
+    BOOST_CHECK(contains(line, "\"message\":\"twice\",\"b\":2,\"a\":3,\"_message\":5}"));
+
+    core::set_log_timestamp_format(string::TimestampFormat::EpochMicros);
+    LOG_KV(kv_logger, info, "epoch", kv("a", 1));
+    core::set_log_timestamp_format(string::TimestampFormat::Default);
+    boost::log::core::get()->flush();
+    BOOST_REQUIRE(std::getline(*json, line));
+    BOOST_CHECK(line.compare(0, 13, "{\"timestamp\":") == 0);
+    BOOST_CHECK(line[13] != '"');
+
+    core::remove_all_sinks();
+}
+
+BOOST_AUTO_TEST_CASE(text_fields)
+{
+    std::stringstream out;
+    auto cout_buffer = std::cout.rdbuf(out.rdbuf());
+    core::enable_console_logging();
+
+    LOG_KV(kv_logger, info, "served", kv("user", "alice"), kv("ms", 12));
+    boost::log::core::get()->flush();
+    std::cout.rdbuf(cout_buffer);
+
+    BOOST_CHECK(contains(out.str(), "]: served user=alice ms=12\n"));
+
+    // a disabled statement builds nothing
+    evaluated = 0;
+    core::set_logging_level_for_channel("kv", error);
+    LOG_KV(kv_logger, info, "filtered", kv("n", evaluate(1)));
+    core::set_logging_level_for_channel("kv", trace);
+    BOOST_CHECK_EQUAL(evaluated, 0);
+
+    core::remove_all_sinks();
+}
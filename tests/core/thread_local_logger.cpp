@@ -0,0 +1,168 @@
+/*
+ * File: tests/core/thread_local_logger.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#define COMMONPP_LOG_MIN_LEVEL ::commonpp::trace
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+
+#include <commonpp/core/LoggingInterface.hpp>
+
+using namespace commonpp;
+namespace expr = boost::log::expressions;
+
+static void add_custom(core::ThreadLocalLogger& logger)
+{
+    logger.add_attribute("Custom", boost::log::attributes::constant<int>(42));
+}
+
+CREATE_THREAD_LOCAL_LOGGER_WITH_INIT(tls_logger, "tls", add_custom);
+
+static int evaluated = 0;
+
+static int side_effect()
+{
+    return ++evaluated;
+}
+
+BOOST_AUTO_TEST_CASE(thread_local_sources)
+{
+    auto stream = boost::make_shared<std::stringstream>();
+    auto sink = boost::make_shared<
+        boost::log::sinks::synchronous_sink<boost::log::sinks::text_ostream_backend>>();
+    sink->locked_backend()->add_stream(stream);
+    sink->set_filter(core::CommonppRecord.or_default(false) == true);
+    sink->set_formatter(expr::stream << core::Channel << '|' << core::Severity << '|'
+                                     << expr::attr<int>("Custom") << '|'
+                                     << expr::smessage);
+    boost::log::core::get()->add_sink(sink);
+
+    const int nb_threads = 4;
+    const int nb_records = 1000;
+    std::vector<core::ThreadLocalLogger::source_type*> sources(nb_threads);
+    std::vector<char> stable(nb_threads, false);
+    std::atomic_int logged{0};
+    std::atomic_bool compared{false};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nb_threads; ++i)
+    {
+        threads.emplace_back([&, i] {
+            sources[i] = &tls_logger.source();
+            stable[i] = sources[i] == &tls_logger.source();
+            for (int n = 0; n < nb_records; ++n)
+            {
+                LOG(tls_logger, info) << "record " << n;
+            }
+
+            // the sources are compared while they are alive
+            ++logged;
+            while (!compared)
+            {
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    while (logged != nb_threads)
+    {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < nb_threads; ++i)
+    {
+        BOOST_CHECK(stable[i]);
+        if (i)
+        {
+            BOOST_CHECK(sources[i] != sources[0]);
+        }
+    }
+    compared = true;
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    core::set_logging_level_for_channel("tls", warning);
+    BOOST_CHECK(!tls_logger.is_enabled(info));
+    LOG(tls_logger, info) << side_effect();
+    LOG(tls_logger, warning) << "last";
+    BOOST_CHECK_EQUAL(evaluated, 0);
+
+    boost::log::core::get()->remove_sink(sink);
+
+    int nb_lines = 0;
+    std::string line;
+    while (std::getline(*stream, line))
+    {
+        if (line == "tls|warning|42|last")
+        {
+            continue;
+        }
+        BOOST_CHECK_EQUAL(line.substr(0, 17), "tls|info|42|recor");
+        ++nb_lines;
+    }
+    BOOST_CHECK_EQUAL(nb_lines, nb_threads * nb_records);
+}
+
+BOOST_AUTO_TEST_CASE(thread_local_logger_ids_are_reused)
+{
+    auto first = std::make_unique<core::ThreadLocalLogger>("first");
+    BOOST_CHECK_EQUAL(first->source().channel(), "first");
+    first.reset();
+
+    // takes the id of the first one, not its source
+    core::ThreadLocalLogger second("second");
+    BOOST_CHECK_EQUAL(second.source().channel(), "second");
+}
+
+namespace
+{
+// logs while the record it is streamed in is being built
+struct Noisy
+{
+};
+
+std::ostream& operator<<(std::ostream& os, const Noisy&)
+{
+    LOG(tls_logger, info) << "nested";
+    return os << "noisy";
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(nested_records)
+{
+    auto stream = boost::make_shared<std::stringstream>();
+    auto sink = boost::make_shared<
+        boost::log::sinks::synchronous_sink<boost::log::sinks::text_ostream_backend>>();
+    sink->locked_backend()->add_stream(stream);
+    sink->set_filter(core::CommonppRecord.or_default(false) == true);
+    sink->set_formatter(expr::stream << expr::smessage);
+    boost::log::core::get()->add_sink(sink);
+
+    core::set_logging_level_for_channel("tls", trace);
+    LOG(tls_logger, info) << "outer " << Noisy{} << " done";
+    LOG(tls_logger, info) << "next";
+
+    boost::log::core::get()->remove_sink(sink);
+    BOOST_CHECK_EQUAL(stream->str(), "nested\nouter noisy done\nnext\n");
+}
@@ -0,0 +1,50 @@
+/*
+ * File: tests/core/tsc_clock.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <thread>
+
+#include <commonpp/core/TscClock.hpp>
+
+using namespace commonpp;
+
+BOOST_AUTO_TEST_CASE(tsc_clock_is_monotonic)
+{
+    TscClock::init();
+    auto previous = TscClock::now();
+    for (int i = 0; i < 100000; ++i)
+    {
+        auto now = TscClock::now();
+        BOOST_REQUIRE(now >= previous);
+        previous = now;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsc_clock_follows_steady_clock)
+{
+    TscClock::init();
+    auto tsc_start = TscClock::now();
+    auto steady_start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto tsc_elapsed = TscClock::now() - tsc_start;
+    auto steady_elapsed = std::chrono::steady_clock::now() - steady_start;
+
+    auto diff = std::chrono::duration_cast<std::chrono::microseconds>(tsc_elapsed -
+                                                                      steady_elapsed);
+    BOOST_CHECK_LT(std::abs(diff.count()), 2000);
+
+    if (TscClock::uses_tsc())
+    {
+        BOOST_CHECK_GT(TscClock::ticks_per_second(), 1e8);
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * File: tests/thread/bounded_queue.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <commonpp/thread/BoundedQueue.hpp>
+
+using namespace commonpp::thread;
+
+BOOST_AUTO_TEST_CASE(bounded_queue_capacity)
+{
+    BoundedQueue<std::unique_ptr<int>> queue(3);
+    BOOST_CHECK_EQUAL(queue.capacity(), 4u);
+    BOOST_CHECK(queue.empty());
+
+    for (int i = 0; i < 4; ++i)
+    {
+        BOOST_CHECK(queue.try_push(std::make_unique<int>(i)));
+    }
+    BOOST_CHECK(!queue.try_push(std::make_unique<int>(4)));
+    BOOST_CHECK_EQUAL(queue.size(), 4u);
+
+    std::unique_ptr<int> value;
+    BOOST_CHECK(queue.try_pop(value));
+    BOOST_CHECK_EQUAL(*value, 0);
+    BOOST_CHECK(queue.try_push(std::make_unique<int>(4)));
+    // the queue is destroyed with values still inside
+}
+
+BOOST_AUTO_TEST_CASE(bounded_queue_concurrent)
+{
+    static constexpr uint64_t NB_VALUES = 100000;
+
+    BoundedQueue<uint64_t> queue(128);
+    std::atomic_uint64_t sum{0};
+    std::atomic_uint64_t popped{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; ++i)
+    {
+        threads.emplace_back(
+            [&]
+            {
+                for (uint64_t v = 1; v <= NB_VALUES; ++v)
+                {
+                    while (!queue.try_push(v))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        threads.emplace_back(
+            [&]
+            {
+                uint64_t v;
+                while (popped.load() < 2 * NB_VALUES)
+                {
+                    if (queue.try_pop(v))
+                    {
+                        sum += v;
+                        ++popped;
+                    }
+                    else
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    BOOST_CHECK_EQUAL(sum.load(), NB_VALUES * (NB_VALUES + 1));
+}
@@ -0,0 +1,106 @@
+/*
+ * File: tests/thread/dispatch.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <future>
+#include <mutex>
+#include <vector>
+
+// clang-format off
+#ifdef __linux__
+# include <sched.h>
+#endif
+// clang-format on
+
+#include <commonpp/core/config.hpp>
+#include <commonpp/thread/ThreadPool.hpp>
+#include <commonpp/thread/Topology.hpp>
+
+using namespace commonpp::thread;
+using Policy = ThreadPool::ThreadDispatchPolicy;
+
+static CpuSet current_affinity()
+{
+    CpuSet result;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    for (size_t i = 0; i < CPU_SETSIZE && i < MAX_CPUS; ++i)
+    {
+        if (CPU_ISSET(i, &set))
+        {
+            result.set(i);
+        }
+    }
+#else
+    result = Topology::instance().online_cpus();
+#endif
+    return result;
+}
+
+static std::vector<CpuSet> run_pool(Policy policy, const CpuSet& excluded = {})
+{
+    ThreadPool pool(4, "dispatch", 2);
+    pool.set_housekeeping_cpus(excluded);
+
+    std::mutex lock;
+    std::vector<CpuSet> affinities;
+    pool.start(
+        [&]
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            affinities.push_back(current_affinity());
+        },
+        policy);
+    pool.stop();
+
+    return affinities;
+}
+
+BOOST_AUTO_TEST_CASE(dispatch_policies_start)
+{
+    for (auto policy : {Policy::Random, Policy::DispatchToPCore,
+                        Policy::DispatchToAllCore, Policy::DispatchToL3Domain,
+                        Policy::DispatchToL2Domain, Policy::DispatchToSMTSiblings})
+    {
+        auto affinities = run_pool(policy);
+        BOOST_CHECK_EQUAL(affinities.size(), 4);
+        for (const auto& affinity : affinities)
+        {
+            BOOST_CHECK(affinity.any());
+        }
+    }
+}
+
+#if HAVE_HWLOC == 1 && defined(__linux__)
+BOOST_AUTO_TEST_CASE(dispatch_housekeeping_cpus)
+{
+    const auto& topology = Topology::instance();
+    if (topology.pus().size() < 2)
+    {
+        return;
+    }
+
+    CpuSet excluded;
+    excluded.set(topology.pus().front().os_index);
+
+    for (auto policy : {Policy::Random, Policy::DispatchToAllCore,
+                        Policy::DispatchToL3Domain, Policy::DispatchToSMTSiblings})
+    {
+        for (const auto& affinity : run_pool(policy, excluded))
+        {
+            BOOST_CHECK((affinity & excluded).none());
+        }
+    }
+}
+#endif
@@ -0,0 +1,106 @@
+/*
+ * File: tests/thread/fiber.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include <commonpp/thread/Fiber.hpp>
+#include <commonpp/thread/ThreadPool.hpp>
+
+using namespace commonpp::thread;
+
+BOOST_AUTO_TEST_CASE(fiber_run_and_sleep)
+{
+    ThreadPool pool(2, "fiber", 2);
+    pool.start();
+
+    static constexpr int NB_FIBERS = 1000;
+    std::atomic_int done{0};
+    std::promise<void> all_done;
+
+    for (int i = 0; i < NB_FIBERS; ++i)
+    {
+        spawn_fiber(pool,
+                    [&](Yield yield)
+                    {
+                        sleep_for(yield, std::chrono::milliseconds(10));
+                        yield.yield();
+                        if (++done == NB_FIBERS)
+                        {
+                            all_done.set_value();
+                        }
+                    });
+    }
+
+    BOOST_CHECK(all_done.get_future().wait_for(std::chrono::seconds(5)) ==
+                std::future_status::ready);
+    BOOST_CHECK_EQUAL(done.load(), NB_FIBERS);
+    pool.stop();
+
+    BOOST_CHECK(FiberStackPool::default_pool()->cached() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(fiber_interleave_on_one_thread)
+{
+    boost::asio::io_context service;
+    std::vector<int> order;
+
+    for (int id = 0; id < 2; ++id)
+    {
+        spawn_fiber(service,
+                    [&order, id](Yield yield)
+                    {
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            order.push_back(id);
+                            yield.yield();
+                        }
+                    });
+    }
+
+    service.run();
+    BOOST_CHECK((order == std::vector<int>{0, 1, 0, 1, 0, 1}));
+}
+
+BOOST_AUTO_TEST_CASE(fiber_error_code)
+{
+    boost::asio::io_context service;
+    boost::system::error_code result;
+    bool thrown = false;
+
+    spawn_fiber(service,
+                [&](Yield yield)
+                {
+                    boost::asio::steady_timer timer(service);
+                    timer.expires_after(std::chrono::hours(1));
+                    boost::asio::post(service, [&timer] { timer.cancel(); });
+                    timer.async_wait(yield[result]);
+
+                    timer.expires_after(std::chrono::hours(1));
+                    boost::asio::post(service, [&timer] { timer.cancel(); });
+                    try
+                    {
+                        timer.async_wait(yield);
+                    }
+                    catch (const boost::system::system_error&)
+                    {
+                        thrown = true;
+                    }
+                });
+
+    service.run();
+    BOOST_CHECK(result == boost::asio::error::operation_aborted);
+    BOOST_CHECK(thrown);
+}
@@ -0,0 +1,82 @@
+/*
+ * File: tests/thread/locks.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/mpl/list.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <commonpp/thread/AdaptiveMutex.hpp>
+#include <commonpp/thread/MCSLock.hpp>
+#include <commonpp/thread/Spinlock.hpp>
+
+using namespace commonpp::thread;
+
+using Locks = boost::mpl::list<Spinlock, TicketLock, MCSLock, AdaptiveMutex>;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(lock_mutual_exclusion, Lock, Locks)
+{
+    static constexpr int NB_THREADS = 4;
+    static constexpr int NB_ITERATIONS = 20000;
+
+    Lock lock;
+    int counter = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NB_THREADS; ++i)
+    {
+        threads.emplace_back(
+            [&]
+            {
+                for (int j = 0; j < NB_ITERATIONS; ++j)
+                {
+                    std::lock_guard<Lock> guard(lock);
+                    ++counter;
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    BOOST_CHECK_EQUAL(counter, NB_THREADS * NB_ITERATIONS);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(lock_try_lock, Lock, Locks)
+{
+    Lock lock;
+    BOOST_CHECK(lock.try_lock());
+
+    std::thread other([&] { BOOST_CHECK(!lock.try_lock()); });
+    other.join();
+
+    lock.unlock();
+    BOOST_CHECK(lock.try_lock());
+    lock.unlock();
+}
+
+BOOST_AUTO_TEST_CASE(mcs_nested_locks)
+{
+    MCSLock a, b, c;
+    a.lock();
+    b.lock();
+    c.lock();
+    // released out of order
+    b.unlock();
+    a.unlock();
+    c.unlock();
+
+    std::scoped_lock both(a, b);
+}
@@ -0,0 +1,92 @@
+/*
+ * File: tests/thread/monitor.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <future>
+#include <sstream>
+
+#include <commonpp/thread/ThreadMonitor.hpp>
+#include <commonpp/thread/ThreadPool.hpp>
+
+using namespace commonpp::thread;
+
+static void burn(std::chrono::milliseconds duration)
+{
+    auto end = std::chrono::steady_clock::now() + duration;
+    volatile int sink = 0;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        sink = sink + 1;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(monitor_pool_threads)
+{
+    auto& monitor = ThreadMonitor::instance();
+    ThreadPool pool(2, "monitored");
+    pool.start();
+
+    auto stats = monitor.sample();
+    BOOST_CHECK_EQUAL(stats.size(), 2);
+
+    std::promise<void> done;
+    pool.post(
+        [&]
+        {
+            burn(std::chrono::milliseconds(100));
+            done.set_value();
+        });
+    done.get_future().wait();
+
+    stats = monitor.sample();
+    BOOST_REQUIRE_EQUAL(stats.size(), 2);
+
+    double total_load = 0;
+    for (const auto& thread : stats)
+    {
+        BOOST_CHECK(thread.name.find("monitored#") == 0);
+        total_load += thread.load;
+
+        std::ostringstream out;
+        out << thread;
+        BOOST_CHECK(!out.str().empty());
+    }
+#if HAVE_POSIX_CPU_CLOCK
+    BOOST_CHECK(total_load > 0.1);
+#endif
+
+    pool.stop();
+    BOOST_CHECK(monitor.sample().empty());
+}
+
+BOOST_AUTO_TEST_CASE(monitor_periodic_sampling)
+{
+    ThreadPool pool(1, "sampler");
+    pool.start();
+
+    std::promise<size_t> sampled;
+    std::atomic_bool first{true};
+    auto timer = ThreadMonitor::instance().start(
+        pool, std::chrono::milliseconds(10),
+        [&](const std::vector<ThreadStats>& stats)
+        {
+            if (first.exchange(false))
+            {
+                sampled.set_value(stats.size());
+            }
+        });
+
+    BOOST_CHECK_EQUAL(sampled.get_future().get(), 1);
+    timer->cancel();
+    pool.stop();
+}
@@ -0,0 +1,74 @@
+/*
+ * File: tests/thread/numa_memory.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <memory_resource>
+#include <stdexcept>
+#include <vector>
+
+#include <commonpp/thread/NumaMemory.hpp>
+#include <commonpp/thread/Topology.hpp>
+
+using namespace commonpp::thread;
+
+BOOST_AUTO_TEST_CASE(numa_raw_allocations)
+{
+    static constexpr std::size_t SIZE = 1 << 20;
+
+    const auto nb_nodes = Topology::instance().numa_nodes().size();
+    for (unsigned node = 0; node < nb_nodes; ++node)
+    {
+        auto ptr = allocate_on_node(SIZE, node);
+        BOOST_REQUIRE(ptr);
+        std::memset(ptr, 0x42, SIZE);
+        deallocate_numa(ptr, SIZE);
+    }
+
+    BOOST_CHECK_THROW(allocate_on_node(SIZE, nb_nodes + 1), std::out_of_range);
+
+    for (auto fn : {&allocate_interleaved, &allocate_local})
+    {
+        auto ptr = fn(SIZE);
+        BOOST_REQUIRE(ptr);
+        std::memset(ptr, 0x42, SIZE);
+        deallocate_numa(ptr, SIZE);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(numa_allocator)
+{
+    std::vector<int, NumaAllocator<int>> values(NumaAllocator<int>(NumaPolicy::Interleaved));
+    for (int i = 0; i < 10000; ++i)
+    {
+        values.push_back(i);
+    }
+
+    BOOST_CHECK_EQUAL(values.back(), 9999);
+    BOOST_CHECK(NumaAllocator<int>() == NumaAllocator<char>());
+    BOOST_CHECK(NumaAllocator<int>(NumaPolicy::OnNode) != NumaAllocator<int>());
+}
+
+BOOST_AUTO_TEST_CASE(numa_memory_resource)
+{
+    NumaMemoryResource upstream(NumaPolicy::OnNode, 0);
+    std::pmr::unsynchronized_pool_resource pool(&upstream);
+
+    std::pmr::vector<std::pmr::string> strings(&pool);
+    for (int i = 0; i < 1000; ++i)
+    {
+        strings.emplace_back(std::to_string(i) + " is a long enough string to allocate");
+    }
+
+    BOOST_CHECK_EQUAL(strings.size(), 1000);
+    BOOST_CHECK(upstream.is_equal(upstream));
+}
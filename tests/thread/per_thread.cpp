@@ -0,0 +1,101 @@
+/*
+ * File: tests/thread/per_thread.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <commonpp/thread/PerThread.hpp>
+#include <commonpp/thread/ShardedCounter.hpp>
+#include <commonpp/thread/Thread.hpp>
+#include <commonpp/thread/ThreadPool.hpp>
+
+using namespace commonpp::thread;
+
+BOOST_AUTO_TEST_CASE(thread_indexes_are_dense_and_reused)
+{
+    auto main_index = current_thread_index();
+    BOOST_CHECK_EQUAL(main_index, current_thread_index());
+
+    size_t first = 0;
+    std::thread([&] { first = current_thread_index(); }).join();
+    BOOST_CHECK(first != main_index);
+
+    size_t second = 0;
+    std::thread([&] { second = current_thread_index(); }).join();
+    BOOST_CHECK_EQUAL(first, second);
+}
+
+BOOST_AUTO_TEST_CASE(sharded_counter)
+{
+    static constexpr int NB_THREADS = 8;
+    static constexpr int NB_INCREMENTS = 100000;
+
+    ShardedCounter<uint64_t> counter;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NB_THREADS; ++i)
+    {
+        threads.emplace_back(
+            [&counter]
+            {
+                for (int j = 0; j < NB_INCREMENTS; ++j)
+                {
+                    ++counter;
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    BOOST_CHECK_EQUAL(counter.get(), NB_THREADS * NB_INCREMENTS);
+
+    counter -= 10;
+    BOOST_CHECK_EQUAL(counter.get(), NB_THREADS * NB_INCREMENTS - 10);
+
+    auto max = counter.combine(uint64_t(0), [](uint64_t a, uint64_t b)
+                               { return std::max(a, b); });
+    BOOST_CHECK(max >= NB_INCREMENTS);
+}
+
+BOOST_AUTO_TEST_CASE(per_thread_in_pool)
+{
+    PerThread<std::atomic_int> values;
+    ThreadPool pool(4, "per_thread", 4);
+    pool.start();
+
+    std::atomic_int done{0};
+    for (int i = 0; i < 400; ++i)
+    {
+        pool.post(
+            [&]
+            {
+                ++values.local();
+                ++done;
+            },
+            i % 4);
+    }
+
+    while (done != 400)
+    {
+        std::this_thread::yield();
+    }
+    pool.stop();
+
+    auto total = values.combine(0, [](int acc, const std::atomic_int& v)
+                                { return acc + v.load(); });
+    BOOST_CHECK_EQUAL(total, 400);
+}
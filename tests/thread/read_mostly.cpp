@@ -0,0 +1,188 @@
+/*
+ * File: tests/thread/read_mostly.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <commonpp/thread/Qsbr.hpp>
+#include <commonpp/thread/ReadMostly.hpp>
+#include <commonpp/thread/SeqLock.hpp>
+#include <commonpp/thread/ThreadPool.hpp>
+
+using namespace commonpp::thread;
+
+struct Pair
+{
+    uint64_t a;
+    uint64_t b;
+    uint32_t c;
+};
+
+BOOST_AUTO_TEST_CASE(seqlock_readers_never_see_torn_values)
+{
+    SeqLock<Pair> value(Pair{0, 0, 0});
+    std::atomic_bool stop{false};
+    std::atomic_bool torn{false};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 2; ++i)
+    {
+        readers.emplace_back(
+            [&]
+            {
+                while (!stop)
+                {
+                    auto v = value.load();
+                    if (v.a != v.b || v.a != v.c)
+                    {
+                        torn = true;
+                    }
+                }
+            });
+    }
+
+    for (uint32_t i = 1; i < 100000; ++i)
+    {
+        value.store(Pair{i, i, i});
+    }
+    value.update([](Pair& v) { ++v.a, ++v.b, ++v.c; });
+
+    stop = true;
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    BOOST_CHECK(!torn);
+    BOOST_CHECK_EQUAL(value.load().a, 100000u);
+}
+
+struct Tracked
+{
+    explicit Tracked(int value, std::atomic_int& alive)
+    : value(value)
+    , alive(alive)
+    {
+        ++alive;
+    }
+
+    Tracked(const Tracked& other)
+    : value(other.value)
+    , alive(other.alive)
+    {
+        ++alive;
+    }
+
+    ~Tracked()
+    {
+        --alive;
+    }
+
+    int value;
+    std::atomic_int& alive;
+};
+
+BOOST_AUTO_TEST_CASE(qsbr_waits_for_registered_threads)
+{
+    Qsbr domain;
+    std::atomic_int state{0};
+    std::atomic_bool reclaimed{false};
+
+    std::thread reader(
+        [&]
+        {
+            domain.register_thread();
+            state = 1;
+            while (state != 2)
+            {
+                std::this_thread::yield();
+            }
+            domain.quiescent();
+            domain.unregister_thread();
+            state = 3;
+        });
+
+    while (state != 1)
+    {
+        std::this_thread::yield();
+    }
+
+    domain.retire([&] { reclaimed = true; });
+    BOOST_CHECK(!reclaimed);
+    BOOST_CHECK_EQUAL(domain.pending(), 1u);
+
+    state = 2;
+    while (state != 3)
+    {
+        std::this_thread::yield();
+    }
+
+    BOOST_CHECK_EQUAL(domain.reclaim(), 1u);
+    BOOST_CHECK(reclaimed);
+    reader.join();
+}
+
+BOOST_AUTO_TEST_CASE(read_mostly_in_pool)
+{
+    std::atomic_int alive{0};
+    Qsbr domain;
+
+    {
+        ReadMostly<Tracked> config(std::make_unique<Tracked>(0, alive), domain);
+
+        ThreadPool pool(2, "rm");
+        pool.enable_quiescent_states(domain, std::chrono::milliseconds(1));
+        pool.start();
+
+        std::atomic_int bad{0};
+        std::atomic_int done{0};
+        for (int i = 0; i < 1000; ++i)
+        {
+            pool.post(
+                [&]
+                {
+                    const auto* current = config.get();
+                    if (current->value < 0)
+                    {
+                        ++bad;
+                    }
+                    ++done;
+                });
+
+            if (i % 10 == 0)
+            {
+                config.modify([](Tracked& t) { ++t.value; });
+            }
+        }
+
+        while (done != 1000)
+        {
+            std::this_thread::yield();
+        }
+
+        BOOST_CHECK_EQUAL(bad, 0);
+        BOOST_CHECK_EQUAL(config->value, 100);
+
+        // idle threads keep reporting, the old versions go away
+        domain.synchronize();
+        BOOST_CHECK_EQUAL(domain.pending(), 0u);
+        BOOST_CHECK_EQUAL(alive, 1);
+
+        pool.stop();
+    }
+
+    BOOST_CHECK_EQUAL(alive, 0);
+}
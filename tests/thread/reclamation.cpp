@@ -0,0 +1,201 @@
+/*
+ * File: tests/thread/reclamation.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <commonpp/thread/EpochDomain.hpp>
+#include <commonpp/thread/HazardPointer.hpp>
+#include <commonpp/thread/ThreadPool.hpp>
+
+using namespace commonpp::thread;
+
+struct Node
+{
+    explicit Node(int value, std::atomic_int& alive)
+    : value(value)
+    , alive(alive)
+    {
+        ++alive;
+    }
+
+    ~Node()
+    {
+        --alive;
+    }
+
+    int value;
+    std::atomic_int& alive;
+};
+
+BOOST_AUTO_TEST_CASE(epoch_pinned_thread_delays_reclamation)
+{
+    EpochDomain domain;
+    std::atomic_int alive{0};
+    std::atomic_int state{0};
+
+    std::thread reader(
+        [&]
+        {
+            auto guard = domain.pin();
+            state = 1;
+            while (state != 2)
+            {
+                std::this_thread::yield();
+            }
+        });
+
+    while (state != 1)
+    {
+        std::this_thread::yield();
+    }
+
+    domain.retire(new Node(1, alive));
+    for (int i = 0; i < 4; ++i)
+    {
+        domain.collect();
+    }
+    BOOST_CHECK_EQUAL(alive, 1);
+
+    state = 2;
+    reader.join();
+
+    domain.synchronize();
+    BOOST_CHECK_EQUAL(alive, 0);
+}
+
+BOOST_AUTO_TEST_CASE(epoch_orphans_of_exited_threads)
+{
+    EpochDomain domain;
+    std::atomic_int alive{0};
+
+    std::thread exiting([&] { domain.retire(new Node(1, alive)); });
+    exiting.join();
+
+    std::thread unregistered(
+        [&]
+        {
+            domain.register_thread();
+            domain.retire(new Node(2, alive));
+            domain.unregister_thread();
+        });
+    unregistered.join();
+
+    BOOST_CHECK_EQUAL(alive, 2);
+    domain.synchronize();
+    BOOST_CHECK_EQUAL(alive, 0);
+}
+
+BOOST_AUTO_TEST_CASE(epoch_domain_in_pool)
+{
+    EpochDomain domain;
+    std::atomic_int alive{0};
+    std::atomic<Node*> shared{new Node(0, alive)};
+
+    ThreadPool pool(2, "ebr");
+    pool.enable_quiescent_states(domain, std::chrono::milliseconds(1));
+    pool.start();
+
+    std::atomic_int bad{0};
+    std::atomic_int done{0};
+    for (int i = 1; i <= 1000; ++i)
+    {
+        pool.post(
+            [&]
+            {
+                // no guard needed within a handler
+                if (shared.load(std::memory_order_acquire)->value < 0)
+                {
+                    ++bad;
+                }
+                ++done;
+            });
+
+        domain.retire(shared.exchange(new Node(i, alive)));
+    }
+
+    while (done != 1000)
+    {
+        std::this_thread::yield();
+    }
+
+    domain.synchronize();
+    BOOST_CHECK_EQUAL(bad, 0);
+    BOOST_CHECK_EQUAL(alive, 1);
+
+    pool.stop();
+    delete shared.load();
+}
+
+BOOST_AUTO_TEST_CASE(hazard_pointer_protects)
+{
+    HazardPointerDomain domain;
+    std::atomic_int alive{0};
+    std::atomic<Node*> shared{new Node(1, alive)};
+
+    HazardPointer hp(domain);
+    auto node = hp.protect(shared);
+    BOOST_CHECK_EQUAL(node->value, 1);
+
+    std::thread writer(
+        [&]
+        {
+            domain.retire(shared.exchange(new Node(2, alive)));
+            BOOST_CHECK_EQUAL(domain.reclaim(), 0u);
+            BOOST_CHECK_EQUAL(node->value, 1);
+
+            hp.reset();
+            BOOST_CHECK_EQUAL(domain.reclaim(), 1u);
+        });
+    writer.join();
+
+    BOOST_CHECK_EQUAL(alive, 1);
+
+    // the slot of a destroyed hazard pointer is reused
+    {
+        HazardPointer other(domain);
+        BOOST_CHECK_EQUAL(other.protect(shared)->value, 2);
+    }
+
+    delete shared.load();
+    BOOST_CHECK_EQUAL(alive, 0);
+}
+
+BOOST_AUTO_TEST_CASE(hazard_pointer_orphans_of_exited_threads)
+{
+    HazardPointerDomain domain;
+    std::atomic_int alive{0};
+    std::atomic<Node*> shared{new Node(1, alive)};
+
+    HazardPointer hp(domain);
+    hp.protect(shared);
+
+    size_t reclaimed = 1;
+    std::thread exiting(
+        [&]
+        {
+            domain.retire(shared.exchange(nullptr));
+            reclaimed = domain.reclaim();
+        });
+    exiting.join();
+    BOOST_CHECK_EQUAL(reclaimed, 0u);
+
+    // adopted by the other threads
+    BOOST_CHECK_EQUAL(domain.reclaim(), 0u);
+    BOOST_CHECK_EQUAL(alive, 1);
+
+    hp.reset();
+    BOOST_CHECK_EQUAL(domain.reclaim(), 1u);
+    BOOST_CHECK_EQUAL(alive, 0);
+}
@@ -0,0 +1,69 @@
+/*
+ * File: tests/thread/scheduling.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+#include <commonpp/thread/Thread.hpp>
+#include <commonpp/thread/ThreadPool.hpp>
+
+// clang-format off
+#ifdef __linux__
+# include <sched.h>
+# include <sys/resource.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+// clang-format on
+
+using namespace commonpp::thread;
+
+#ifdef __linux__
+BOOST_AUTO_TEST_CASE(pool_scheduling_policy)
+{
+    SchedulingPolicy policy;
+    policy.policy = SchedulingPolicy::Batch;
+    policy.set_nice = true;
+    policy.nice = 5;
+    policy.io_class = SchedulingPolicy::IOBestEffort;
+    policy.io_priority = 7;
+
+    ThreadPool pool(2, "sched");
+    pool.set_scheduling_policy(policy);
+
+    std::atomic_int batch{0};
+    std::atomic_int niced{0};
+    pool.start(
+        [&]
+        {
+            if (sched_getscheduler(0) == SCHED_BATCH)
+            {
+                ++batch;
+            }
+
+            auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+            if (getpriority(PRIO_PROCESS, tid) == 5)
+            {
+                ++niced;
+            }
+        });
+    pool.stop();
+
+    BOOST_CHECK_EQUAL(batch.load(), 2);
+    BOOST_CHECK_EQUAL(niced.load(), 2);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(default_policy_is_noop)
+{
+    BOOST_CHECK(set_current_thread_scheduling(SchedulingPolicy{}));
+}
@@ -0,0 +1,75 @@
+/*
+ * File: tests/thread/thread_name.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2015 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <commonpp/thread/Thread.hpp>
+
+using namespace commonpp::thread;
+
+BOOST_AUTO_TEST_CASE(thread_names_are_interned)
+{
+    set_current_thread_name("interned");
+    auto id = get_current_thread_name_id();
+    BOOST_CHECK_EQUAL(get_thread_name(id), "interned");
+
+    ThreadNameId same = 0;
+    ThreadNameId other = 0;
+    std::thread([&] {
+        set_current_thread_name("interned");
+        same = get_current_thread_name_id();
+        set_current_thread_name("interned-other");
+        other = get_current_thread_name_id();
+    }).join();
+    BOOST_CHECK_EQUAL(same, id);
+    BOOST_CHECK_NE(other, id);
+    BOOST_CHECK_EQUAL(get_thread_name(other), "interned-other");
+}
+
+BOOST_AUTO_TEST_CASE(unnamed_threads_keep_their_identity)
+{
+    std::string names[2];
+    ThreadNameId ids[2] = {};
+    std::atomic_int ready{0};
+
+    // both alive at once, their system ids differ
+    auto unnamed = [&](int i) {
+        names[i] = get_current_thread_name();
+        ids[i] = get_current_thread_name_id();
+        ++ready;
+        while (ready != 2)
+        {
+            std::this_thread::yield();
+        }
+    };
+    std::thread first(unnamed, 0);
+    std::thread second(unnamed, 1);
+    first.join();
+    second.join();
+
+    BOOST_CHECK(!names[0].empty());
+    BOOST_CHECK_NE(names[0], names[1]);
+    BOOST_CHECK_NE(ids[0], ids[1]);
+    BOOST_CHECK_EQUAL(get_thread_name(ids[0]), names[0]);
+    BOOST_CHECK_EQUAL(get_thread_name(ids[1]), names[1]);
+
+    // naming an unnamed thread interns its name
+    std::thread([&] {
+        get_current_thread_name();
+        set_current_thread_name("named-later");
+        ids[0] = get_current_thread_name_id();
+    }).join();
+    BOOST_CHECK_EQUAL(get_thread_name(ids[0]), "named-later");
+}
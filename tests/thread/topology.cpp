@@ -0,0 +1,47 @@
+/*
+ * File: tests/thread/topology.cpp
+ * Part of commonpp.
+ *
+ * Distributed under the 2-clause BSD licence (See LICENCE.TXT file at the
+ * project root).
+ *
+ * Copyright (c) 2016 Thomas Sanchez.  All rights reserved.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <commonpp/thread/Thread.hpp>
+#include <commonpp/thread/Topology.hpp>
+
+using namespace commonpp::thread;
+
+BOOST_AUTO_TEST_CASE(topology_is_consistent)
+{
+    const auto& topology = Topology::instance();
+    BOOST_CHECK_EQUAL(&topology, &Topology::instance());
+
+    BOOST_REQUIRE(!topology.pus().empty());
+    BOOST_REQUIRE(!topology.cores().empty());
+    BOOST_CHECK(topology.cores().size() <= topology.pus().size());
+    BOOST_CHECK_EQUAL(get_nb_logical_core(), topology.pus().size());
+    BOOST_CHECK_EQUAL(get_nb_physical_core(), topology.cores().size());
+
+    CpuSet all;
+    for (const auto& pu : topology.pus())
+    {
+        BOOST_CHECK_EQUAL(pu.cpuset.count(), 1);
+        BOOST_CHECK(pu.cpuset.test(pu.os_index));
+        all |= pu.cpuset;
+
+        auto siblings = topology.smt_siblings(pu.os_index);
+        BOOST_CHECK(siblings.test(pu.os_index));
+
+        auto core = topology.object_of(Topology::CORE, pu.os_index);
+        BOOST_REQUIRE(core);
+        BOOST_CHECK((core->cpuset & pu.cpuset) == pu.cpuset);
+    }
+
+    BOOST_CHECK(all == topology.online_cpus());
+    BOOST_CHECK(topology.object_of(Topology::PU, MAX_CPUS) == nullptr);
+}